@@ -0,0 +1,689 @@
+// Bignum module for Calculator OS
+// Exact integer and fixed-decimal arithmetic on base 10^9 limbs
+
+#include "bignum.h"
+#include "mem.h"
+
+// Below this many limbs schoolbook multiplication beats Karatsuba
+#define KARATSUBA_MIN 24
+
+typedef unsigned int limb;
+typedef unsigned long long dlimb;
+
+static const limb powers10[BIG_DIGITS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// n / d for a quotient that fits in 32 bits (n >> 32 < d). One divl, so
+// no 64-bit division routine from libgcc is needed.
+static limb div_limb(dlimb n, limb d, limb* rem) {
+    limb q, r;
+    __asm__("divl %4" : "=a"(q), "=d"(r) : "a"((limb)n), "d"((limb)(n >> 32)), "rm"(d));
+    *rem = r;
+    return q;
+}
+
+static limb* alloc_limbs(int n) {
+    return arena_alloc(n * sizeof(limb));
+}
+
+static void set_zero(bignum* r) {
+    r->limb = 0;
+    r->len = 0;
+    r->neg = 0;
+    r->scale = 0;
+}
+
+// ---- Magnitudes: plain limb arrays ----
+
+static int mag_cmp(const limb* a, int an, const limb* b, int bn) {
+    if (an != bn) return an < bn ? -1 : 1;
+    for (int i = an - 1; i >= 0; i--) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// r = a + b; r has max(an, bn) + 1 limbs, which is returned
+static int mag_add(limb* r, const limb* a, int an, const limb* b, int bn) {
+    int n = an > bn ? an : bn;
+    limb carry = 0;
+    for (int i = 0; i < n; i++) {
+        limb s = (i < an ? a[i] : 0) + (i < bn ? b[i] : 0) + carry;
+        carry = s >= BIG_BASE;
+        r[i] = carry ? s - BIG_BASE : s;
+    }
+    r[n] = carry;
+    return n + 1;
+}
+
+// r = a - b for a >= b; r has an limbs
+static void mag_sub(limb* r, const limb* a, int an, const limb* b, int bn) {
+    int borrow = 0;
+    for (int i = 0; i < an; i++) {
+        int t = (int)a[i] - (int)(i < bn ? b[i] : 0) - borrow;
+        borrow = t < 0;
+        r[i] = (limb)t + (borrow ? BIG_BASE : 0);
+    }
+}
+
+// r[0..rn) += a[0..an); limbs of a beyond rn must be zero
+static void mag_add_to(limb* r, int rn, const limb* a, int an) {
+    limb carry = 0;
+    int i;
+    for (i = 0; i < an && i < rn; i++) {
+        limb s = r[i] + a[i] + carry;
+        carry = s >= BIG_BASE;
+        r[i] = carry ? s - BIG_BASE : s;
+    }
+    for (; carry && i < rn; i++) {
+        carry = ++r[i] == BIG_BASE;
+        if (carry) r[i] = 0;
+    }
+}
+
+// r[0..rn) -= a[0..an); the result must not be negative
+static void mag_sub_from(limb* r, int rn, const limb* a, int an) {
+    int borrow = 0, i;
+    for (i = 0; i < an && i < rn; i++) {
+        int t = (int)r[i] - (int)a[i] - borrow;
+        borrow = t < 0;
+        r[i] = (limb)t + (borrow ? BIG_BASE : 0);
+    }
+    for (; borrow && i < rn; i++) {
+        borrow = r[i] == 0;
+        r[i] = borrow ? BIG_BASE - 1 : r[i] - 1;
+    }
+}
+
+// r = a * m + add; r has an + 1 limbs and may be a
+static void mag_mul_small(limb* r, const limb* a, int an, limb m, limb add) {
+    limb carry = add;
+    for (int i = 0; i < an; i++) {
+        carry = div_limb((dlimb)a[i] * m + carry, BIG_BASE, &r[i]);
+    }
+    r[an] = carry;
+}
+
+// q = a / d, returns a % d; q may be a
+static limb mag_div_small(limb* q, const limb* a, int an, limb d) {
+    limb rem = 0;
+    for (int i = an - 1; i >= 0; i--) {
+        q[i] = div_limb((dlimb)rem * BIG_BASE + a[i], d, &rem);
+    }
+    return rem;
+}
+
+static void mul_school(limb* r, const limb* a, int an, const limb* b, int bn) {
+    for (int i = 0; i < an + bn; i++) r[i] = 0;
+    for (int i = 0; i < an; i++) {
+        limb ai = a[i], carry = 0;
+        if (ai == 0) continue;
+        for (int j = 0; j < bn; j++) {
+            carry = div_limb((dlimb)ai * b[j] + r[i + j] + carry, BIG_BASE, &r[i + j]);
+        }
+        r[i + bn] = carry;
+    }
+}
+
+// r[0..an+bn) = a * b, r not overlapping a or b. Karatsuba splits the
+// longer operand at m: a = a1*B^m + a0, b = b1*B^m + b0, and
+// a*b = z2*B^2m + (z1 - z2 - z0)*B^m + z0 with z1 = (a0+a1)(b0+b1).
+// Scratch comes from the arena; the caller checks there is room.
+static void mag_mul(limb* r, const limb* a, int an, const limb* b, int bn) {
+    if (an < bn) {
+        const limb* t = a; a = b; b = t;
+        int n = an; an = bn; bn = n;
+    }
+    if (bn < KARATSUBA_MIN) {
+        mul_school(r, a, an, b, bn);
+        return;
+    }
+
+    void* mark = arena_mark();
+    int m = (an + 1) / 2;
+
+    if (bn <= m) {
+        // Lopsided: a0*b + a1*b*B^m
+        limb* high = alloc_limbs(an - m + bn);
+        mag_mul(r, a, m, b, bn);
+        mag_mul(high, a + m, an - m, b, bn);
+        for (int i = m + bn; i < an + bn; i++) r[i] = 0;
+        mag_add_to(r + m, an + bn - m, high, an - m + bn);
+        arena_release(mark);
+        return;
+    }
+
+    limb* sa = alloc_limbs(m + 1);
+    limb* sb = alloc_limbs(m + 1);
+    int sal = mag_add(sa, a, m, a + m, an - m);
+    int sbl = mag_add(sb, b, m, b + m, bn - m);
+    limb* z1 = alloc_limbs(sal + sbl);
+
+    mag_mul(z1, sa, sal, sb, sbl);
+    mag_mul(r, a, m, b, m);
+    mag_mul(r + 2 * m, a + m, an - m, b + m, bn - m);
+    mag_sub_from(z1, sal + sbl, r, 2 * m);
+    mag_sub_from(z1, sal + sbl, r + 2 * m, an + bn - 2 * m);
+    mag_add_to(r + m, an + bn - m, z1, sal + sbl);
+    arena_release(mark);
+}
+
+// Knuth's algorithm D in base 10^9: q = u / v (un - vn + 1 limbs) and
+// rem = u % v (vn limbs), for trimmed u and v with un >= vn >= 2.
+// Returns 0 if the arena is out of room.
+static int mag_divmod(limb* q, limb* rem, const limb* u, int un, const limb* v, int vn) {
+    void* mark = arena_mark();
+    limb* nu = alloc_limbs(un + 1);
+    limb* nv = alloc_limbs(vn + 1);
+    if (!nu || !nv) {
+        arena_release(mark);
+        return 0;
+    }
+
+    // Scale so the top divisor limb is at least BASE / 2
+    limb d = BIG_BASE / (v[vn - 1] + 1);
+    mag_mul_small(nu, u, un, d, 0);
+    mag_mul_small(nv, v, vn, d, 0);
+    limb top = nv[vn - 1], next = nv[vn - 2];
+
+    for (int j = un - vn; j >= 0; j--) {
+        // Estimate from the top two limbs, then correct with the third
+        dlimb num = (dlimb)nu[j + vn] * BIG_BASE + nu[j + vn - 1];
+        limb rhat;
+        limb qhat = div_limb(num, top, &rhat);
+        dlimb r = rhat;
+        if (qhat >= BIG_BASE) {
+            qhat = BIG_BASE - 1;
+            r = num - (dlimb)qhat * top;
+        }
+        while (r < BIG_BASE && (dlimb)qhat * next > r * BIG_BASE + nu[j + vn - 2]) {
+            qhat--;
+            r += top;
+        }
+
+        // nu[j..j+vn] -= qhat * nv
+        limb carry = 0;
+        int borrow = 0;
+        for (int i = 0; i < vn; i++) {
+            limb lo;
+            carry = div_limb((dlimb)qhat * nv[i] + carry, BIG_BASE, &lo);
+            int t = (int)nu[i + j] - (int)lo - borrow;
+            borrow = t < 0;
+            nu[i + j] = (limb)t + (borrow ? BIG_BASE : 0);
+        }
+        int t = (int)nu[j + vn] - (int)carry - borrow;
+
+        // qhat was one too large: add the divisor back
+        if (t < 0) {
+            qhat--;
+            limb c = 0;
+            for (int i = 0; i < vn; i++) {
+                limb s = nu[i + j] + nv[i] + c;
+                c = s >= BIG_BASE;
+                nu[i + j] = c ? s - BIG_BASE : s;
+            }
+            t += c;
+        }
+        nu[j + vn] = t;
+        q[j] = qhat;
+    }
+
+    mag_div_small(rem, nu, vn, d);
+    arena_release(mark);
+    return 1;
+}
+
+// ---- Signed fixed decimals ----
+
+// Drop leading zero limbs and trailing fractional zeros; reject results
+// over the size limit
+static int finish(bignum* r) {
+    while (r->len > 0 && r->limb[r->len - 1] == 0) r->len--;
+    if (r->len == 0) {
+        r->neg = 0;
+        r->scale = 0;
+        return 1;
+    }
+
+    while (r->scale > 0) {
+        int k = 0;
+        while (k < BIG_DIGITS && k < r->scale && r->limb[0] % powers10[k + 1] == 0) k++;
+        if (k == 0) break;
+        mag_div_small(r->limb, r->limb, r->len, powers10[k]);
+        r->scale -= k;
+        if (r->limb[r->len - 1] == 0) r->len--;
+    }
+    return r->len <= BIG_MAX_LIMBS;
+}
+
+static int copy(bignum* r, const bignum* a, int extra) {
+    *r = *a;
+    r->limb = alloc_limbs(a->len + extra);
+    if (!r->limb) return 0;
+    for (int i = 0; i < a->len; i++) r->limb[i] = a->limb[i];
+    for (int i = a->len; i < a->len + extra; i++) r->limb[i] = 0;
+    return 1;
+}
+
+// a with k more decimal places (same value)
+static int scale_up(bignum* r, const bignum* a, int k) {
+    int whole = k / BIG_DIGITS;
+    if (a->len + whole >= BIG_MAX_LIMBS * 2) return 0;
+    limb* l = alloc_limbs(a->len + whole + 1);
+    if (!l) return 0;
+
+    for (int i = 0; i < whole; i++) l[i] = 0;
+    mag_mul_small(l + whole, a->limb, a->len, powers10[k % BIG_DIGITS], 0);
+    r->limb = l;
+    r->len = a->len + whole + 1;
+    r->neg = a->neg;
+    r->scale = a->scale + k;
+    while (r->len > 0 && r->limb[r->len - 1] == 0) r->len--;
+    return 1;
+}
+
+// Round in place to at most scale decimals, half away from zero.
+// r->limb must have a spare limb above r->len for the carry.
+static void round_to(bignum* r, int scale) {
+    if (r->scale <= scale) return;
+
+    int k = r->scale - scale;
+    while (k > 1) {
+        int step = k - 1 < BIG_DIGITS ? k - 1 : BIG_DIGITS;
+        mag_div_small(r->limb, r->limb, r->len, powers10[step]);
+        k -= step;
+    }
+    limb digit = mag_div_small(r->limb, r->limb, r->len, 10);
+    r->limb[r->len++] = 0;
+    if (digit >= 5) mag_add_to(r->limb, r->len, &(limb){1}, 1);
+    r->scale = scale;
+}
+
+// Digits before the decimal point (negative for leading fractional zeros)
+static int magnitude(const bignum* a) {
+    if (a->len == 0) return 0;
+    int digits = (a->len - 1) * BIG_DIGITS;
+    for (limb top = a->limb[a->len - 1]; top; top /= 10) digits++;
+    return digits - a->scale;
+}
+
+// Decimals that keep BIG_PRECISION significant digits, at least BIG_SCALE
+static int working_scale(int magnitude) {
+    return BIG_PRECISION - magnitude > BIG_SCALE ? BIG_PRECISION - magnitude : BIG_SCALE;
+}
+
+// Bring a and b to the same scale
+static int align(bignum* a, bignum* b) {
+    if (a->scale < b->scale) return scale_up(a, a, b->scale - a->scale);
+    if (b->scale < a->scale) return scale_up(b, b, a->scale - b->scale);
+    return 1;
+}
+
+int big_add(bignum* r, const bignum* a, const bignum* b) {
+    bignum x = *a, y = *b;
+    if (x.len == 0) return copy(r, &y, 0) && finish(r);
+    if (y.len == 0) return copy(r, &x, 0) && finish(r);
+    if (!align(&x, &y)) return 0;
+
+    int n = x.len > y.len ? x.len : y.len;
+    limb* l = alloc_limbs(n + 1);
+    if (!l) return 0;
+    r->limb = l;
+    r->scale = x.scale;
+
+    if (x.neg == y.neg) {
+        r->len = mag_add(l, x.limb, x.len, y.limb, y.len);
+        r->neg = x.neg;
+    } else if (mag_cmp(x.limb, x.len, y.limb, y.len) >= 0) {
+        mag_sub(l, x.limb, x.len, y.limb, y.len);
+        r->len = x.len;
+        r->neg = x.neg;
+    } else {
+        mag_sub(l, y.limb, y.len, x.limb, x.len);
+        r->len = y.len;
+        r->neg = y.neg;
+    }
+    return finish(r);
+}
+
+int big_sub(bignum* r, const bignum* a, const bignum* b) {
+    bignum negated = *b;
+    negated.neg = !negated.neg;
+    return big_add(r, a, &negated);
+}
+
+// Product, rounded to the working scale if round is set
+static int multiply(bignum* r, const bignum* a, const bignum* b, int round) {
+    if (a->len == 0 || b->len == 0) {
+        set_zero(r);
+        return 1;
+    }
+    int n = a->len + b->len;
+    if (n > BIG_MAX_LIMBS * 2) return 0;
+
+    // Result plus Karatsuba scratch, which stays under 8n limbs
+    if (arena_available() < 9 * n * sizeof(limb)) return 0;
+    limb* l = alloc_limbs(n + 1);
+    mag_mul(l, a->limb, a->len, b->limb, b->len);
+    l[n] = 0;
+
+    r->limb = l;
+    r->len = n;
+    r->neg = a->neg != b->neg;
+    r->scale = a->scale + b->scale;
+    while (r->len > 0 && r->limb[r->len - 1] == 0) r->len--;
+    if (round) round_to(r, working_scale(magnitude(r)));
+    return finish(r);
+}
+
+int big_mul(bignum* r, const bignum* a, const bignum* b) {
+    return multiply(r, a, b, 1);
+}
+
+// Integer quotient and remainder of magnitudes a / b
+static int divmod(limb* q, limb* rem, const bignum* a, const bignum* b) {
+    if (b->len == 1) {
+        rem[0] = mag_div_small(q, a->limb, a->len, b->limb[0]);
+        return 1;
+    }
+    return mag_divmod(q, rem, a->limb, a->len, b->limb, b->len);
+}
+
+// Quotient rounded to BIG_PRECISION digits; x / 0 is 0, as for doubles
+int big_div(bignum* r, const bignum* a, const bignum* b) {
+    bignum x = *a, y = *b;
+    set_zero(r);
+    if (x.len == 0 || y.len == 0) return 1;
+
+    // x * 10^k / y has exactly `scale` decimals
+    int scale = working_scale(magnitude(&x) - magnitude(&y));
+    int k = scale + y.scale - x.scale;
+    if (k > 0 && !scale_up(&x, &x, k)) return 0;
+    if (k < 0 && !scale_up(&y, &y, -k)) return 0;
+
+    // A dividend shorter than the divisor is all remainder
+    int qn = x.len >= y.len ? x.len - y.len + 1 : 1;
+    limb* q = alloc_limbs(x.len + 2);
+    limb* rem = alloc_limbs(y.len + 1);
+    if (!q || !rem) return 0;
+    if (x.len < y.len) {
+        q[0] = 0;
+        for (int i = 0; i < y.len; i++) rem[i] = i < x.len ? x.limb[i] : 0;
+    } else if (!divmod(q, rem, &x, &y)) {
+        return 0;
+    }
+
+    // Round half away from zero: compare twice the remainder to y
+    int rn = y.len;
+    while (rn > 0 && rem[rn - 1] == 0) rn--;
+    limb* twice = alloc_limbs(rn + 1);
+    if (!twice) return 0;
+    int tn = mag_add(twice, rem, rn, rem, rn);
+    while (tn > 0 && twice[tn - 1] == 0) tn--;
+
+    r->limb = q;
+    r->len = qn;
+    r->neg = x.neg != y.neg;
+    r->scale = scale;
+    q[r->len] = 0;
+    if (mag_cmp(twice, tn, y.limb, y.len) >= 0) {
+        mag_add_to(q, r->len + 1, &(limb){1}, 1);
+        r->len++;
+    }
+    return finish(r);
+}
+
+// a - trunc(a / b) * b, the sign of a; x mod 0 is 0
+int big_mod(bignum* r, const bignum* a, const bignum* b) {
+    bignum x = *a, y = *b;
+    set_zero(r);
+    if (x.len == 0 || y.len == 0) return 1;
+    if (!align(&x, &y)) return 0;
+    if (mag_cmp(x.limb, x.len, y.limb, y.len) < 0) return copy(r, &x, 0) && finish(r);
+
+    limb* q = alloc_limbs(x.len - y.len + 1);
+    limb* rem = alloc_limbs(y.len);
+    if (!q || !rem || !divmod(q, rem, &x, &y)) return 0;
+
+    r->limb = rem;
+    r->len = y.len;
+    r->neg = x.neg;
+    r->scale = x.scale;
+    return finish(r);
+}
+
+static int set_small(bignum* r, limb value) {
+    set_zero(r);
+    r->limb = alloc_limbs(1);
+    if (!r->limb) return 0;
+    r->limb[0] = value;
+    r->len = value != 0;
+    return 1;
+}
+
+// Integer exponents only, by square-and-multiply; negative ones divide.
+// Intermediate products stay exact and the result is rounded once.
+int big_pow(bignum* r, const bignum* base, const bignum* exp) {
+    if (exp->scale != 0 || exp->len > 1) return 0;
+    limb e = exp->len ? exp->limb[0] : 0;
+
+    // Same conventions as math_pow(): x^0 = 1, 0^y = 0
+    if (e == 0) return set_small(r, 1);
+    if (base->len == 0) return set_small(r, 0);
+
+    bignum result, square = *base;
+    if (!set_small(&result, 1)) return 0;
+    for (limb n = e; n; n >>= 1) {
+        if ((n & 1) && !multiply(&result, &result, &square, 0)) return 0;
+        if (n > 1 && !multiply(&square, &square, &square, 0)) return 0;
+    }
+
+    if (exp->neg) {
+        bignum one;
+        return set_small(&one, 1) && big_div(r, &one, &result);
+    }
+    *r = result;
+    return big_round(r, working_scale(magnitude(r)));
+}
+
+int big_fact(bignum* r, const bignum* n) {
+    if (n->neg || n->scale != 0 || n->len > 1) return 0;
+    limb count = n->len ? n->limb[0] : 0;
+
+    limb* l = alloc_limbs(BIG_MAX_LIMBS + 1);
+    if (!l) return 0;
+    l[0] = 1;
+    int len = 1;
+    for (limb i = 2; i <= count; i++) {
+        mag_mul_small(l, l, len, i, 0);
+        if (l[len]) len++;
+        if (len > BIG_MAX_LIMBS) return 0;
+    }
+
+    r->limb = l;
+    r->len = len;
+    r->neg = 0;
+    r->scale = 0;
+    return 1;
+}
+
+// Digit value of c in base, -1 if it is not one
+static int digit_value(char c, int base) {
+    int d = 99;
+    if (c >= '0' && c <= '9') d = c - '0';
+    else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+    return d < base ? d : -1;
+}
+
+// 0x / 0b / 0o integer, one digit at a time
+static int parse_prefixed(bignum* r, const char* s, int len, int base) {
+    int n = len / 7 + 2;  // 7 hex digits stay below one 10^9 limb
+    if (n > BIG_MAX_LIMBS + 1) return 0;
+    set_zero(r);
+    r->limb = alloc_limbs(n);
+    if (!r->limb) return 0;
+    for (int i = 2; i < len; i++) {
+        mag_mul_small(r->limb, r->limb, r->len, base, digit_value(s[i], base));
+        if (r->limb[r->len]) r->len++;
+    }
+    return finish(r);
+}
+
+// Literal as scan_number() reads it: digits with at most one '.' and an
+// optional exponent, or a 0x / 0b / 0o integer
+int big_parse(bignum* r, const char* s, int len) {
+    if (len > 2 && s[0] == '0') {
+        char c = s[1] | 0x20;
+        int base = c == 'x' ? 16 : c == 'b' ? 2 : c == 'o' ? 8 : 0;
+        if (base) return parse_prefixed(r, s, len, base);
+    }
+
+    int exponent = 0;
+    for (int i = 0; i < len; i++) {
+        if ((s[i] | 0x20) != 'e') continue;
+        int negative = i + 1 < len && s[i + 1] == '-';
+        for (int j = i + 1; j < len; j++) {
+            if (s[j] < '0' || s[j] > '9') continue;
+            exponent = exponent * 10 + (s[j] - '0');
+            if (exponent > BIG_MAX_LIMBS * BIG_DIGITS) return 0;
+        }
+        if (negative) exponent = -exponent;
+        len = i;
+        break;
+    }
+
+    int digits = 0, scale = 0, seen_point = 0;
+    for (int i = 0; i < len; i++) {
+        if (s[i] == '.') {
+            seen_point = 1;
+        } else {
+            digits++;
+            scale += seen_point;
+        }
+    }
+
+    int n = (digits + BIG_DIGITS - 1) / BIG_DIGITS;
+    if (n > BIG_MAX_LIMBS) return 0;
+    set_zero(r);
+    r->limb = alloc_limbs(n > 0 ? n : 1);
+    if (!r->limb) return 0;
+
+    // Fill limbs from the least significant digit up
+    int pos = 0;
+    limb value = 0;
+    for (int i = len - 1; i >= 0; i--) {
+        if (s[i] == '.') continue;
+        value += (s[i] - '0') * powers10[pos % BIG_DIGITS];
+        if (++pos % BIG_DIGITS == 0) {
+            r->limb[pos / BIG_DIGITS - 1] = value;
+            value = 0;
+        }
+    }
+    if (pos % BIG_DIGITS) r->limb[pos / BIG_DIGITS] = value;
+    r->len = n;
+    r->scale = scale - exponent;
+    if (r->scale < 0) {
+        // A positive exponent past the decimals: shift the digits up
+        while (r->len > 0 && r->limb[r->len - 1] == 0) r->len--;
+        if (!scale_up(r, r, -r->scale)) return 0;
+    }
+    return finish(r);
+}
+
+// Integral doubles only: any double of 2^53 or more is an integer, so
+// halve it below 2^53 (exactly), split that, then multiply back
+int big_from_double(bignum* r, double x) {
+    int neg = x < 0;
+    if (neg) x = -x;
+    if (x - x != 0) return 0;  // inf or NaN
+
+    int shift = 0;
+    while (x >= 9007199254740992.0) {
+        x *= 0.5;
+        shift++;
+    }
+    limb high = (limb)(x / BIG_BASE);
+    double low = x - (double)high * BIG_BASE;
+    if (low < 0) { high--; low += BIG_BASE; }
+    if (low >= BIG_BASE) { high++; low -= BIG_BASE; }
+    if (low != (double)(limb)low) return 0;
+
+    limb* l = alloc_limbs(3 + shift / 29 + 1);
+    if (!l) return 0;
+    l[0] = (limb)low;
+    l[1] = high % BIG_BASE;
+    l[2] = high / BIG_BASE;
+    int len = 3;
+    for (; shift > 0; shift -= 29) {
+        mag_mul_small(l, l, len, 1u << (shift < 29 ? shift : 29), 0);
+        len++;
+    }
+
+    r->limb = l;
+    r->len = len;
+    r->neg = neg;
+    r->scale = 0;
+    return finish(r);
+}
+
+// Round to at most scale decimals
+int big_round(bignum* r, int scale) {
+    if (r->scale <= scale) return 1;
+    limb* l = alloc_limbs(r->len + 1);
+    if (!l) return 0;
+    for (int i = 0; i < r->len; i++) l[i] = r->limb[i];
+    r->limb = l;
+    round_to(r, scale);
+    return finish(r);
+}
+
+// Nine digits of a limb, two at a time from a pair table
+static void limb_digits(char* out, limb v) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    for (int i = 7; i >= 1; i -= 2) {
+        limb q = v / 100;
+        const char* p = pairs + 2 * (v - q * 100);
+        out[i] = p[0];
+        out[i + 1] = p[1];
+        v = q;
+    }
+    out[0] = '0' + v;
+}
+
+// Decimal text into buf; returns its length, or 0 if it does not fit
+int big_format(const bignum* a, char* buf, int max) {
+    if (a->len == 0) {
+        if (max < 2) return 0;
+        buf[0] = '0';
+        buf[1] = '\0';
+        return 1;
+    }
+
+    char head[BIG_DIGITS];
+    limb_digits(head, a->limb[a->len - 1]);
+    int skip = 0;
+    while (skip < BIG_DIGITS - 1 && head[skip] == '0') skip++;
+    int digits = (BIG_DIGITS - skip) + (a->len - 1) * BIG_DIGITS;
+    int zeros = a->scale >= digits ? a->scale - digits + 1 : 0;  // "0.00" before the digits
+    int len = a->neg + zeros + digits + (a->scale > 0);
+    if (len + 1 > max) return 0;
+
+    char* p = buf;
+    if (a->neg) *p++ = '-';
+    for (int i = 0; i < zeros; i++) *p++ = '0';
+    for (int i = skip; i < BIG_DIGITS; i++) *p++ = head[i];
+    for (int i = a->len - 2; i >= 0; i--, p += BIG_DIGITS) limb_digits(p, a->limb[i]);
+
+    // Open a gap for the decimal point before the last scale digits
+    if (a->scale > 0) {
+        for (int i = 0; i < a->scale; i++, p--) p[0] = p[-1];
+        *p = '.';
+    }
+    buf[len] = '\0';
+    return len;
+}
@@ -0,0 +1,36 @@
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+// Exact integers and fixed decimals: value = limbs / 10^scale, limbs in
+// base 10^9, least significant first. Limbs live in the arena, so values
+// are freed with the command that made them. Functions return 0 when a
+// result would be too large or memory runs out.
+
+#define BIG_BASE 1000000000u
+#define BIG_DIGITS 9
+#define BIG_MAX_LIMBS 1024   // about 9200 digits
+#define BIG_SCALE 20         // decimals kept at least, and shown
+#define BIG_PRECISION 40     // significant digits kept by / and rounded *
+
+typedef struct {
+    unsigned int* limb;
+    int len;                 // 0 for zero
+    int neg;
+    int scale;
+} bignum;
+
+int big_parse(bignum* r, const char* s, int len);
+int big_from_double(bignum* r, double x);
+
+int big_add(bignum* r, const bignum* a, const bignum* b);
+int big_sub(bignum* r, const bignum* a, const bignum* b);
+int big_mul(bignum* r, const bignum* a, const bignum* b);
+int big_div(bignum* r, const bignum* a, const bignum* b);
+int big_mod(bignum* r, const bignum* a, const bignum* b);
+int big_pow(bignum* r, const bignum* base, const bignum* exp);
+int big_fact(bignum* r, const bignum* n);
+
+int big_round(bignum* r, int scale);
+int big_format(const bignum* a, char* buf, int max);
+
+#endif
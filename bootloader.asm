@@ -1,6 +1,16 @@
 [bits 16]
 [org 0x7c00]
 
+; The kernel image follows this boot sector on disk. The Makefile passes
+; its size in sectors; it is loaded to linear 0x10000 (segment 0x1000),
+; leaving room for kernels of several hundred KB below the 0x90000 stack.
+%ifndef KERNEL_SECTORS
+%error "KERNEL_SECTORS must be defined (nasm -DKERNEL_SECTORS=n)"
+%endif
+KERNEL_SEGMENT equ 0x1000
+KERNEL_ADDRESS equ 0x10000
+LBA_CHUNK equ 64                ; 32 KB per read, never crosses 64 KB
+
 ; Initialize segment registers
 mov ax, 0
 mov ds, ax
@@ -11,17 +21,121 @@ mov sp, 0x7c00
 ; Save boot drive
 mov [boot_drive], dl
 
-; Load kernel from disk
-mov ah, 0x02
-mov al, 32
-mov ch, 0
-mov cl, 2
-mov dh, 0
-mov dl, [boot_drive]
-mov bx, 0x1000
+; Use INT 13h extensions when the BIOS supports them for this drive
+mov ah, 0x41
+mov bx, 0x55AA
 int 0x13
-jc disk_error
+jc load_chs
+cmp bx, 0xAA55
+jne load_chs
+test cl, 1                      ; packet interface (AH=42h) available
+jz load_chs
+
+; LBA: read the kernel in 32 KB chunks. The DAP doubles as the loader
+; state (next LBA and destination segment) for the CHS path, which takes
+; over from wherever an extended read fails.
+load_lba:
+    mov ax, [sectors_left]
+    test ax, ax
+    jz load_done
+    cmp ax, LBA_CHUNK
+    jbe .count_ok
+    mov ax, LBA_CHUNK
+.count_ok:
+    mov [dap_count], ax
+    mov si, dap
+    mov ah, 0x42
+    mov dl, [boot_drive]
+    int 0x13
+    jc load_chs
+    mov ax, [dap_count]
+    call advance
+    jmp load_lba
+
+; CHS fallback: one read per track (or up to the next 64 KB boundary,
+; which floppy DMA cannot cross), using the geometry the BIOS reports
+load_chs:
+    mov ah, 0x08
+    mov dl, [boot_drive]
+    xor di, di
+    int 0x13
+    jc chs_loop                 ; keep the 1.44 MB floppy defaults
+    and cl, 0x3F
+    mov [sectors_per_track], cl
+    inc dh
+    mov [heads], dh
+
+chs_loop:
+    mov ax, [sectors_left]
+    test ax, ax
+    jz load_done
+
+    ; LBA -> track and sector
+    mov ax, [dap_lba]
+    xor dx, dx
+    movzx bx, byte [sectors_per_track]
+    div bx                      ; ax = track, dx = sector index
+    mov cl, dl
+    inc cl                      ; sectors are numbered from 1
+    mov si, bx
+    sub si, dx                  ; sectors left on this track
+
+    ; track -> cylinder and head
+    xor dx, dx
+    movzx bx, byte [heads]
+    div bx                      ; ax = cylinder, dx = head
+    mov ch, al
+    shl ah, 6
+    or cl, ah                   ; cylinder bits 8-9 go in CL bits 6-7
+    mov dh, dl
+
+    ; count = min(sectors left, rest of track, room before 64 KB boundary)
+    mov ax, [sectors_left]
+    cmp ax, si
+    jbe .track_ok
+    mov ax, si
+.track_ok:
+    mov bx, [dap_segment]
+    and bx, 0x0FFF
+    neg bx
+    add bx, 0x1000              ; paragraphs to the boundary
+    shr bx, 5                   ; in sectors
+    cmp ax, bx
+    jbe .dma_ok
+    mov ax, bx
+.dma_ok:
+    mov bx, [dap_segment]
+    mov es, bx
+    xor bx, bx
+    mov ah, 0x02
+    mov dl, [boot_drive]
+    push ax
+    int 0x13
+    pop ax
+    jnc .read_ok
 
+    ; Reset the drive and retry a few times before giving up
+    dec byte [retries]
+    jz disk_error
+    xor ah, ah
+    mov dl, [boot_drive]
+    int 0x13
+    jmp chs_loop
+.read_ok:
+    mov byte [retries], 3
+    xor ah, ah
+    call advance
+    jmp chs_loop
+
+; Account for ax sectors just read
+advance:
+    add [dap_lba], ax
+    sub [sectors_left], ax
+    shl ax, 5                   ; 512 bytes = 32 paragraphs
+    add [dap_segment], ax
+    ret
+
+load_done:
 ; Switch to protected mode
 cli
 lgdt [gdt_descriptor]
@@ -58,19 +172,31 @@ init_pm:
     mov gs, ax
     mov ebp, 0x90000
     mov esp, ebp
-    
+
     ; Enable FPU properly
     mov eax, cr0
     and eax, 0xFFFFFFF3  ; Clear EM (bit 2) and TS (bit 3)
     or eax, 0x22         ; Set MP (bit 1) and NE (bit 5) for internal FPU errors
     mov cr0, eax
-    
+
     ; Initialize FPU
     fninit
-    
-    jmp 0x1000
+
+    jmp KERNEL_ADDRESS
 
 boot_drive db 0
+retries db 3
+sectors_per_track db 18
+heads db 2
+sectors_left dw KERNEL_SECTORS
+
+; Disk address packet for INT 13h AH=42h
+dap:
+    db 0x10, 0
+dap_count dw 0
+dap_offset dw 0
+dap_segment dw KERNEL_SEGMENT
+dap_lba dd 1, 0
 
 times 510-($-$$) db 0
 dw 0xAA55
@@ -0,0 +1,98 @@
+// Result cache for Calculator OS
+// Memoizes evaluate() results by space-normalized expression
+
+#include "cache.h"
+#include "symbols.h"
+
+typedef struct {
+    cache_key key;
+    double value;
+    int exact;
+    int used;
+} cache_slot;
+
+static cache_slot slots[CACHE_SLOTS];
+
+unsigned int cache_hits = 0;
+unsigned int cache_misses = 0;
+unsigned int cache_entries = 0;
+
+static int is_word(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+// Normalize an expression into a key: spaces go, except one wherever
+// they separate two runs of name or number characters, since "1 2" and
+// "12" evaluate differently. Returns 0 if the expression cannot be
+// cached: too long, or it reads earlier results (ans, $n), whose value
+// changes as new results arrive, or user symbols, which can be redefined.
+int cache_make_key(const char* expr, int len, cache_key* key) {
+    unsigned int hash = 2166136261u;  // FNV-1a
+    int n = 0;
+    int space = 0;
+    
+    for (int i = 0; i < len; i++) {
+        char c = expr[i];
+        if (c == ' ') {  // the only blank the lexer skips; a tab is a token
+            space = 1;
+            continue;
+        }
+        if (c == '$') return 0;
+        if (space && n > 0 && is_word(key->text[n - 1]) && is_word(c)) {
+            if (n >= CACHE_KEY_MAX) return 0;
+            key->text[n++] = ' ';
+            hash = (hash ^ (unsigned char)' ') * 16777619u;
+        }
+        space = 0;
+        if (n >= CACHE_KEY_MAX) return 0;
+        key->text[n++] = c;
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    }
+    
+    // Names as the lexer reads them: a letter, then letters and digits
+    for (int i = 0; i < len; ) {
+        int start = i;
+        while (i < len && ((expr[i] >= 'a' && expr[i] <= 'z') || (expr[i] >= 'A' && expr[i] <= 'Z') ||
+                           expr[i] == '_' || (i > start && expr[i] >= '0' && expr[i] <= '9'))) i++;
+        if (i == start) {
+            i++;
+        } else if (i - start == 3 && expr[start] == 'a' && expr[start + 1] == 'n' && expr[start + 2] == 's') {
+            return 0;
+        } else if (symbols_find(expr + start, i - start) >= 0) {
+            return 0;
+        }
+    }
+    
+    key->len = n;
+    key->hash = hash;
+    return 1;
+}
+
+static int key_equal(const cache_key* a, const cache_key* b) {
+    if (a->hash != b->hash || a->len != b->len) return 0;
+    for (int i = 0; i < a->len; i++) {
+        if (a->text[i] != b->text[i]) return 0;
+    }
+    return 1;
+}
+
+int cache_lookup(const cache_key* key, double* value, int* exact) {
+    cache_slot* slot = &slots[key->hash & (CACHE_SLOTS - 1)];
+    if (slot->used && key_equal(&slot->key, key)) {
+        cache_hits++;
+        *value = slot->value;
+        *exact = slot->exact;
+        return 1;
+    }
+    cache_misses++;
+    return 0;
+}
+
+void cache_store(const cache_key* key, double value, int exact) {
+    cache_slot* slot = &slots[key->hash & (CACHE_SLOTS - 1)];
+    if (!slot->used) cache_entries++;
+    slot->key = *key;
+    slot->value = value;
+    slot->exact = exact;
+    slot->used = 1;
+}
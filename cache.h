@@ -0,0 +1,27 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+// Result cache in front of evaluate(), keyed on the expression text with
+// spaces removed where it cannot change the meaning. Direct-mapped: a
+// new key replaces whatever shared its slot.
+
+#define CACHE_SLOTS 64   // power of two
+#define CACHE_KEY_MAX 48
+
+typedef struct {
+    char text[CACHE_KEY_MAX];
+    int len;
+    unsigned int hash;
+} cache_key;
+
+// Exact says whether the result also had exact digits, which are not
+// kept: a hit needs them worked out again only when it is set
+int cache_make_key(const char* expr, int len, cache_key* key);
+int cache_lookup(const cache_key* key, double* value, int* exact);
+void cache_store(const cache_key* key, double value, int exact);
+
+extern unsigned int cache_hits;
+extern unsigned int cache_misses;
+extern unsigned int cache_entries;
+
+#endif
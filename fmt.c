@@ -0,0 +1,370 @@
+// Format module for Calculator OS
+// Shortest round-trip double to string (Ryu), with fixed and exponent forms
+
+#include "fmt.h"
+#include "fmt_table.h"
+#include "io.h"
+
+typedef unsigned long long u64;
+
+#define MANTISSA_BITS 52
+#define EXPONENT_BITS 11
+#define EXPONENT_BIAS 1023
+
+// Digit limits per mode
+#define MAX_SIGNIFICANT 17
+#define MAX_DECIMALS 20
+
+static u64 div10(u64 n) {
+    return div_u64(n, 10, 0);
+}
+
+static unsigned int mod10(u64 n) {
+    unsigned int r;
+    div_u64(n, 10, &r);
+    return r;
+}
+
+// floor(log2(5^e)) + 1 for 0 <= e <= 3528
+static int pow5bits(int e) {
+    return (int)(((unsigned int)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e)) for 0 <= e <= 1650 / 2620
+static int log10_pow2(int e) {
+    return (int)(((unsigned int)e * 78913) >> 18);
+}
+
+static int log10_pow5(int e) {
+    return (int)(((unsigned int)e * 732923) >> 20);
+}
+
+static int multiple_of_pow5(u64 value, int p) {
+    int count = 0;
+    unsigned int r;
+    while (value != 0) {
+        u64 q = div_u64(value, 5, &r);
+        if (r != 0) break;
+        value = q;
+        count++;
+    }
+    return count >= p;
+}
+
+static int multiple_of_pow2(u64 value, int p) {
+    return (value & ((1ULL << p) - 1)) == 0;
+}
+
+// floor(m * mul / 2^j) for a 125-bit mul and 64 <= j < 128, with 32-bit
+// partial products so no 128-bit type is needed
+static u64 mul_shift(u64 m, const u64* mul, int j) {
+    unsigned int a[2] = { (unsigned int)m, (unsigned int)(m >> 32) };
+    unsigned int b[4] = {
+        (unsigned int)mul[0], (unsigned int)(mul[0] >> 32),
+        (unsigned int)mul[1], (unsigned int)(mul[1] >> 32)
+    };
+    unsigned int p[7] = {0, 0, 0, 0, 0, 0, 0};
+
+    for (int i = 0; i < 2; i++) {
+        u64 carry = 0;
+        for (int k = 0; k < 4; k++) {
+            u64 t = (u64)a[i] * b[k] + p[i + k] + carry;
+            p[i + k] = (unsigned int)t;
+            carry = t >> 32;
+        }
+        p[i + 4] = (unsigned int)carry;
+    }
+
+    int w = j / 32, s = j % 32;
+    u64 low = p[w] | ((u64)p[w + 1] << 32);
+    if (s == 0) return low;
+    return (low >> s) | ((u64)p[w + 2] << (64 - s));
+}
+
+// Shortest digits of a positive finite double: value = digits * 10^exp.
+// This is Ryu's d2d with 64-bit words split for a 32-bit CPU.
+static u64 shortest(u64 mantissa, unsigned int exponent, int* exp) {
+    int e2;
+    u64 m2;
+    if (exponent == 0) {
+        e2 = 1 - EXPONENT_BIAS - MANTISSA_BITS - 2;
+        m2 = mantissa;
+    } else {
+        e2 = (int)exponent - EXPONENT_BIAS - MANTISSA_BITS - 2;
+        m2 = (1ULL << MANTISSA_BITS) | mantissa;
+    }
+
+    // Integers below 2^53 are their own shortest digits, less trailing zeros
+    int shift = -e2 - 2;
+    if (exponent != 0 && shift >= 0 && shift <= MANTISSA_BITS && (m2 & ((1ULL << shift) - 1)) == 0) {
+        u64 value = m2 >> shift;
+        int zeros = 0;
+        unsigned int r;
+        for (;;) {
+            u64 q = div_u64(value, 10, &r);
+            if (r != 0) break;
+            value = q;
+            zeros++;
+        }
+        *exp = zeros;
+        return value;
+    }
+
+    int accept_bounds = (m2 & 1) == 0;
+
+    // The interval of decimals that read back as this double: vm < vr < vp
+    u64 mv = 4 * m2;
+    unsigned int mm_shift = mantissa != 0 || exponent <= 1;
+    u64 vr, vp, vm;
+    int e10;
+    int vm_trailing_zeros = 0, vr_trailing_zeros = 0;
+
+    if (e2 >= 0) {
+        int q = log10_pow2(e2) - (e2 > 3);
+        e10 = q;
+        int k = FMT_POW5_INV_BITCOUNT + pow5bits(q) - 1;
+        int i = -e2 + q + k;
+        vr = mul_shift(4 * m2, fmt_pow5_inv[q], i);
+        vp = mul_shift(4 * m2 + 2, fmt_pow5_inv[q], i);
+        vm = mul_shift(4 * m2 - 1 - mm_shift, fmt_pow5_inv[q], i);
+        if (q <= 21) {
+            unsigned int mv_mod5;
+            div_u64(mv, 5, &mv_mod5);
+            if (mv_mod5 == 0) {
+                vr_trailing_zeros = multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        int q = log10_pow5(-e2) - (-e2 > 1);
+        e10 = q + e2;
+        int i = -e2 - q;
+        int k = pow5bits(i) - FMT_POW5_BITCOUNT;
+        int j = q - k;
+        vr = mul_shift(4 * m2, fmt_pow5[i], j);
+        vp = mul_shift(4 * m2 + 2, fmt_pow5[i], j);
+        vm = mul_shift(4 * m2 - 1 - mm_shift, fmt_pow5[i], j);
+        if (q <= 1) {
+            vr_trailing_zeros = 1;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vr_trailing_zeros = multiple_of_pow2(mv, q);
+        }
+    }
+
+    // Drop digits while the interval still holds a shorter decimal
+    int removed = 0;
+    unsigned int last = 0;
+    u64 output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        while (div10(vp) > div10(vm)) {
+            vm_trailing_zeros &= mod10(vm) == 0;
+            vr_trailing_zeros &= last == 0;
+            last = mod10(vr);
+            vr = div10(vr);
+            vp = div10(vp);
+            vm = div10(vm);
+            removed++;
+        }
+        if (vm_trailing_zeros) {
+            while (mod10(vm) == 0) {
+                vr_trailing_zeros &= last == 0;
+                last = mod10(vr);
+                vr = div10(vr);
+                vp = div10(vp);
+                vm = div10(vm);
+                removed++;
+            }
+        }
+        if (vr_trailing_zeros && last == 5 && (vr & 1) == 0) last = 4;  // ties to even
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last >= 5);
+    } else {
+        int round_up = 0;
+        while (div10(vp) > div10(vm)) {
+            round_up = mod10(vr) >= 5;
+            vr = div10(vr);
+            vp = div10(vp);
+            vm = div10(vm);
+            removed++;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    *exp = e10 + removed;
+    return output;
+}
+
+// Decimal digits of n, most significant first; returns the count
+static int write_digits(char* d, u64 n) {
+    char tmp[20];
+    int count = 0;
+    unsigned int low;
+
+    // Two divl per 8 digits, then plain 32-bit arithmetic
+    while (n >> 32) {
+        n = div_u64(n, 100000000, &low);
+        for (int i = 0; i < 8; i++) {
+            tmp[count++] = '0' + low % 10;
+            low /= 10;
+        }
+    }
+    low = (unsigned int)n;
+    do {
+        tmp[count++] = '0' + low % 10;
+        low /= 10;
+    } while (low);
+
+    for (int i = 0; i < count; i++) d[i] = tmp[count - 1 - i];
+    return count;
+}
+
+// Keep the first keep digits of d (value 0.d * 10^*dp), rounding half up.
+// May carry into a new leading digit; n becomes 0 if nothing is left.
+static void round_digits(char* d, int* n, int* dp, int keep) {
+    if (keep >= *n) return;
+    if (keep < 0) {
+        *n = 0;
+        return;
+    }
+    int up = d[keep] >= '5';
+    *n = keep;
+    if (!up) return;
+
+    int i = keep - 1;
+    while (i >= 0 && d[i] == '9') i--;
+    if (i < 0) {
+        d[0] = '1';
+        *n = 1;
+        (*dp)++;
+    } else {
+        d[i]++;
+        *n = i + 1;
+    }
+}
+
+static void strip_zeros(const char* d, int* n) {
+    while (*n > 0 && d[*n - 1] == '0') (*n)--;
+}
+
+// Plain decimal with exactly decimals places
+static int write_fixed(char* buf, const char* d, int n, int dp, int decimals) {
+    int len = 0;
+    if (dp <= 0) {
+        buf[len++] = '0';
+    } else {
+        for (int i = 0; i < dp; i++) buf[len++] = i < n ? d[i] : '0';
+    }
+    if (decimals > 0) {
+        buf[len++] = '.';
+        for (int i = 0; i < decimals; i++) {
+            int k = dp + i;
+            buf[len++] = k >= 0 && k < n ? d[k] : '0';
+        }
+    }
+    return len;
+}
+
+// d.ddd e+x with exactly decimals places
+static int write_scientific(char* buf, const char* d, int n, int dp, int decimals) {
+    int len = 0;
+    buf[len++] = n > 0 ? d[0] : '0';
+    if (decimals > 0) {
+        buf[len++] = '.';
+        for (int i = 1; i <= decimals; i++) buf[len++] = i < n ? d[i] : '0';
+    }
+    int x = n > 0 ? dp - 1 : 0;
+    buf[len++] = 'e';
+    buf[len++] = x < 0 ? '-' : '+';
+    if (x < 0) x = -x;
+    if (x >= 100) buf[len++] = '0' + x / 100;
+    if (x >= 10) buf[len++] = '0' + x / 10 % 10;
+    buf[len++] = '0' + x % 10;
+    return len;
+}
+
+static int write_text(char* buf, const char* s) {
+    int len = 0;
+    while (s[len]) {
+        buf[len] = s[len];
+        len++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+int fmt_double(char* buf, double value, int mode, int precision) {
+    union {
+        double d;
+        u64 bits;
+    } u = { value };
+    int negative = (int)(u.bits >> 63);
+    u64 mantissa = u.bits & ((1ULL << MANTISSA_BITS) - 1);
+    unsigned int exponent = (unsigned int)(u.bits >> MANTISSA_BITS) & ((1u << EXPONENT_BITS) - 1);
+
+    if (exponent == (1u << EXPONENT_BITS) - 1) {
+        if (mantissa) return write_text(buf, "nan");
+        return write_text(buf, negative ? "-inf" : "inf");
+    }
+
+    // Significant digits d, value = 0.d * 10^dp; no digits for zero
+    char d[MAX_SIGNIFICANT + 3];
+    int n = 0, dp = 0;
+    if (exponent != 0 || mantissa != 0) {
+        int exp;
+        n = write_digits(d, shortest(mantissa, exponent, &exp));
+        dp = n + exp;
+    }
+
+    if (precision < 0) precision = 0;
+    int len = 0;
+    char body[FMT_MAX];
+    switch (mode) {
+    case FMT_GENERAL:
+        if (precision < 1) precision = 1;
+        if (precision > MAX_SIGNIFICANT) precision = MAX_SIGNIFICANT;
+        round_digits(d, &n, &dp, precision);
+        strip_zeros(d, &n);
+        if (n > 0 && (dp - 1 < -4 || dp - 1 >= precision)) {
+            len = write_scientific(body, d, n, dp, n - 1);
+        } else {
+            len = write_fixed(body, d, n, dp, n - dp > 0 ? n - dp : 0);
+        }
+        break;
+    case FMT_FIXED:
+        if (precision > MAX_DECIMALS) precision = MAX_DECIMALS;
+        if (dp > 21) {
+            if (precision > MAX_SIGNIFICANT - 1) precision = MAX_SIGNIFICANT - 1;
+            round_digits(d, &n, &dp, precision + 1);
+            len = write_scientific(body, d, n, dp, precision);
+            break;
+        }
+        round_digits(d, &n, &dp, dp + precision);
+        len = write_fixed(body, d, n, dp, precision);
+        break;
+    case FMT_SCIENTIFIC:
+        if (precision > MAX_SIGNIFICANT - 1) precision = MAX_SIGNIFICANT - 1;
+        round_digits(d, &n, &dp, precision + 1);
+        len = write_scientific(body, d, n, dp, precision);
+        break;
+    default:
+        if (n > 0 && (dp - 1 < -6 || dp - 1 >= 21)) {
+            len = write_scientific(body, d, n, dp, n - 1);
+        } else {
+            len = write_fixed(body, d, n, dp, n - dp > 0 ? n - dp : 0);
+        }
+        break;
+    }
+
+    // No sign on values that are or rounded to zero
+    int out = 0;
+    if (negative && n > 0) buf[out++] = '-';
+    for (int i = 0; i < len; i++) buf[out++] = body[i];
+    buf[out] = '\0';
+    return out;
+}
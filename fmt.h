@@ -0,0 +1,24 @@
+#ifndef FMT_H
+#define FMT_H
+
+// Double to decimal text, shared by the screen, serial and log output.
+// Digits come from a shortest round-trip conversion (Ryu): the fewest
+// significant digits that read back as the same double, the closest
+// such digits when several qualify. The other modes round those digits
+// (half up), not the binary value.
+
+enum fmt_mode {
+    FMT_SHORTEST,    // all shortest digits; exponent form below 1e-6 or from 1e21
+    FMT_GENERAL,     // precision significant digits, like %g
+    FMT_FIXED,       // precision decimals (exponent form from 1e21)
+    FMT_SCIENTIFIC   // precision decimals before the exponent
+};
+
+// Longest output, terminator included
+#define FMT_MAX 48
+
+// Writes a terminated string to buf and returns its length. NaN and
+// infinities come out as "nan", "inf" and "-inf"; -0 as "0".
+int fmt_double(char* buf, double value, int mode, int precision);
+
+#endif
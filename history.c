@@ -0,0 +1,167 @@
+// Scrollback history for Calculator OS
+// Packed recent lines plus a run-length encoded archive of older ones
+
+#include "history.h"
+
+// Archive encoding, one record per line:
+//   0x00         end of line, the rest of the line is blank
+//   0x01-0x7F    literal: that many characters follow, current attribute
+//   0x83-0xFE    repeat: (op & 0x7F) copies of the next character
+//   0xFF         next byte becomes the current attribute
+// The attribute starts as the blank cell's, and trailing blanks are dropped.
+#define RLE_END 0x00
+#define RLE_REPEAT 0x80
+#define RLE_ATTR 0xFF
+#define RLE_MAX_LITERAL 0x7F
+#define RLE_MAX_REPEAT 0x7E
+#define RLE_MAX_RECORD (VGA_WIDTH * 4 + 1)
+
+static unsigned short recent[HISTORY_RECENT_LINES][VGA_WIDTH];
+
+static unsigned char archive[HISTORY_ARCHIVE_BYTES];
+static unsigned short archive_start[HISTORY_INDEX_LINES];  // record offset per line
+static unsigned int archive_head = 0;   // next free byte
+static unsigned int archive_used = 0;   // bytes held by live records
+static int archive_first = 0;           // oldest line still archived
+
+static unsigned short decoded[VGA_WIDTH];
+
+int history_total = 1;
+
+static int archived_end(void) {
+    return history_total > HISTORY_RECENT_LINES ? history_total - HISTORY_RECENT_LINES : 0;
+}
+
+static int encode_line(const unsigned short* cells, unsigned char* out) {
+    int end = VGA_WIDTH;
+    while (end > 0 && cells[end - 1] == HISTORY_BLANK) end--;
+    
+    unsigned char attr = HISTORY_BLANK >> 8;
+    int len = 0;
+    int x = 0;
+    while (x < end) {
+        unsigned char a = cells[x] >> 8;
+        if (a != attr) {
+            out[len++] = RLE_ATTR;
+            out[len++] = a;
+            attr = a;
+        }
+        
+        int run = 1;
+        while (x + run < end && run < RLE_MAX_REPEAT && cells[x + run] == cells[x]) run++;
+        if (run >= 3) {
+            out[len++] = RLE_REPEAT | run;
+            out[len++] = (unsigned char)cells[x];
+            x += run;
+            continue;
+        }
+        
+        // Literal up to the next attribute change or repeat run
+        int count_at = len++;
+        int count = 0;
+        while (x < end && count < RLE_MAX_LITERAL && (cells[x] >> 8) == attr) {
+            if (count > 0 && x + 2 < end && cells[x] == cells[x + 1] && cells[x] == cells[x + 2]) break;
+            out[len++] = (unsigned char)cells[x++];
+            count++;
+        }
+        out[count_at] = count;
+    }
+    out[len++] = RLE_END;
+    return len;
+}
+
+static void decode_line(unsigned int pos, unsigned short* cells) {
+    unsigned char attr = HISTORY_BLANK >> 8;
+    int x = 0;
+    
+    while (1) {
+        unsigned char op = archive[pos];
+        if (++pos == HISTORY_ARCHIVE_BYTES) pos = 0;
+        if (op == RLE_END) break;
+        
+        if (op == RLE_ATTR) {
+            attr = archive[pos];
+            if (++pos == HISTORY_ARCHIVE_BYTES) pos = 0;
+        } else if (op & RLE_REPEAT) {
+            unsigned short cell = VGA_CELL(archive[pos], attr);
+            if (++pos == HISTORY_ARCHIVE_BYTES) pos = 0;
+            for (int n = op & ~RLE_REPEAT; n > 0 && x < VGA_WIDTH; n--) cells[x++] = cell;
+        } else {
+            for (int n = op; n > 0; n--) {
+                if (x < VGA_WIDTH) cells[x++] = VGA_CELL(archive[pos], attr);
+                if (++pos == HISTORY_ARCHIVE_BYTES) pos = 0;
+            }
+        }
+    }
+    while (x < VGA_WIDTH) cells[x++] = HISTORY_BLANK;
+}
+
+// Drop the oldest archived line, returning its bytes to the ring
+static void evict_oldest(int end) {
+    unsigned int start = archive_start[archive_first % HISTORY_INDEX_LINES];
+    unsigned int next = archive_first + 1 < end
+        ? archive_start[(archive_first + 1) % HISTORY_INDEX_LINES]
+        : archive_head;
+    archive_used -= (next + HISTORY_ARCHIVE_BYTES - start) % HISTORY_ARCHIVE_BYTES;
+    archive_first++;
+    if (archive_first == end) archive_used = 0;
+}
+
+static void archive_line(int line, const unsigned short* cells) {
+    unsigned char record[RLE_MAX_RECORD];
+    int len = encode_line(cells, record);
+    
+    while (archive_first < line &&
+           (line - archive_first >= HISTORY_INDEX_LINES ||
+            archive_used + len > HISTORY_ARCHIVE_BYTES)) {
+        evict_oldest(line);
+    }
+    
+    archive_start[line % HISTORY_INDEX_LINES] = archive_head;
+    for (int i = 0; i < len; i++) {
+        archive[archive_head] = record[i];
+        if (++archive_head == HISTORY_ARCHIVE_BYTES) archive_head = 0;
+    }
+    archive_used += len;
+}
+
+void history_init(void) {
+    for (int i = 0; i < HISTORY_RECENT_LINES; i++) {
+        vga_fill_cells(recent[i], HISTORY_BLANK, VGA_WIDTH);
+    }
+    history_total = 1;
+    archive_head = 0;
+    archive_used = 0;
+    archive_first = 0;
+}
+
+// Start a new current line. The line leaving the recent ring is archived.
+void history_newline(void) {
+    int line = history_total;
+    unsigned short* slot = recent[line % HISTORY_RECENT_LINES];
+    if (line >= HISTORY_RECENT_LINES) {
+        archive_line(line - HISTORY_RECENT_LINES, slot);
+    }
+    vga_fill_cells(slot, HISTORY_BLANK, VGA_WIDTH);
+    history_total++;
+}
+
+// Oldest line that can still be shown
+int history_oldest(void) {
+    return archived_end() > 0 ? archive_first : 0;
+}
+
+// Cells of a line, or 0 if it is no longer held. Archived lines are
+// decoded into a shared scratch line, valid until the next call.
+const unsigned short* history_line(int line) {
+    if (line >= history_total || line < history_oldest()) return 0;
+    if (line >= archived_end()) return recent[line % HISTORY_RECENT_LINES];
+    decode_line(archive_start[line % HISTORY_INDEX_LINES], decoded);
+    return decoded;
+}
+
+// Only recent lines are writable; the screen never shows older ones live
+void history_put(int line, int x, unsigned short cell) {
+    if (line < archived_end() || line >= history_total) return;
+    if (x >= 0 && x < VGA_WIDTH) recent[line % HISTORY_RECENT_LINES][x] = cell;
+}
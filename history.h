@@ -0,0 +1,27 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "vga.h"
+
+// Scrollback history. Lines are numbered from 0 since boot. The newest
+// HISTORY_RECENT_LINES are kept as packed VGA cells so a line reaches the
+// screen with one block copy; older lines are run-length encoded into a
+// byte ring and dropped oldest-first when it fills.
+//
+// Memory: 40 * 160 + 19456 + 3072 * 2 = 32000 bytes, the same as the old
+// 200-line char + color arrays, for a few thousand lines of typical output.
+#define HISTORY_RECENT_LINES 40
+#define HISTORY_ARCHIVE_BYTES 19456
+#define HISTORY_INDEX_LINES 3072
+
+#define HISTORY_BLANK VGA_CELL(' ', 0x0F)
+
+extern int history_total;  // lines so far; line history_total - 1 is current
+
+void history_init(void);
+void history_newline(void);
+int history_oldest(void);
+const unsigned short* history_line(int line);
+void history_put(int line, int x, unsigned short cell);
+
+#endif
@@ -0,0 +1,642 @@
+// Host-side microbenchmarks for the Calculator OS math engine.
+// Builds math.c natively (see `make bench`) and reports ns/op, ops/sec
+// and accuracy against the host libm.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calc.h"
+#include "../math.h"
+#include "../fmt.h"
+#include "../mem.h"
+#include "../scan.h"
+#include "../sci.h"
+#include "../symbols.h"
+
+#define TARGET_NS 50000000.0  // ~50ms of timing per case
+
+static volatile double sink;
+
+typedef struct {
+    const char* expr;
+    double expected;
+} corpus_entry;
+
+// Fixed expression corpus with libm reference values
+static corpus_entry corpus[] = {
+    { "1+2*3",                      7.0 },
+    { "(3 + 4) * 2 - 5 / 10",       13.5 },
+    { "2^10",                       1024.0 },
+    { "2^0.5",                      1.4142135623730951 },
+    { "sqrt(2)",                    1.4142135623730951 },
+    { "root(3, 27)",                3.0 },
+    { "abs(-5) + 10 % 3",           6.0 },
+    { "3.14159 * 2.5 ^ 2",          19.6349375 },
+    { "1.5^20",                     3325.256730079651 },
+    { "10^-3",                      0.001 },
+    { "7^0.333",                    1.911690787697772 },
+    { "((1+2)*(3+4)*(5+6))/(7-8)",  -231.0 },
+    { "0.1+0.2",                    0.30000000000000004 },
+    { "100 mod 7 + sqrt(144) * -3", -34.0 },
+    { "sum(i=1 to 1000000, 1/i)",   14.392726722865724 },
+    { "sum(i=1 to 1000, 1/i^2)",    1.6439345666815597 },
+    { "integral(x=0 to 1, 4/(1+x^2))", 3.141592653589793 },
+    { "integral(x=1 to 2, 1/x)",    0.6931471805599453 },
+    { "6.02214076e23 / 0x10",       3.7638379750000000e22 },
+    { "3.14159265358979323846264338327950288 * 2", 6.283185307179586 },
+    { "atan(1) * 4",                3.141592653589793 },
+    { "sin(pi/6) + cos(pi/3)",      1.0 },
+    { "log(2, 1024) + log(1000)",   13.0 },
+    { "integral(x=0 to pi, sin(x))", 2.0 },
+    { "d/dx(sin(x) * x^2, 1)",      2.2232442754839328 },
+    { "solve(x^3 - 2x = 5, x, 2)",  2.0945514815423265 },
+    { "solve(cos(x) = x, x)",       0.7390851332151607 },
+};
+
+#define CORPUS_SIZE ((int)(sizeof(corpus) / sizeof(corpus[0])))
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char* name, const char* arg, long iters, double elapsed) {
+    double ns = elapsed / iters;
+    printf("  %-14s %-28s %10.1f ns/op %12.0f ops/sec\n", name, arg, ns, 1e9 / ns);
+}
+
+// Each bench_* runs its kernel `iters` times and returns elapsed ns.
+// run_timed() doubles the count until the run is long enough to trust.
+typedef double (*bench_fn)(const void* arg, long iters);
+
+static void run_timed(const char* name, const char* label, bench_fn fn, const void* arg) {
+    long iters = 16;
+    double elapsed = fn(arg, iters);
+    while (elapsed < TARGET_NS && iters < (1L << 30)) {
+        iters *= 2;
+        elapsed = fn(arg, iters);
+    }
+    report(name, label, iters, elapsed);
+}
+
+static double bench_evaluate(const void* arg, long iters) {
+    const char* expr = arg;
+    int len = (int)strlen(expr);
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = evaluate(expr, len);
+    return now_ns() - start;
+}
+
+static double bench_compile(const void* arg, long iters) {
+    const char* expr = arg;
+    int len = (int)strlen(expr);
+    math_program prog;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = math_compile(expr, len, &prog);
+    return now_ns() - start;
+}
+
+static double bench_run(const void* arg, long iters) {
+    const math_program* prog = arg;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = math_run(prog);
+    return now_ns() - start;
+}
+
+static double bench_define(const void* arg, long iters) {
+    const char* text = arg;
+    int len = (int)strlen(text);
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = symbols_define(text, len);
+    return now_ns() - start;
+}
+
+// calc_eval_batch() over the corpus, repeated, on 1, 2, 4, ... threads.
+// The million-term sum is left out so no one expression dominates.
+#define BATCH_SIZE 65536
+
+static void bench_batch(void) {
+    static const char* exprs[BATCH_SIZE];
+    static double want[BATCH_SIZE], out[BATCH_SIZE];
+    int n = 0;
+    while (n < BATCH_SIZE) {
+        for (int i = 0; i < CORPUS_SIZE && n < BATCH_SIZE; i++) {
+            if (strstr(corpus[i].expr, "1000000")) continue;
+            exprs[n] = corpus[i].expr;
+            want[n] = evaluate(exprs[n], (int)strlen(exprs[n]));
+            n++;
+        }
+    }
+
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double base = 0;
+    printf("\ncalc_eval_batch() (%d expressions, %d CPUs online)\n", BATCH_SIZE, cpus);
+    for (int threads = 1; threads <= cpus || threads == 1; threads *= 2) {
+        calc_pool* pool = calc_pool_create(threads);
+        calc_eval_batch(pool, exprs, 0, out, BATCH_SIZE);  // warm up
+        double best = 0;
+        for (int run = 0; run < 5; run++) {
+            double start = now_ns();
+            calc_eval_batch(pool, exprs, 0, out, BATCH_SIZE);
+            double elapsed = now_ns() - start;
+            if (run == 0 || elapsed < best) best = elapsed;
+        }
+        int wrong = 0;
+        for (int i = 0; i < BATCH_SIZE; i++) wrong += memcmp(&out[i], &want[i], sizeof(double)) != 0;
+        if (threads == 1) base = best;
+        printf("  %-14s %2d threads %24.1f ns/expr %12.0f exprs/sec  x%.2f  %d differ\n", "batch",
+               calc_pool_threads(pool), best / BATCH_SIZE, BATCH_SIZE * 1e9 / best, base / best, wrong);
+        calc_pool_destroy(pool);
+    }
+}
+
+// math_run_array() over a block of x values
+#define ARRAY_SIZE 1024
+
+static double bench_array(const void* arg, long iters) {
+    const math_program* prog = arg;
+    static double x[ARRAY_SIZE], out[ARRAY_SIZE];
+    for (int i = 0; i < ARRAY_SIZE; i++) x[i] = i * 0.01;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        math_run_array(prog, x, out, ARRAY_SIZE);
+        sink = out[ARRAY_SIZE - 1];
+    }
+    return now_ns() - start;
+}
+
+typedef struct {
+    double a, b;
+} pair;
+
+// The same root through solve() and through Newton's method on central
+// differences, which needs three evaluations a step where solve() makes
+// one pass over dual numbers, and gets a slope good to only about 1e-10
+typedef struct {
+    const char* equation;  // for solve()
+    const char* fn;        // f(x) whose root it is
+    double guess;
+    double root;
+} solve_case;
+
+static double fd_newton(const math_program* prog, double x, int* evals) {
+    for (int step = 0; step < 100; step++) {
+        double h = 6e-6 * (fabs(x) + 1);  // about the cube root of an ulp
+        double f = math_run_at(prog, x);
+        double slope = (math_run_at(prog, x + h) - math_run_at(prog, x - h)) / (2 * h);
+        double next = x - f / slope;
+        *evals += 3;
+        if (next == x) break;  // the stopping rule solve() uses
+        x = next;
+    }
+    return x;
+}
+
+static double bench_fd_newton(const void* arg, long iters) {
+    const solve_case* c = arg;
+    math_program prog;
+    math_compile_fn(c->fn, (int)strlen(c->fn), "x", &prog);
+    int evals = 0;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = fd_newton(&prog, c->guess, &evals);
+    return now_ns() - start;
+}
+
+static double bench_pow(const void* arg, long iters) {
+    const pair* p = arg;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = math_pow(p->a, p->b);
+    return now_ns() - start;
+}
+
+static double bench_sqrt(const void* arg, long iters) {
+    const pair* p = arg;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = math_sqrt(p->a);
+    return now_ns() - start;
+}
+
+static double bench_mod(const void* arg, long iters) {
+    const pair* p = arg;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = math_mod(p->a, p->b);
+    return now_ns() - start;
+}
+
+typedef struct {
+    double value;
+    int mode, precision;
+} fmt_case;
+
+static double bench_scan(const void* arg, long iters) {
+    const char* text = arg;
+    const char* end = text + strlen(text);
+    double value;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) {
+        scan_number(text, end, &value);
+        sink = value;
+    }
+    return now_ns() - start;
+}
+
+static double bench_strtod(const void* arg, long iters) {
+    const char* text = arg;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = strtod(text, 0);
+    return now_ns() - start;
+}
+
+typedef struct {
+    double (*fn)(double);
+    double x;
+} unary_case;
+
+static double bench_unary(const void* arg, long iters) {
+    const unary_case* c = arg;
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = c->fn(c->x);
+    return now_ns() - start;
+}
+
+// The x87 instructions the Level 3 kernels replace; valid below 2^63
+static double x87_fsin(double x) {
+    long double r;
+    __asm__ ("fsin" : "=t" (r) : "0" ((long double)x));
+    return (double)r;
+}
+
+static double x87_fcos(double x) {
+    long double r;
+    __asm__ ("fcos" : "=t" (r) : "0" ((long double)x));
+    return (double)r;
+}
+
+// Digits of a formatted number, less leading zeros and an integer's trailing zeros
+static int significant_digits(const char* s) {
+    int digits = 0, zeros = 0;
+    for (; *s && *s != 'e'; s++) {
+        if (*s == '.') {
+            zeros = 0;
+        } else if (*s == '0') {
+            if (digits) zeros++;
+        } else if (*s >= '1' && *s <= '9') {
+            digits += zeros + 1;
+            zeros = 0;
+        }
+    }
+    return digits;
+}
+
+static double bench_fmt(const void* arg, long iters) {
+    const fmt_case* c = arg;
+    char buf[FMT_MAX];
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = fmt_double(buf, c->value, c->mode, c->precision);
+    return now_ns() - start;
+}
+
+static double bench_snprintf(const void* arg, long iters) {
+    const fmt_case* c = arg;
+    char buf[FMT_MAX];
+    double start = now_ns();
+    for (long i = 0; i < iters; i++) sink = snprintf(buf, sizeof(buf), "%.17g", c->value);
+    return now_ns() - start;
+}
+
+// Error of got versus want, in units in the last place of want
+static double ulp_error(double got, double want) {
+    if (got == want) return 0;
+    if (isnan(got) || isnan(want) || isinf(got) || isinf(want)) return INFINITY;
+    double ulp = nextafter(fabs(want), INFINITY) - fabs(want);
+    return fabs(got - want) / ulp;
+}
+
+typedef struct {
+    const char* name;
+    double max_ulp;
+    double sum_ulp;
+    double max_rel;
+    double worst_a, worst_b;
+    long count;
+} accuracy;
+
+static void track(accuracy* acc, double got, double want, double a, double b) {
+    double e = ulp_error(got, want);
+    if (e > acc->max_ulp || acc->count == 0) {
+        acc->max_ulp = e;
+        acc->worst_a = a;
+        acc->worst_b = b;
+    }
+    if (!isinf(e)) acc->sum_ulp += e;
+    if (want != 0 && fabs((got - want) / want) > acc->max_rel) {
+        acc->max_rel = fabs((got - want) / want);
+    }
+    acc->count++;
+}
+
+static void report_accuracy(const accuracy* acc) {
+    printf("  %-12s max %10.4g ulp  mean %10.4g ulp  max rel %9.3g  worst at (%g, %g)  [%ld samples]\n",
+           acc->name, acc->max_ulp, acc->sum_ulp / acc->count, acc->max_rel,
+           acc->worst_a, acc->worst_b, acc->count);
+}
+
+// Error of got versus an extended-precision reference, in ulps of the
+// double nearest to it
+static double ulp_error_l(double got, long double want) {
+    if (isnan(got) || isinf(got)) return INFINITY;
+    int e;
+    frexpl(want, &e);
+    if (e < -1021) e = -1021;
+    return (double)(fabsl(got - want) / ldexpl(1, e - 53));
+}
+
+enum { UNIFORM, LOG_UNIFORM, NEAR_PI };
+
+// Max and mean ulp error of f over n samples of [lo, hi]; NEAR_PI takes
+// the doubles closest to k * pi/2 for k up to hi, where reduction is hardest
+static void report_unary(const char* name, double (*f)(double), long double (*ref)(long double),
+                         int sampling, double lo, double hi) {
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    double max = 0, sum = 0, worst = 0;
+    int n = 200000;
+    for (int i = 0; i < n; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double u = (state >> 11) * 0x1p-53;
+        double x;
+        if (sampling == UNIFORM) x = lo + (hi - lo) * u;
+        else if (sampling == LOG_UNIFORM) x = exp(log(lo) + (log(hi) - log(lo)) * u) * (1 + (state & 0xFFFF) * 0x1p-40);
+        else x = floor(1 + (hi - 1) * u) * 1.57079632679489661923;
+        double e = ulp_error_l(f(x), ref(x));
+        sum += e;
+        if (e > max) {
+            max = e;
+            worst = x;
+        }
+    }
+    char range[40];
+    if (sampling == NEAR_PI) snprintf(range, sizeof(range), "k*pi/2, k < %g", hi);
+    else snprintf(range, sizeof(range), "[%g, %g]", lo, hi);
+    printf("  %-10s %-22s max %10.4g ulp  mean %8.4f ulp  worst at %.17g\n",
+           name, range, max, sum / n, worst);
+}
+
+static void sci_accuracy(void) {
+    printf("\nLevel 3 accuracy vs long double libm (x87 fsin/fcos for comparison)\n");
+    report_unary("sci_sin", sci_sin, sinl, UNIFORM, -3.14159265358979, 3.14159265358979);
+    report_unary("x87 fsin", x87_fsin, sinl, UNIFORM, -3.14159265358979, 3.14159265358979);
+    report_unary("sci_sin", sci_sin, sinl, NEAR_PI, 0, 1e6);
+    report_unary("x87 fsin", x87_fsin, sinl, NEAR_PI, 0, 1e6);
+    report_unary("sci_sin", sci_sin, sinl, LOG_UNIFORM, 1e6, 1e18);
+    report_unary("x87 fsin", x87_fsin, sinl, LOG_UNIFORM, 1e6, 1e18);
+    report_unary("sci_sin", sci_sin, sinl, LOG_UNIFORM, 1e18, 1e300);
+    report_unary("sci_cos", sci_cos, cosl, UNIFORM, -3.14159265358979, 3.14159265358979);
+    report_unary("x87 fcos", x87_fcos, cosl, UNIFORM, -3.14159265358979, 3.14159265358979);
+    report_unary("sci_cos", sci_cos, cosl, NEAR_PI, 0, 1e6);
+    report_unary("x87 fcos", x87_fcos, cosl, NEAR_PI, 0, 1e6);
+    report_unary("sci_tan", sci_tan, tanl, UNIFORM, -1.57, 1.57);
+    report_unary("sci_asin", sci_asin, asinl, UNIFORM, -1, 1);
+    report_unary("sci_acos", sci_acos, acosl, UNIFORM, -1, 1);
+    report_unary("sci_atan", sci_atan, atanl, UNIFORM, -20, 20);
+    report_unary("sci_atan", sci_atan, atanl, LOG_UNIFORM, 1e-10, 1e300);
+    report_unary("sci_ln", sci_ln, logl, UNIFORM, 0.5, 2);
+    report_unary("sci_ln", sci_ln, logl, LOG_UNIFORM, 1e-300, 1e300);
+    report_unary("sci_log10", sci_log10, log10l, LOG_UNIFORM, 1e-300, 1e300);
+}
+
+static void accuracy_suite(void) {
+    accuracy pow_acc = { "math_pow", 0, 0, 0, 0, 0, 0 };
+    accuracy sqrt_acc = { "math_sqrt", 0, 0, 0, 0, 0, 0 };
+    accuracy mod_acc = { "math_mod", 0, 0, 0, 0, 0, 0 };
+    accuracy eval_acc = { "evaluate", 0, 0, 0, 0, 0, 0 };
+
+    for (double base = 0.01; base < 1000; base *= 1.37) {
+        for (double e = -12.0; e <= 12.0; e += 0.37) {
+            track(&pow_acc, math_pow(base, e), pow(base, e), base, e);
+        }
+        for (int e = -30; e <= 30; e++) {
+            track(&pow_acc, math_pow(base, e), pow(base, e), base, e);
+        }
+    }
+    for (double x = 1e-300; x < 1e300; x *= 1.113) {
+        track(&sqrt_acc, math_sqrt(x), sqrt(x), x, 0);
+    }
+    for (double a = -1e6; a < 1e6; a += 7919.3) {
+        for (double b = 0.7; b < 5000; b *= 2.9) {
+            track(&mod_acc, math_mod(a, b), fmod(a, b), a, b);
+        }
+    }
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        double got = evaluate(corpus[i].expr, (int)strlen(corpus[i].expr));
+        track(&eval_acc, got, corpus[i].expected, i, 0);
+    }
+
+    // Shortest output must read back exactly, in no more digits than %.*e needs
+    long fmt_count = 0, fmt_bad = 0, fmt_long = 0;
+    unsigned long long bits = 88172645463325252ULL;
+    for (int i = 0; i < 1000000; i++) {
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        if (!isfinite(v)) continue;
+        char buf[FMT_MAX], ref[32];
+        fmt_double(buf, v, FMT_SHORTEST, 0);
+        fmt_count++;
+        if (strtod(buf, 0) != v) fmt_bad++;
+        int digits = significant_digits(buf);
+        for (int n = 1; n < digits; n++) {
+            snprintf(ref, sizeof(ref), "%.*e", n - 1, v);
+            if (strtod(ref, 0) == v) {
+                fmt_long++;
+                break;
+            }
+        }
+    }
+
+    // Decimal literals must read exactly as the host strtod reads them
+    long scan_count = 0, scan_bad = 0;
+    for (int i = 0; i < 300000; i++) {
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        if (!isfinite(v)) continue;
+        char buf[64];
+        double got;
+        snprintf(buf, sizeof(buf), "%.*e", 1 + (int)(bits >> 59), fabs(v));
+        scan_number(buf, buf + strlen(buf), &got);
+        scan_count++;
+        if (got != strtod(buf, 0)) scan_bad++;
+    }
+
+    printf("\nAccuracy vs libm (worst arguments shown; evaluate shows corpus index)\n");
+    report_accuracy(&pow_acc);
+    report_accuracy(&sqrt_acc);
+    report_accuracy(&mod_acc);
+    report_accuracy(&eval_acc);
+    printf("  %-14s %ld random doubles: %ld fail to round-trip, %ld longer than needed\n",
+           "fmt_double", fmt_count, fmt_bad, fmt_long);
+    printf("  %-14s %ld random literals of 2-32 digits: %ld differ from strtod\n",
+           "scan_number", scan_count, scan_bad);
+}
+
+int main(void) {
+    static char arena[1 << 20];
+    char label[64];
+
+    mem_init(arena, sizeof(arena));  // sums and integrals keep their lanes here
+    symbols_init();
+
+    printf("Calculator OS math engine benchmark\n\nevaluate() (compile + run)\n");
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        snprintf(label, sizeof(label), "\"%s\"", corpus[i].expr);
+        run_timed("evaluate", label, bench_evaluate, corpus[i].expr);
+    }
+
+    printf("\nmath_compile() (lex + parse + emit)\n");
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        snprintf(label, sizeof(label), "\"%s\"", corpus[i].expr);
+        run_timed("math_compile", label, bench_compile, corpus[i].expr);
+    }
+
+    printf("\nmath_run() (precompiled)\n");
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        math_program prog;
+        math_compile(corpus[i].expr, (int)strlen(corpus[i].expr), &prog);
+        snprintf(label, sizeof(label), "\"%s\"", corpus[i].expr);
+        run_timed("math_run", label, bench_run, &prog);
+    }
+
+    static const char* const array_exprs[] = { "x^2 + 3*x - 1", "sqrt(x) * (x + 1) / 7", "x^1.5" };
+    printf("\nmath_run_array() (%d values per call)\n", ARRAY_SIZE);
+    for (unsigned i = 0; i < sizeof(array_exprs) / sizeof(array_exprs[0]); i++) {
+        math_program prog;
+        math_compile_fn(array_exprs[i], (int)strlen(array_exprs[i]), "x", &prog);
+        snprintf(label, sizeof(label), "\"%s\"", array_exprs[i]);
+        run_timed("math_run_array", label, bench_array, &prog);
+    }
+
+    // Half the definitions read x, directly or through d0, and half read
+    // w, so redefining x recomputes 14 of them and leaves the rest cached
+    printf("\nsymbols_define() (redefinition, dependents recomputed)\n");
+    symbols_define("x = 1", 5);
+    symbols_define("w = 1", 5);
+    symbols_define("u = 1", 5);
+    for (int i = 0; i < 14; i++) {
+        snprintf(label, sizeof(label), "d%d = %s * %d + 1", i, i ? "d0" : "x", i + 1);
+        symbols_define(label, (int)strlen(label));
+        snprintf(label, sizeof(label), "e%d = w^2 + %d", i, i);
+        symbols_define(label, (int)strlen(label));
+    }
+    run_timed("symbols_define", "\"u = 2\" (no dependents)", bench_define, "u = 2");
+    run_timed("symbols_define", "\"x = 2\" (14 of 31 dependent)", bench_define, "x = 2");
+
+    static const solve_case solve_cases[] = {
+        { "solve(x^3 - 2x = 5, x, 2)", "x^3 - 2x - 5", 2, 2.0945514815423265 },
+        { "solve(cos(x) = x, x, 1)", "cos(x) - x", 1, 0.7390851332151607 },
+        { "solve(e^x = 10, x, 1)", "e^x - 10", 1, 2.302585092994046 },
+        { "solve(atan(x) = 1, x, 0)", "atan(x) - 1", 0, 1.5574077246549023 },
+    };
+    printf("\nsolve() (Newton on dual numbers) against Newton on central differences\n");
+    for (unsigned i = 0; i < sizeof(solve_cases) / sizeof(solve_cases[0]); i++) {
+        const solve_case* c = &solve_cases[i];
+        snprintf(label, sizeof(label), "\"%s\"", c->equation);
+        run_timed("evaluate", label, bench_evaluate, c->equation);
+        snprintf(label, sizeof(label), "\"%s\"", c->fn);
+        run_timed("fd newton", label, bench_fd_newton, c);
+        math_program prog;
+        math_compile_fn(c->fn, (int)strlen(c->fn), "x", &prog);
+        int evals = 0;
+        double fd = fd_newton(&prog, c->guess, &evals);
+        double ad = evaluate(c->equation, (int)strlen(c->equation));
+        printf("  %-14s solve() %g ulp, central differences %g ulp after %d evaluations\n", "error",
+               ulp_error(ad, c->root), ulp_error(fd, c->root), evals);
+    }
+
+    static const pair pow_args[] = {
+        { 2, 10 }, { 1.0001, 1000 }, { 2, 1000000 }, { 2, -1000000 }, { -3, 1e300 },
+        { 1e300, 1e300 }, { 0.5, 2000.5 }, { 7, 0.333 }, { 0.5, -3.75 },
+    };
+    static const pair sqrt_args[] = { { 2, 0 }, { 1e-6, 0 }, { 123456789, 0 }, { 1e300, 0 } };
+    static const pair mod_args[] = { { 10, 3 }, { 12345.678, 9.1 }, { -7.5, 2 } };
+
+    printf("\nPrimitives\n");
+    for (unsigned i = 0; i < sizeof(pow_args) / sizeof(pow_args[0]); i++) {
+        snprintf(label, sizeof(label), "(%g, %g)", pow_args[i].a, pow_args[i].b);
+        run_timed("math_pow", label, bench_pow, &pow_args[i]);
+    }
+    for (unsigned i = 0; i < sizeof(sqrt_args) / sizeof(sqrt_args[0]); i++) {
+        snprintf(label, sizeof(label), "(%g)", sqrt_args[i].a);
+        run_timed("math_sqrt", label, bench_sqrt, &sqrt_args[i]);
+    }
+    for (unsigned i = 0; i < sizeof(mod_args) / sizeof(mod_args[0]); i++) {
+        snprintf(label, sizeof(label), "(%g, %g)", mod_args[i].a, mod_args[i].b);
+        run_timed("math_mod", label, bench_mod, &mod_args[i]);
+    }
+
+    static const fmt_case fmt_cases[] = {
+        { 0.1 + 0.2, FMT_SHORTEST, 0 }, { 1.0 / 3, FMT_SHORTEST, 0 }, { 123456, FMT_SHORTEST, 0 },
+        { 6.02214076e23, FMT_SHORTEST, 0 }, { 1.0 / 3, FMT_GENERAL, 6 }, { 1.0 / 3, FMT_FIXED, 4 },
+    };
+    static const char* const mode_names[] = { "shortest", "general", "fixed", "scientific" };
+    printf("\nFormatting\n");
+    for (unsigned i = 0; i < sizeof(fmt_cases) / sizeof(fmt_cases[0]); i++) {
+        snprintf(label, sizeof(label), "(%g, %s)", fmt_cases[i].value, mode_names[fmt_cases[i].mode]);
+        run_timed("fmt_double", label, bench_fmt, &fmt_cases[i]);
+    }
+    snprintf(label, sizeof(label), "(%g, %%.17g)", fmt_cases[1].value);
+    run_timed("snprintf", label, bench_snprintf, &fmt_cases[1]);
+
+    static const char* const scan_cases[] = {
+        "42", "3.14159", "6.02214076e23", "0.000123456789012345", "0xDEADBEEF",
+        "3.14159265358979323846264338327950288",
+    };
+    printf("\nParsing\n");
+    for (unsigned i = 0; i < sizeof(scan_cases) / sizeof(scan_cases[0]); i++) {
+        snprintf(label, sizeof(label), "\"%s\"", scan_cases[i]);
+        run_timed("scan_number", label, bench_scan, scan_cases[i]);
+    }
+    for (unsigned i = 0; i < sizeof(scan_cases) / sizeof(scan_cases[0]); i++) {
+        snprintf(label, sizeof(label), "\"%s\"", scan_cases[i]);
+        run_timed("strtod", label, bench_strtod, scan_cases[i]);
+    }
+
+    static const unary_case sin_cases[] = { { sci_sin, 0.5 }, { sci_sin, 100 }, { sci_sin, 1e6 }, { sci_sin, 1e15 } };
+    printf("\nLevel 3 latency (sci_* against x87 and libm)\n");
+    for (unsigned i = 0; i < sizeof(sin_cases) / sizeof(sin_cases[0]); i++) {
+        unary_case c = sin_cases[i];
+        snprintf(label, sizeof(label), "(%g)", c.x);
+        run_timed("sci_sin", label, bench_unary, &c);
+        c.fn = x87_fsin;
+        run_timed("x87 fsin", label, bench_unary, &c);
+        c.fn = sin;
+        run_timed("libm sin", label, bench_unary, &c);
+    }
+    static const unary_case other_cases[] = {
+        { sci_cos, 0.5 }, { x87_fcos, 0.5 }, { sci_sin, 1e300 }, { sci_tan, 0.5 },
+        { sci_asin, 0.5 }, { sci_acos, 0.5 }, { sci_atan, 0.5 }, { sci_ln, 0.5 }, { sci_log10, 1e100 },
+    };
+    static const char* const other_names[] = {
+        "sci_cos", "x87 fcos", "sci_sin", "sci_tan", "sci_asin", "sci_acos", "sci_atan", "sci_ln", "sci_log10",
+    };
+    for (unsigned i = 0; i < sizeof(other_cases) / sizeof(other_cases[0]); i++) {
+        snprintf(label, sizeof(label), "(%g)", other_cases[i].x);
+        run_timed(other_names[i], label, bench_unary, &other_cases[i]);
+    }
+
+    bench_batch();
+
+    accuracy_suite();
+    sci_accuracy();
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Checks for the result cache (make check): keys must tell apart
+// expressions that evaluate differently, and refuse the ones whose value
+// can change.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "calc.h"
+#include "../cache.h"
+
+static int failed = 0;
+
+static void check(const char* name, int ok) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    if (!ok) failed = 1;
+}
+
+static int make_key(const char* expr, cache_key* key) {
+    return cache_make_key(expr, (int)strlen(expr), key);
+}
+
+static int same_key(const char* a, const char* b) {
+    cache_key ka, kb;
+    if (!make_key(a, &ka) || !make_key(b, &kb)) return 0;
+    return ka.len == kb.len && ka.hash == kb.hash && memcmp(ka.text, kb.text, ka.len) == 0;
+}
+
+static int cacheable(const char* expr) {
+    cache_key key;
+    return make_key(expr, &key);
+}
+
+int main(void) {
+    check("1 2 and 12 evaluate differently", calc_eval("1 2", 3) != calc_eval("12", 2));
+    check("1 2 and 12 get different keys", !same_key("1 2", "12"));
+    check("1 000 and 1000 get different keys", !same_key("1 000", "1000"));
+    check("sin 2 and sin2 get different keys", !same_key("sin 2", "sin2"));
+    check("spaces around operators do not matter", same_key(" 1 + 2 ", "1+2"));
+    check("runs of spaces count once", same_key("1   2", "1 2"));
+    check("tabs are kept, as the lexer does not skip them", !same_key("1+2", "1\t+2"));
+
+    cache_key first, second;
+    double value;
+    int exact;
+    make_key("1 2", &first);
+    make_key("12", &second);
+    cache_store(&first, 1, 0);
+    check("12 misses after 1 2 is stored", !cache_lookup(&second, &value, &exact));
+    cache_store(&second, 12, 1);
+    check("1 2 still finds its own entry", cache_lookup(&first, &value, &exact) && value == 1 && !exact);
+    check("entries remember exact digits", cache_lookup(&second, &value, &exact) && exact);
+
+    check("ans is not cached", !cacheable("ans + 1"));
+    check("2ans is not cached", !cacheable("2ans"));
+    check("$n is not cached", !cacheable("$3 * 2"));
+    check("names containing ans are cached", cacheable("answer + 1") && cacheable("tans(1)"));
+    return failed;
+}
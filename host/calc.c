@@ -0,0 +1,220 @@
+// libcalc: the Calculator OS math engine as a host library
+// Per-thread arenas and a pthread pool for batches of expressions
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calc.h"
+#include "../fmt.h"
+#include "../math.h"
+#include "../mem.h"
+
+// Scratch space for each thread's sums and integrals; the kernel gets by
+// with less, but the host can afford the deepest blocks
+#define CALC_ARENA_SIZE (1 << 20)
+
+// Expressions a thread claims at a time: enough to make the shared
+// counter cheap, few enough that threads finish together
+#define CALC_CHUNK 64
+
+struct calc_pool {
+    pthread_t* threads;    // workers; the caller is the last thread
+    int count;             // workers + 1
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long batch;   // bumped for each batch, which wakes the workers
+    int busy;              // workers still on the batch
+    int stopping;
+
+    const calc_batch* job;  // the batch being evaluated
+    int claimed;            // its next index not yet claimed
+};
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static __thread unsigned char* thread_arena;
+
+// The function name table is built on the first lookup; do it once
+// before any thread can race to build it
+static void init(void) {
+    math_find_function("sin", 3, 1);
+}
+
+static void thread_init(void) {
+    pthread_once(&init_once, init);
+    if (thread_arena) return;
+    thread_arena = malloc(CALC_ARENA_SIZE);
+    if (thread_arena) mem_init(thread_arena, CALC_ARENA_SIZE);
+}
+
+double calc_eval(const char* expr, int len) {
+    thread_init();
+    return evaluate(expr, len);
+}
+
+// Copy len characters, as many as fit with the terminator
+static int put_text(char* text, int size, const char* s, int len) {
+    if (size > 0) {
+        int n = len < size - 1 ? len : size - 1;
+        memcpy(text, s, n);
+        text[n] = '\0';
+    }
+    return len;
+}
+
+// What the kernel's calculate() shows, without the cache: the double,
+// then exact digits if it may have lost some. The value is 0 for an
+// expression that does not compile, as from evaluate().
+static int eval_text(const char* expr, int len, double* value, char* text, int size) {
+    math_program prog;
+    if (math_compile(expr, len, &prog) != 0) {
+        *value = 0;
+        return put_text(text, size, CALC_ERROR, sizeof(CALC_ERROR) - 1);
+    }
+    *value = math_run(&prog);
+    
+    void* mark = arena_mark();
+    const char* exact = math_exact(&prog, expr, *value);
+    int n;
+    if (exact) {
+        n = put_text(text, size, exact, strlen(exact));
+    } else {
+        char digits[FMT_MAX];
+        n = put_text(text, size, digits, fmt_double(digits, *value, FMT_SHORTEST, 0));
+    }
+    arena_release(mark);
+    return n;
+}
+
+int calc_text(const char* expr, int len, char* text, int size) {
+    double value;
+    thread_init();
+    return eval_text(expr, len, &value, text, size);
+}
+
+void calc_set_trace(void (*trace)(const char* fmt, ...)) {
+    math_trace = trace;
+}
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Claim and evaluate chunks until the batch runs out
+static void run_batch(calc_pool* pool) {
+    const calc_batch* job = pool->job;
+    for (;;) {
+        int i = __atomic_fetch_add(&pool->claimed, CALC_CHUNK, __ATOMIC_RELAXED);
+        if (i >= job->n) return;
+        int end = i + CALC_CHUNK < job->n ? i + CALC_CHUNK : job->n;
+        for (; i < end; i++) {
+            const char* expr = job->exprs[i];
+            int len = job->lens ? job->lens[i] : (int)strlen(expr);
+            double value;
+            unsigned long long start = job->ns ? now_ns() : 0;
+            if (job->text) {
+                job->text_len[i] = eval_text(expr, len, &value, job->text + (long)i * job->text_size, job->text_size);
+            } else {
+                value = evaluate(expr, len);
+            }
+            if (job->ns) job->ns[i] = (unsigned int)(now_ns() - start);
+            if (job->out) job->out[i] = value;
+            if (job->done) job->done(job->arg, i, value);
+        }
+    }
+}
+
+static void* worker(void* arg) {
+    calc_pool* pool = arg;
+    unsigned long seen = 0;
+    thread_init();
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->batch == seen && !pool->stopping) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stopping) break;
+        seen = pool->batch;
+        pthread_mutex_unlock(&pool->lock);
+        run_batch(pool);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    free(thread_arena);
+    return 0;
+}
+
+calc_pool* calc_pool_create(int threads) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    calc_pool* pool = calloc(1, sizeof(calc_pool));
+    if (!pool) return 0;
+    pool->threads = calloc(threads, sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        return 0;
+    }
+    pthread_mutex_init(&pool->lock, 0);
+    pthread_cond_init(&pool->start, 0);
+    pthread_cond_init(&pool->done, 0);
+    thread_init();
+
+    pool->count = 1;
+    while (pool->count < threads) {
+        if (pthread_create(&pool->threads[pool->count - 1], 0, worker, pool) != 0) break;
+        pool->count++;
+    }
+    return pool;
+}
+
+void calc_pool_destroy(calc_pool* pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count - 1; i++) pthread_join(pool->threads[i], 0);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+int calc_pool_threads(const calc_pool* pool) {
+    return pool->count;
+}
+
+void calc_eval_batch(calc_pool* pool, const char* const* exprs, const int* lens, double* out, int n) {
+    calc_batch batch = { exprs, lens, n, out, 0, 0, 0, 0, 0, 0 };
+    calc_run_batch(pool, &batch);
+}
+
+void calc_run_batch(calc_pool* pool, const calc_batch* batch) {
+    thread_init();
+    pool->job = batch;
+    pool->claimed = 0;
+
+    // A single chunk is not worth waking anyone for
+    if (pool->count == 1 || batch->n <= CALC_CHUNK) {
+        run_batch(pool);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busy = pool->count - 1;
+    pool->batch++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_batch(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,60 @@
+#ifndef CALC_H
+#define CALC_H
+
+// libcalc: the Calculator OS math engine built for the host, as a static
+// and a shared library (make libcalc). Any thread may evaluate; each gets
+// its own scratch arena on first use. A calc_pool spreads a batch of
+// expressions over worker threads. ans, $n and user symbols are not
+// available: every expression stands alone.
+
+// Value of an expression of len characters, as the calculator shows it;
+// 0 if it does not compile
+double calc_eval(const char* expr, int len);
+
+// The expression as the calculator shows it, the exact-then-double path
+// of the kernel: exact digits when the double has lost integer digits
+// (2^80), else the shortest digits that read back as the double, or
+// CALC_ERROR if it does not compile. Like snprintf(), writes at most
+// size bytes, terminator included, and returns the full length; exact
+// results can run to thousands of digits.
+#define CALC_ERROR "error: cannot compile"
+int calc_text(const char* expr, int len, char* text, int size);
+
+// Where the engine's trace goes, in log_printf() format; null (the
+// default) drops it. Set it before evaluating.
+void calc_set_trace(void (*trace)(const char* fmt, ...));
+
+typedef struct calc_pool calc_pool;
+
+// A pool of threads, one per online CPU if threads <= 0. The thread that
+// calls calc_eval_batch() counts as one of them. Returns 0 on failure.
+calc_pool* calc_pool_create(int threads);
+void calc_pool_destroy(calc_pool* pool);
+int calc_pool_threads(const calc_pool* pool);
+
+// out[i] = calc_eval(exprs[i], lens[i]) for i < n, spread over the pool;
+// lens may be null for NUL-terminated expressions. Returns when all are
+// done. One batch at a time per pool.
+void calc_eval_batch(calc_pool* pool, const char* const* exprs, const int* lens, double* out, int n);
+
+// The general form of a batch. Every output is optional.
+typedef struct {
+    const char* const* exprs;
+    const int* lens;
+    int n;
+    double* out;
+    unsigned int* ns;  // nanoseconds each expression took, clock reads included
+    void (*done)(void* arg, int i, double value);  // called on the thread that evaluated i
+    void* arg;
+
+    // calc_text() of each expression into text + i * text_size, and its
+    // full length, which may not have fit, in text_len[i]. Timings then
+    // include the formatting.
+    char* text;
+    int text_size;
+    int* text_len;
+} calc_batch;
+
+void calc_run_batch(calc_pool* pool, const calc_batch* batch);
+
+#endif
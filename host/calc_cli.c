@@ -0,0 +1,269 @@
+// Streaming command-line calculator on the Calculator OS math engine.
+// Reads newline-delimited expressions from a file or stdin and writes one
+// result per line, like `make batch`, at host speed (see `make calc`).
+// Results read as the calculator shows them, exact digits included; a
+// line that does not compile gets an error line (calc.h: CALC_ERROR).
+//
+//   out/host/calc [--stats] [-j threads] [file]
+//
+// Regular files (named, or redirected to stdin) are memory-mapped; pipes
+// are read in large blocks. Results are formatted into a large buffer and
+// leave in few write() calls. Lines are evaluated and formatted in
+// batches spread over a libcalc thread pool, one thread per CPU unless -j
+// says otherwise.
+// --stats reports throughput and per-expression latency percentiles on
+// stderr.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calc.h"
+#include "../fmt.h"
+
+#define READ_BUFFER (4 << 20)   // pipe input; also the longest line
+#define WRITE_BUFFER (1 << 20)
+#define BATCH_LINES 16384       // lines handed to the pool at once
+#define TEXT_MAX FMT_MAX        // result text per line; longer is redone
+
+// Latency histogram: 64 buckets per power of two, so a percentile is
+// within 1/64 of the true value however many expressions are timed
+#define SUB_BITS 6
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define BUCKETS ((32 - SUB_BITS + 1) * SUB_BUCKETS)
+
+typedef struct {
+    calc_pool* pool;
+    int stats;
+
+    // The batch being collected, and its results as text, formatted by
+    // the threads that compute them
+    const char* exprs[BATCH_LINES];
+    int lens[BATCH_LINES];
+    unsigned int ns[BATCH_LINES];
+    char text[BATCH_LINES][TEXT_MAX];
+    int text_len[BATCH_LINES];
+    int count;
+
+    char out[WRITE_BUFFER];
+    int out_len;
+
+    unsigned long long lines;
+    unsigned long long bytes;
+    unsigned long long histogram[BUCKETS];
+    unsigned int max_ns;
+} job;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void write_all(const char* buf, int len) {
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("calc: write");
+            exit(1);
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+static void flush(job* j) {
+    write_all(j->out, j->out_len);
+    j->out_len = 0;
+}
+
+static void append(job* j, const char* text, int len) {
+    if (j->out_len + len + 1 > WRITE_BUFFER) flush(j);
+    if (len + 1 > WRITE_BUFFER) {
+        write_all(text, len);
+        len = 0;
+    }
+    memcpy(j->out + j->out_len, text, len);
+    j->out_len += len;
+    j->out[j->out_len++] = '\n';
+}
+
+static int bucket(unsigned int ns) {
+    if (ns < SUB_BUCKETS) return ns;
+    int shift = 31 - __builtin_clz(ns) - SUB_BITS;
+    return shift * SUB_BUCKETS + (ns >> shift);
+}
+
+// Smallest value that falls in bucket b
+static unsigned long long bucket_floor(int b) {
+    if (b < SUB_BUCKETS) return b;
+    int shift = b / SUB_BUCKETS - 1;
+    return (unsigned long long)(b % SUB_BUCKETS + SUB_BUCKETS) << shift;
+}
+
+// Evaluate the collected lines and append their results
+static void run_batch(job* j) {
+    if (j->count == 0) return;
+    calc_batch batch = { j->exprs, j->lens, j->count, 0, j->stats ? j->ns : 0, 0, 0,
+                         j->text[0], TEXT_MAX, j->text_len };
+    calc_run_batch(j->pool, &batch);
+    for (int i = 0; i < j->count; i++) {
+        int len = j->text_len[i];
+        if (len < TEXT_MAX) {
+            append(j, j->text[i], len);
+        } else {
+            char* text = malloc(len + 1);
+            if (!text) {
+                perror("calc");
+                exit(1);
+            }
+            calc_text(j->exprs[i], j->lens[i], text, len + 1);
+            append(j, text, len);
+            free(text);
+        }
+        if (j->stats) {
+            j->histogram[bucket(j->ns[i])]++;
+            if (j->ns[i] > j->max_ns) j->max_ns = j->ns[i];
+        }
+    }
+    j->lines += j->count;
+    j->count = 0;
+}
+
+// Queue every complete line in [p, end); returns where the unfinished
+// last line starts (end if there is none). With last set, that line is
+// queued too. The text must stay put until the batch has run.
+static const char* take_lines(job* j, const char* p, const char* end, int last) {
+    while (p < end) {
+        const char* nl = memchr(p, '\n', end - p);
+        if (!nl && !last) break;
+        const char* line_end = nl ? nl : end;
+        int len = line_end - p;
+        if (len > 0 && p[len - 1] == '\r') len--;
+        if (len > 0) {
+            j->exprs[j->count] = p;
+            j->lens[j->count] = len;
+            if (++j->count == BATCH_LINES) run_batch(j);
+        }
+        p = nl ? nl + 1 : end;
+    }
+    return p;
+}
+
+static int run_mapped(job* j, int fd, size_t size) {
+    if (size == 0) return 0;
+    const char* text = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) return -1;
+    madvise((void*)text, size, MADV_SEQUENTIAL);
+    take_lines(j, text, text + size, 1);
+    run_batch(j);
+    munmap((void*)text, size);
+    j->bytes += size;
+    return 0;
+}
+
+static void run_stream(job* j, int fd) {
+    char* buf = malloc(READ_BUFFER);
+    if (!buf) {
+        perror("calc");
+        exit(1);
+    }
+    int kept = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf + kept, READ_BUFFER - kept);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("calc: read");
+            exit(1);
+        }
+        j->bytes += n;
+        int filled = kept + n;
+
+        // At the end of input the unfinished line counts as one; so does
+        // a line too long for the buffer
+        const char* rest = take_lines(j, buf, buf + filled, n == 0);
+        if (rest == buf && filled == READ_BUFFER) rest = take_lines(j, buf, buf + filled, 1);
+        run_batch(j);
+        kept = buf + filled - rest;
+        memmove(buf, rest, kept);
+        if (n == 0) break;
+    }
+    free(buf);
+}
+
+static void report(const job* j, double seconds) {
+    fprintf(stderr, "calc: %llu expressions in %.3f s on %d threads: %.2f M/s, %.1f MB/s in\n",
+            j->lines, seconds, calc_pool_threads(j->pool),
+            j->lines / seconds * 1e-6, j->bytes / seconds * 1e-6);
+    if (j->lines == 0) return;
+
+    static const double points[] = { 50, 90, 99, 99.9 };
+    fprintf(stderr, "calc: latency ns");
+    unsigned long long seen = 0;
+    int b = 0;
+    for (int i = 0; i < 4; i++) {
+        unsigned long long rank = (unsigned long long)(points[i] / 100 * (j->lines - 1)) + 1;
+        while (seen + j->histogram[b] < rank) seen += j->histogram[b++];
+        fprintf(stderr, "  p%g %llu", points[i], bucket_floor(b));
+    }
+    fprintf(stderr, "  max %u\n", j->max_ns);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: calc [--stats] [-j threads] [file]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    static job j;
+    const char* path = 0;
+    int threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            j.stats = 1;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads <= 0) usage();
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            usage();
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            usage();
+        }
+    }
+
+    int fd = STDIN_FILENO;
+    if (path && strcmp(path, "-") != 0) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            perror(path);
+            return 1;
+        }
+    }
+    j.pool = calc_pool_create(threads);
+    if (!j.pool) {
+        perror("calc");
+        return 1;
+    }
+
+    double start = now_s();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || run_mapped(&j, fd, st.st_size) != 0) {
+        run_stream(&j, fd);
+    }
+    flush(&j);
+    double seconds = now_s() - start;
+
+    if (j.stats) report(&j, seconds);
+    calc_pool_destroy(j.pool);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Checks for the command-line calculator (make check): expected output
+# for a few lines, and lines that must give an error instead of a crash.
+#   sh host/calc_test.sh out/host/calc
+
+CALC=${1:-out/host/calc}
+failed=0
+
+expect() {
+    name=$1
+    want=$2
+    got=$(cat | "$CALC")
+    status=$?
+    if [ $status -ne 0 ] || [ "$got" != "$want" ]; then
+        echo "FAIL $name (exit $status)"
+        printf '  want: %.200s\n  got:  %.200s\n' "$want" "$got"
+        failed=1
+    else
+        echo "ok   $name"
+    fi
+}
+
+printf '1+2\n10/4\n2^80\n' | expect "results as the calculator shows them" "3
+2.5
+1208925819614629174706176"
+
+printf '2 3\n2#3\n1+\n.\n2*3\n' | expect "stray or trailing tokens" "error: cannot compile
+error: cannot compile
+error: cannot compile
+error: cannot compile
+6"
+
+# A million signs nest a million levels deep
+awk 'BEGIN { s = "-"; while (length(s) < 1000000) s = s s; print substr(s, 1, 1000000) "1"; print "1+1" }' |
+    expect "deeply nested signs" "error: cannot compile
+2"
+
+awk 'BEGIN { for (i = 0; i < 100000; i++) { o = o "("; c = c ")" } print o "1" c; print "7" }' |
+    expect "deeply nested parentheses" "error: cannot compile
+7"
+
+exit $failed
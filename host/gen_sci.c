@@ -0,0 +1,406 @@
+// Table generator for sci.c, run by the Makefile at build time.
+// Computes pi, 2/pi, ln 2 and ln 10 in multiprecision fixed point, fits
+// minimax polynomials with the Remez exchange in long double, and prints
+// everything as a C header on stdout. Hex float literals keep every
+// value exact.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// ---- Fixed point: word 0 is the integer part, then WORDS - 1 fraction
+// words, most significant first ----
+
+#define WORDS 48
+
+typedef struct {
+    unsigned int w[WORDS];
+} fixed;
+
+static void fx_set(fixed* x, unsigned int whole) {
+    memset(x, 0, sizeof(*x));
+    x->w[0] = whole;
+}
+
+static int fx_zero(const fixed* x) {
+    for (int i = 0; i < WORDS; i++) {
+        if (x->w[i]) return 0;
+    }
+    return 1;
+}
+
+static void fx_div_small(fixed* x, unsigned int d) {
+    unsigned long long rem = 0;
+    for (int i = 0; i < WORDS; i++) {
+        unsigned long long cur = (rem << 32) | x->w[i];
+        x->w[i] = (unsigned int)(cur / d);
+        rem = cur % d;
+    }
+}
+
+static void fx_mul_small(fixed* x, unsigned int m) {
+    unsigned long long carry = 0;
+    for (int i = WORDS - 1; i >= 0; i--) {
+        unsigned long long cur = (unsigned long long)x->w[i] * m + carry;
+        x->w[i] = (unsigned int)cur;
+        carry = cur >> 32;
+    }
+}
+
+static void fx_add(fixed* x, const fixed* y) {
+    unsigned long long carry = 0;
+    for (int i = WORDS - 1; i >= 0; i--) {
+        unsigned long long cur = (unsigned long long)x->w[i] + y->w[i] + carry;
+        x->w[i] = (unsigned int)cur;
+        carry = cur >> 32;
+    }
+}
+
+static void fx_sub(fixed* x, const fixed* y) {
+    long long borrow = 0;
+    for (int i = WORDS - 1; i >= 0; i--) {
+        long long cur = (long long)x->w[i] - y->w[i] - borrow;
+        borrow = cur < 0;
+        x->w[i] = (unsigned int)(cur + (borrow ? 1LL << 32 : 0));
+    }
+}
+
+static int fx_cmp(const fixed* x, const fixed* y) {
+    for (int i = 0; i < WORDS; i++) {
+        if (x->w[i] != y->w[i]) return x->w[i] < y->w[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// Bit i of x counted from the binary point: 1 is the 1/2 place, 0 the
+// units place, negative ones further left
+static int fx_bit(const fixed* x, int i) {
+    int pos = 31 + i;  // from the top of word 0
+    if (pos < 0 || pos >= WORDS * 32) return 0;
+    return (x->w[pos / 32] >> (31 - pos % 32)) & 1;
+}
+
+// The count bits of x from bit first, as an integer
+static unsigned long long fx_bits(const fixed* x, int first, int count) {
+    unsigned long long v = 0;
+    for (int i = 0; i < count; i++) v = (v << 1) | fx_bit(x, first + i);
+    return v;
+}
+
+// Leading bit position of a nonzero x, in fx_bit() numbering
+static int fx_lead(const fixed* x) {
+    int i = -31;
+    while (!fx_bit(x, i)) i++;
+    return i;
+}
+
+// x rounded to 64 significant bits
+static long double fx_value(const fixed* x) {
+    int lead = fx_lead(x);
+    unsigned long long top = fx_bits(x, lead, 64);
+    long double v = ldexpl((long double)top, -(lead + 63));
+    if (fx_bit(x, lead + 64)) v += ldexpl(1.0L, -(lead + 63));
+    return v;
+}
+
+// x split into count parts, part p holding bits[p] significant bits; all
+// but the last are truncated, the last rounded
+static void fx_split(const fixed* x, const int* bits, long double* parts, int count) {
+    int pos = fx_lead(x);
+    for (int p = 0; p < count; p++) {
+        while (p > 0 && !fx_bit(x, pos)) pos++;
+        unsigned long long v = fx_bits(x, pos, bits[p]);
+        if (p == count - 1 && fx_bit(x, pos + bits[p])) v++;
+        parts[p] = ldexpl((long double)v, -(pos + bits[p] - 1));
+        pos += bits[p];
+    }
+}
+
+// atan(1/n) = sum of (-1)^k / ((2k + 1) n^(2k + 1))
+static void fx_atan_inv(fixed* r, unsigned int n) {
+    fixed power, term;
+    fx_set(r, 0);
+    fx_set(&power, 1);
+    fx_div_small(&power, n);
+    for (unsigned int k = 0; !fx_zero(&power); k++) {
+        term = power;
+        fx_div_small(&term, 2 * k + 1);
+        if (k & 1) fx_sub(r, &term);
+        else fx_add(r, &term);
+        fx_div_small(&power, n);
+        fx_div_small(&power, n);
+    }
+}
+
+// atanh(1/n) = sum of 1 / ((2k + 1) n^(2k + 1))
+static void fx_atanh_inv(fixed* r, unsigned int n) {
+    fixed power, term;
+    fx_set(r, 0);
+    fx_set(&power, 1);
+    fx_div_small(&power, n);
+    for (unsigned int k = 0; !fx_zero(&power); k++) {
+        term = power;
+        fx_div_small(&term, 2 * k + 1);
+        fx_add(r, &term);
+        fx_div_small(&power, n);
+        fx_div_small(&power, n);
+    }
+}
+
+// ---- Remez exchange ----
+
+#define MAX_TERMS 10
+#define GRID 4000
+
+typedef long double (*series_fn)(long double t);
+
+// Solve the n x n system a * x = b in place, partial pivoting
+static void solve(long double a[][MAX_TERMS + 1], long double* b, int n) {
+    for (int c = 0; c < n; c++) {
+        int pivot = c;
+        for (int r = c + 1; r < n; r++) {
+            if (fabsl(a[r][c]) > fabsl(a[pivot][c])) pivot = r;
+        }
+        for (int k = 0; k < n; k++) {
+            long double t = a[c][k];
+            a[c][k] = a[pivot][k];
+            a[pivot][k] = t;
+        }
+        long double t = b[c];
+        b[c] = b[pivot];
+        b[pivot] = t;
+        for (int r = c + 1; r < n; r++) {
+            long double f = a[r][c] / a[c][c];
+            for (int k = c; k < n; k++) a[r][k] -= f * a[c][k];
+            b[r] -= f * b[c];
+        }
+    }
+    for (int c = n - 1; c >= 0; c--) {
+        for (int k = c + 1; k < n; k++) b[c] -= a[c][k] * b[k];
+        b[c] /= a[c][c];
+    }
+}
+
+static long double poly(const long double* c, int terms, long double s) {
+    long double v = 0;
+    for (int j = terms - 1; j >= 0; j--) v = v * s + c[j];
+    return v;
+}
+
+// Minimax polynomial of degree terms - 1 for f(t) on [lo, hi], fitted in
+// s = t / scale and returned as coefficients of t. Returns the max error.
+static long double remez(series_fn f, long double lo, long double hi, long double scale,
+                         long double* coeff, int terms) {
+    int m = terms + 1;
+    long double x[MAX_TERMS + 1], d[MAX_TERMS + 1];
+    long double a[MAX_TERMS + 1][MAX_TERMS + 1];
+    long double s_lo = lo / scale, s_hi = hi / scale;
+    long double pi = 3.14159265358979323846264338327950288L;
+
+    for (int i = 0; i < m; i++) {
+        x[i] = s_lo + (s_hi - s_lo) * (1 - cosl(i * pi / (m - 1))) / 2;
+    }
+
+    long double error = 0;
+    for (int iter = 0; iter < 30; iter++) {
+        for (int i = 0; i < m; i++) {
+            long double p = 1;
+            for (int j = 0; j < terms; j++) {
+                a[i][j] = p;
+                p *= x[i];
+            }
+            a[i][terms] = (i & 1) ? -1 : 1;
+            d[i] = f(x[i] * scale);
+        }
+        solve(a, d, m);
+
+        // New reference: the extreme error between neighbours' midpoints
+        long double next[MAX_TERMS + 1];
+        error = 0;
+        for (int i = 0; i < m; i++) {
+            long double from = i == 0 ? s_lo : (x[i - 1] + x[i]) / 2;
+            long double to = i == m - 1 ? s_hi : (x[i] + x[i + 1]) / 2;
+            long double sign = ((i & 1) ? -1 : 1) * (d[terms] < 0 ? -1 : 1);
+            long double best = -1, best_x = x[i];
+            for (int g = 0; g <= GRID; g++) {
+                long double s = from + (to - from) * g / GRID;
+                long double e = sign * (f(s * scale) - poly(d, terms, s));
+                if (e > best) {
+                    best = e;
+                    best_x = s;
+                }
+            }
+            next[i] = best_x;
+            if (best > error) error = best;
+        }
+        memcpy(x, next, sizeof(next));
+    }
+
+    long double p = 1;
+    for (int j = 0; j < terms; j++) {
+        coeff[j] = d[j] / p;
+        p *= scale;
+    }
+    return error;
+}
+
+// Correction terms the polynomials approximate, summed as series so they
+// stay exact where the closed forms would cancel:
+//   sin r = r + r^3 P(r^2)           cos r = 1 - r^2/2 + r^4 Q(r^2)
+//   atan u = u + u^3 A(u^2)          ln(1 + r) = r - r^2/2 + r^3 L(r)
+static long double sin_series(long double t) {
+    long double term = -1.0L / 6, sum = 0;
+    for (int n = 1; n < 20; n++) {
+        sum += term;
+        term *= -t / ((2 * n + 2) * (2 * n + 3));
+    }
+    return sum;
+}
+
+static long double cos_series(long double t) {
+    long double term = 1.0L / 24, sum = 0;
+    for (int n = 2; n < 20; n++) {
+        sum += term;
+        term *= -t / ((2 * n + 1) * (2 * n + 2));
+    }
+    return sum;
+}
+
+static long double atan_series(long double t) {
+    long double power = -1, sum = 0;
+    for (int n = 1; n < 30; n++) {
+        sum += power / (2 * n + 1);
+        power *= -t;
+    }
+    return sum;
+}
+
+static long double log_series(long double r) {
+    long double power = 1, sum = 0;
+    for (int n = 3; n < 40; n++) {
+        sum += ((n & 1) ? 1 : -1) * power / n;
+        power *= r;
+    }
+    return sum;
+}
+
+// ---- Output ----
+
+static void print_array(const char* name, const long double* v, int n) {
+    printf("static const long double %s[%d] = {\n", name, n);
+    for (int i = 0; i < n; i++) printf("    %LaL,\n", v[i]);
+    printf("};\n\n");
+}
+
+static void print_poly(const char* name, const char* what, series_fn f,
+                       long double lo, long double hi, long double scale, int terms) {
+    long double c[MAX_TERMS];
+    long double error = remez(f, lo, hi, scale, c, terms);
+    printf("// %s, max error %.3Le\n", what, error);
+    print_array(name, c, terms);
+}
+
+// Table sizes; sci.c relies on these exact values
+#define SIN_STEPS 64     // sin(j pi / 32)
+#define ATAN_STEPS 64    // atan(j / 64)
+#define LOG_STEPS 128    // ln(1 + j / 128)
+#define TWO_OVER_PI_WORDS 40
+
+int main(void) {
+    // pi = 16 atan(1/5) - 4 atan(1/239)
+    fixed pi, t;
+    fx_atan_inv(&pi, 5);
+    fx_mul_small(&pi, 16);
+    fx_atan_inv(&t, 239);
+    fx_mul_small(&t, 4);
+    fx_sub(&pi, &t);
+
+    // 2/pi by long division, one bit at a time
+    unsigned int two_over_pi[TWO_OVER_PI_WORDS] = {0};
+    fixed rem;
+    fx_set(&rem, 2);
+    for (int i = 0; i < TWO_OVER_PI_WORDS * 32; i++) {
+        fx_add(&rem, &rem);
+        if (fx_cmp(&rem, &pi) >= 0) {
+            fx_sub(&rem, &pi);
+            two_over_pi[i / 32] |= 1u << (31 - i % 32);
+        }
+    }
+
+    // ln 2 = 2 atanh(1/3), ln 10 = 3 ln 2 + 2 atanh(1/9)
+    fixed ln2, ln10;
+    fx_atanh_inv(&ln2, 3);
+    fx_mul_small(&ln2, 2);
+    fx_atanh_inv(&ln10, 9);
+    fx_mul_small(&ln10, 2);
+    t = ln2;
+    fx_mul_small(&t, 3);
+    fx_add(&ln10, &t);
+
+    fixed pio32 = pi;
+    for (int i = 0; i < 5; i++) fx_div_small(&pio32, 2);
+    static const int split_bits[3] = { 40, 40, 64 };
+    long double cody_waite[3];
+    fx_split(&pio32, split_bits, cody_waite, 3);
+
+    long double pi_l = fx_value(&pi);
+    long double ln2_l = fx_value(&ln2);
+    long double ln10_l = fx_value(&ln10);
+
+    printf("// Generated by host/gen_sci.c at build time; do not edit.\n\n");
+    printf("#ifndef SCI_TABLE_H\n#define SCI_TABLE_H\n\n");
+
+    printf("#define SCI_SIN_STEPS %d\n#define SCI_ATAN_STEPS %d\n#define SCI_LOG_STEPS %d\n\n",
+           SIN_STEPS, ATAN_STEPS, LOG_STEPS);
+    printf("static const long double sci_pio2 = %LaL;\n", pi_l / 2);
+    printf("static const long double sci_pio32 = %LaL;\n", fx_value(&pio32));
+    printf("static const long double sci_ln2 = %LaL;\n", ln2_l);
+    printf("static const long double sci_inv_ln10 = %LaL;\n\n", 1 / ln10_l);
+
+    printf("// pi/32 as two parts of 40 bits, so k * part is exact for k < 2^24,\n");
+    printf("// and the rest to 64 bits\n");
+    printf("static const long double sci_pio32_parts[3] = { %LaL, %LaL, %LaL };\n\n",
+           cody_waite[0], cody_waite[1], cody_waite[2]);
+
+    printf("// Bits of 2/pi from the 1/2 place on, most significant first\n");
+    printf("#define SCI_TWO_OVER_PI_WORDS %d\n", TWO_OVER_PI_WORDS);
+    printf("static const unsigned int sci_two_over_pi[%d] = {\n", TWO_OVER_PI_WORDS);
+    for (int i = 0; i < TWO_OVER_PI_WORDS; i++) {
+        printf("%s0x%08X,%s", i % 6 == 0 ? "    " : " ", two_over_pi[i], i % 6 == 5 ? "\n" : "");
+    }
+    printf("\n};\n\n");
+
+    // sin(j pi / 32) from the first quadrant, so the axes come out exact
+    long double sines[SIN_STEPS];
+    for (int j = 0; j <= SIN_STEPS / 4; j++) {
+        long double v = j == SIN_STEPS / 4 ? 1 : sinl(j * (pi_l / (SIN_STEPS / 2)));
+        sines[j] = v;
+        sines[SIN_STEPS / 2 - j] = v;
+        sines[(SIN_STEPS / 2 + j) % SIN_STEPS] = -v;
+        sines[(SIN_STEPS - j) % SIN_STEPS] = -v;
+    }
+    sines[0] = sines[SIN_STEPS / 2] = 0;
+    print_array("sci_sin_table", sines, SIN_STEPS);
+
+    long double atans[ATAN_STEPS + 1];
+    for (int j = 0; j <= ATAN_STEPS; j++) atans[j] = atanl((long double)j / ATAN_STEPS);
+    atans[ATAN_STEPS] = pi_l / 4;
+    print_array("sci_atan_table", atans, ATAN_STEPS + 1);
+
+    long double logs[LOG_STEPS + 1];
+    for (int j = 0; j <= LOG_STEPS; j++) logs[j] = log1pl((long double)j / LOG_STEPS);
+    logs[LOG_STEPS] = ln2_l;
+    print_array("sci_log_table", logs, LOG_STEPS + 1);
+
+    // Reduced ranges, with a little slack for rounding in the reductions
+    long double r_sin = pi_l / 64 * 1.01L;
+    long double u_atan = 1.0L / (2 * ATAN_STEPS) * 1.01L;
+    long double r_log = 1.0L / (2 * LOG_STEPS) * 1.01L;
+    print_poly("sci_sin_poly", "P(t), t = r^2 <= (pi/64)^2", sin_series, 0, r_sin * r_sin, r_sin * r_sin, 4);
+    print_poly("sci_cos_poly", "Q(t), t = r^2 <= (pi/64)^2", cos_series, 0, r_sin * r_sin, r_sin * r_sin, 4);
+    print_poly("sci_atan_poly", "A(t), t = u^2 <= (1/128)^2", atan_series, 0, u_atan * u_atan, u_atan * u_atan, 4);
+    print_poly("sci_log_poly", "L(r), |r| <= 1/256", log_series, -r_log, r_log, r_log, 6);
+
+    printf("#endif\n");
+    return 0;
+}
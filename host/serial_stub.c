@@ -0,0 +1,18 @@
+// Serial stubs for host builds of the math engine.
+// The kernel versions live in serial.c; on the host the trace is dropped.
+
+void serial_putc(char c) {
+    (void)c;
+}
+
+void serial_puts(const char* s) {
+    (void)s;
+}
+
+void serial_putdouble(double num) {
+    (void)num;
+}
+
+void log_printf(const char* fmt, ...) {
+    (void)fmt;
+}
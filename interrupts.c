@@ -0,0 +1,159 @@
+// Interrupt handling for Calculator OS
+// IDT setup, 8259 PIC remap and IRQ dispatch
+
+#include "interrupts.h"
+#include "io.h"
+#include "log.h"
+#include "serial.h"
+
+#define PIC1_CMD  0x20
+#define PIC1_DATA 0x21
+#define PIC2_CMD  0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI   0x20
+
+#define IRQ_BASE 0x20
+#define IDT_ENTRIES 256
+#define KERNEL_CS 0x08
+#define INTERRUPT_GATE 0x8E  // present, ring 0, 32-bit interrupt gate
+
+struct idt_entry {
+    unsigned short offset_low;
+    unsigned short selector;
+    unsigned char zero;
+    unsigned char type_attr;
+    unsigned short offset_high;
+} __attribute__((packed));
+
+struct idt_pointer {
+    unsigned short limit;
+    unsigned int base;
+} __attribute__((packed));
+
+static struct idt_entry idt[IDT_ENTRIES];
+static irq_handler irq_handlers[16];
+
+// Entry stubs: push the vector number and jump to a common path that saves
+// registers and calls into C. Handlers must not use the FPU, whose state
+// is not saved here.
+extern void (*const isr_stub_table[48])(void);
+
+__asm__(
+    ".text\n"
+    ".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31\n"
+    "exception_stub_\\n:\n"
+    "    pushl $\\n\n"
+    "    jmp exception_common\n"
+    ".endr\n"
+    ".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15\n"
+    "irq_stub_\\n:\n"
+    "    pushl $\\n\n"
+    "    jmp irq_common\n"
+    ".endr\n"
+    "exception_common:\n"
+    "    pushal\n"
+    "    cld\n"
+    "    pushl 32(%esp)\n"
+    "    call exception_dispatch\n"
+    "1:  cli\n"
+    "    hlt\n"
+    "    jmp 1b\n"
+    "irq_common:\n"
+    "    pushal\n"
+    "    cld\n"
+    "    pushl 32(%esp)\n"
+    "    call irq_dispatch\n"
+    "    addl $4, %esp\n"
+    "    popal\n"
+    "    addl $4, %esp\n"
+    "    iret\n"
+    ".section .rodata\n"
+    ".align 4\n"
+    "isr_stub_table:\n"
+    ".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31\n"
+    "    .long exception_stub_\\n\n"
+    ".endr\n"
+    ".irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15\n"
+    "    .long irq_stub_\\n\n"
+    ".endr\n"
+    ".text\n"
+);
+
+void exception_dispatch(int vector) __attribute__((used));
+void irq_dispatch(int irq) __attribute__((used));
+
+// CPU exceptions are fatal: report and halt (the stub never returns)
+void exception_dispatch(int vector) {
+    serial_sync();
+    LOG(LOG_ERROR, "\n[PANIC] CPU exception %d, system halted\n", vector);
+}
+
+void irq_dispatch(int irq) {
+    // Spurious IRQ7/IRQ15: the PIC has nothing in service, so no EOI
+    if (irq == 7 || irq == 15) {
+        unsigned short cmd = irq == 7 ? PIC1_CMD : PIC2_CMD;
+        outb(cmd, 0x0B);  // read in-service register
+        if ((inb(cmd) & 0x80) == 0) {
+            if (irq == 15) outb(PIC1_CMD, PIC_EOI);
+            return;
+        }
+    }
+    
+    if (irq_handlers[irq]) irq_handlers[irq]();
+    
+    if (irq >= 8) outb(PIC2_CMD, PIC_EOI);
+    outb(PIC1_CMD, PIC_EOI);
+}
+
+static void idt_set_gate(int vector, void (*handler)(void)) {
+    unsigned int addr = (unsigned int)handler;
+    idt[vector].offset_low = addr & 0xFFFF;
+    idt[vector].selector = KERNEL_CS;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = INTERRUPT_GATE;
+    idt[vector].offset_high = (addr >> 16) & 0xFFFF;
+}
+
+// Remap the PICs so IRQs do not collide with CPU exception vectors,
+// leaving every line masked until a handler is installed
+static void pic_remap(void) {
+    outb(PIC1_CMD, 0x11);        // ICW1: init, expect ICW4
+    outb(PIC2_CMD, 0x11);
+    outb(PIC1_DATA, IRQ_BASE);   // ICW2: vector offsets
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    outb(PIC1_DATA, 0x04);       // ICW3: slave on IRQ2
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);       // ICW4: 8086 mode
+    outb(PIC2_DATA, 0x01);
+    outb(PIC1_DATA, 0xFB);       // mask all but the cascade line
+    outb(PIC2_DATA, 0xFF);
+}
+
+void interrupts_init(void) {
+    for (int i = 0; i < 32; i++) {
+        idt_set_gate(i, isr_stub_table[i]);
+    }
+    for (int i = 0; i < 16; i++) {
+        idt_set_gate(IRQ_BASE + i, isr_stub_table[32 + i]);
+    }
+    
+    struct idt_pointer ptr;
+    ptr.limit = sizeof(idt) - 1;
+    ptr.base = (unsigned int)idt;
+    __asm__ volatile("lidt %0" : : "m" (ptr));
+    
+    pic_remap();
+    LOG(LOG_DEBUG, "[DEBUG] IDT loaded, PIC remapped to 0x%x\n", IRQ_BASE);
+}
+
+// Register a handler for a hardware IRQ and unmask its PIC line
+void irq_install(int irq, irq_handler handler) {
+    unsigned int flags = irq_save();
+    irq_handlers[irq] = handler;
+    if (irq < 8) {
+        outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << irq));
+    } else {
+        outb(PIC2_DATA, inb(PIC2_DATA) & ~(1 << (irq - 8)));
+    }
+    irq_restore(flags);
+}
@@ -0,0 +1,24 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+// IDT and 8259 PIC setup. Hardware IRQs 0-15 are remapped to vectors
+// 0x20-0x2F and dispatched to C handlers registered with irq_install().
+
+#define IRQ_TIMER    0
+#define IRQ_KEYBOARD 1
+#define IRQ_COM1     4
+
+typedef void (*irq_handler)(void);
+
+void interrupts_init(void);
+void irq_install(int irq, irq_handler handler);
+
+static inline void interrupts_enable(void) {
+    __asm__ volatile("sti");
+}
+
+static inline void interrupts_disable(void) {
+    __asm__ volatile("cli");
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef IO_H
+#define IO_H
+
+// Port I/O and CPU helpers shared by the kernel modules
+
+static inline unsigned char inb(unsigned short port) {
+    unsigned char result;
+    __asm__ volatile("inb %1, %0" : "=a" (result) : "dN" (port));
+    return result;
+}
+
+static inline void outb(unsigned short port, unsigned char value) {
+    __asm__ volatile("outb %0, %1" : : "a" (value), "dN" (port));
+}
+
+static inline void outw(unsigned short port, unsigned short value) {
+    __asm__ volatile("outw %0, %1" : : "a" (value), "dN" (port));
+}
+
+// Save EFLAGS and disable interrupts; pair with irq_restore()
+static inline unsigned int irq_save(void) {
+    unsigned int flags;
+    __asm__ volatile("pushfl\n popl %0\n cli" : "=r" (flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned int flags) {
+    __asm__ volatile("pushl %0\n popfl" : : "r" (flags) : "memory", "cc");
+}
+
+// 64/32 division without libgcc: two divl steps, high word first
+static inline unsigned long long div_u64(unsigned long long n, unsigned int d, unsigned int* rem) {
+    unsigned int hi = n >> 32, lo = (unsigned int)n;
+    unsigned int qhi = hi / d, r = hi % d, qlo;
+    __asm__("divl %4" : "=a"(qlo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+    if (rem) *rem = r;
+    return ((unsigned long long)qhi << 32) | qlo;
+}
+
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" : : : "memory");
+}
+
+#endif
@@ -1,99 +1,83 @@
 // Calculator OS v0.2
-// Supports Level 1 & 2 math operations
+// Supports Level 1-3 math operations
 
 #include "math.h"
+#include "cache.h"
 #include "extras.h"
+#include "fmt.h"
+#include "history.h"
+#include "interrupts.h"
+#include "io.h"
+#include "keyboard.h"
+#include "log.h"
+#include "matrix.h"
+#include "mem.h"
+#include "perf.h"
+#include "plot.h"
+#include "serial.h"
+#include "symbols.h"
+#include "task.h"
+#include "timer.h"
+#include "vga.h"
 
-#define VGA_MEMORY 0xB8000
-#define SERIAL_PORT 0x3F8
-#define VGA_WIDTH 80
-#define VGA_HEIGHT 25
 #define VGA_COLOR(fg, bg) ((bg << 4) | fg)
 #define WHITE_ON_BLACK VGA_COLOR(15, 0)
 #define GREEN_ON_BLACK VGA_COLOR(2, 0)
 #define YELLOW_ON_BLACK VGA_COLOR(14, 0)
+#define GRAY_ON_BLACK VGA_COLOR(8, 0)
+#define BLANK_CELL VGA_CELL(' ', WHITE_ON_BLACK)
+
+// Free memory runs from the end of the image to 64 KB below the stack,
+// unless extended memory above 1 MB can be used instead
+#define HEAP_END 0x80000
+#define EXTENDED_BASE 0x100000
+extern char __bss_end[];
 
 // Scroll buffer configuration
 #define HEADER_LINES 4
 #define CONTENT_LINES (VGA_HEIGHT - HEADER_LINES)
-#define SCROLL_BUFFER_LINES 200
+#define ALL_ROWS_DIRTY ((1u << CONTENT_LINES) - 1)
 
-// Scroll buffer: stores lines of text with colors
-char scroll_buffer[SCROLL_BUFFER_LINES][VGA_WIDTH];
-unsigned char scroll_colors[SCROLL_BUFFER_LINES][VGA_WIDTH];
-int buffer_write_line = 0;   // Next line to write in buffer
-int buffer_total_lines = 0;  // Total lines written
+// Scroll buffer lines live in history.c, numbered from 0 since boot
 int scroll_offset = 0;       // How many lines scrolled back (0 = latest)
 
+// What the content rows currently show: the line on the first content row,
+// and a bitmask of rows that must be recopied from the scroll buffer
+int displayed_top = 0;
+unsigned int dirty_rows = ALL_ROWS_DIRTY;
+
 unsigned short cursor_pos = 0;
 char input_buffer[256];
 unsigned char input_length = 0;
 int shift_pressed = 0;
 unsigned int rand_seed = 12345;
+int plotting = 0;             // a plot owns the screen and the keys
+int cancel_requested = 0;     // Esc during a computation; see run_task()
 
-// I/O functions
-unsigned char inb(unsigned short port) {
-    unsigned char result;
-    __asm__ volatile("inb %1, %0" : "=a" (result) : "dN" (port));
-    return result;
-}
-
-void outb(unsigned short port, unsigned char value) {
-    __asm__ volatile("outb %0, %1" : : "a" (value), "dN" (port));
-}
-
-// Serial port functions for debugging
-void serial_init(void) {
-    outb(SERIAL_PORT + 1, 0x00);  // Disable interrupts
-    outb(SERIAL_PORT + 3, 0x80);  // Enable DLAB
-    outb(SERIAL_PORT + 0, 0x03);  // Divisor low byte (38400 baud)
-    outb(SERIAL_PORT + 1, 0x00);  // Divisor high byte
-    outb(SERIAL_PORT + 3, 0x03);  // 8 bits, no parity, 1 stop
-    outb(SERIAL_PORT + 2, 0xC7);  // Enable FIFO
-    outb(SERIAL_PORT + 4, 0x0B);  // IRQs enabled, RTS/DSR set
-}
-
-void serial_putc(char c) {
-    while ((inb(SERIAL_PORT + 5) & 0x20) == 0);  // Wait for empty transmit
-    outb(SERIAL_PORT, c);
-}
-
-void serial_puts(const char* s) {
-    while (*s) {
-        if (*s == '\n') serial_putc('\r');
-        serial_putc(*s++);
-    }
-}
-
-void serial_putint(int num) {
-    if (num < 0) { serial_putc('-'); num = -num; }
-    if (num == 0) { serial_putc('0'); return; }
-    char buf[12];
-    int i = 0;
-    while (num > 0) { buf[i++] = '0' + (num % 10); num /= 10; }
-    while (i > 0) serial_putc(buf[--i]);
-}
-
-void serial_putdouble(double num) {
-    if (num < 0) { serial_putc('-'); num = -num; }
-    // Scale to integer to avoid float-to-int conversion issues
-    // Multiply by 10000 for 4 decimal places
-    int scaled = (int)(num * 10000.0 + 0.5);  // with rounding
-    int int_part = scaled / 10000;
-    int frac_part = scaled % 10000;
-    
-    serial_putint(int_part);
-    serial_putc('.');
+// CPUID exists when EFLAGS.ID can be toggled; SSE and SSE2 are EDX bits 25, 26
+int cpu_has_sse2(void) {
+    unsigned int before, after;
+    __asm__ volatile(
+        "pushfl\n"
+        "pop %0\n"
+        "mov %0, %1\n"
+        "xor $0x200000, %1\n"
+        "push %1\n"
+        "popfl\n"
+        "pushfl\n"
+        "pop %1\n"
+        "push %0\n"
+        "popfl\n"
+        : "=&r" (before), "=&r" (after)
+    );
+    if (((before ^ after) & 0x200000) == 0) return 0;
     
-    // Print fractional part with leading zeros
-    if (frac_part < 1000) serial_putc('0');
-    if (frac_part < 100) serial_putc('0');
-    if (frac_part < 10) serial_putc('0');
-    if (frac_part > 0) serial_putint(frac_part);
-    else serial_putc('0');
+    unsigned int eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    return (edx & (1 << 25)) && (edx & (1 << 26));
 }
 
-// Initialize FPU with proper control word
+// Initialize FPU with proper control word, then SSE when the CPU has it
 void init_fpu(void) {
     unsigned short cw = 0x037F;  // Default FPU control word: all exceptions masked
     __asm__ volatile(
@@ -101,107 +85,150 @@ void init_fpu(void) {
         "fldcw %0\n"
         : : "m" (cw)
     );
+    if (!cpu_has_sse2()) return;
+    
+    unsigned int cr0, cr4;
+    __asm__ volatile("mov %%cr0, %0" : "=r" (cr0));
+    cr0 = (cr0 & ~(1u << 2)) | (1u << 1);     // no EM, MP set
+    __asm__ volatile("mov %0, %%cr0" : : "r" (cr0));
+    __asm__ volatile("mov %%cr4, %0" : "=r" (cr4));
+    cr4 |= (1u << 9) | (1u << 10);            // OSFXSR, OSXMMEXCPT
+    __asm__ volatile("mov %0, %%cr4" : : "r" (cr4));
+    unsigned int mxcsr = 0x1F80;              // all SSE exceptions masked
+    __asm__ volatile("ldmxcsr %0" : : "m" (mxcsr));
+    matrix_sse_ready = 1;
 }
 
-void update_cursor(void) {
-    // Only show cursor if not scrolled back
-    if (scroll_offset == 0) {
-        outb(0x3D4, 14);
-        outb(0x3D5, (cursor_pos >> 8) & 0xFF);
-        outb(0x3D4, 15);
-        outb(0x3D5, cursor_pos & 0xFF);
+// Put the arena above 1 MB: enable A20 through port 0x92, check that
+// 1 MB no longer wraps to 0, and take the size CMOS reports (in KB).
+// Falls back to conventional memory below HEAP_END.
+void init_memory(void) {
+    outb(0x92, (inb(0x92) | 0x02) & ~0x01);   // bit 0 would reset the CPU
+    
+    volatile unsigned int* low = (volatile unsigned int*)0x7DF0;   // old boot sector
+    volatile unsigned int* high = (volatile unsigned int*)(EXTENDED_BASE + 0x7DF0);
+    unsigned int saved = *low;
+    *high = ~saved;
+    int a20 = *low == saved;
+    *low = saved;
+    
+    outb(0x70, 0x30);
+    unsigned int kb = inb(0x71);
+    outb(0x70, 0x31);
+    kb |= inb(0x71) << 8;
+    
+    if (a20 && kb >= 1024) {
+        mem_init((void*)EXTENDED_BASE, kb * 1024);
     } else {
-        // Hide cursor when scrolled back
-        outb(0x3D4, 14);
-        outb(0x3D5, 0xFF);
-        outb(0x3D4, 15);
-        outb(0x3D5, 0xFF);
+        mem_init(__bss_end, HEAP_END - (unsigned int)__bss_end);
     }
+    LOG(LOG_DEBUG, "[DEBUG] A20 %s, %u KB extended\n", a20 ? "on" : "off", kb);
+}
+
+// Cursor changes are only recorded here; vga_present() writes the CRTC
+// once per input event
+void update_cursor(void) {
+    // Only show cursor if not scrolled back
+    vga_set_cursor(scroll_offset == 0 ? cursor_pos : -1);
 }
 
 // Initialize scroll buffer
 void init_scroll_buffer(void) {
-    for (int i = 0; i < SCROLL_BUFFER_LINES; i++) {
-        for (int j = 0; j < VGA_WIDTH; j++) {
-            scroll_buffer[i][j] = ' ';
-            scroll_colors[i][j] = WHITE_ON_BLACK;
-        }
-    }
-    buffer_write_line = 0;
-    buffer_total_lines = 0;
+    history_init();
     scroll_offset = 0;
+    displayed_top = 0;
+    dirty_rows = ALL_ROWS_DIRTY;
+}
+
+// Line shown on the first content row when not scrolled back
+int live_top(void) {
+    return history_total > CONTENT_LINES ? history_total - CONTENT_LINES : 0;
 }
 
-// Get buffer line index (handles circular buffer)
-int get_buffer_line(int offset_from_latest) {
-    if (buffer_total_lines <= SCROLL_BUFFER_LINES) {
-        return buffer_total_lines - 1 - offset_from_latest;
+// Copy one scroll buffer line (or blanks) to a content row
+void draw_row(int y, int line) {
+    unsigned short* row = vga_row(HEADER_LINES + y);
+    const unsigned short* cells = history_line(line);
+    if (cells) {
+        vga_copy_cells(row, cells, VGA_WIDTH);
+    } else {
+        vga_fill_cells(row, BLANK_CELL, VGA_WIDTH);
     }
-    int idx = buffer_write_line - 1 - offset_from_latest;
-    if (idx < 0) idx += SCROLL_BUFFER_LINES;
-    return idx;
 }
 
-// Redraw the content area from scroll buffer
+// Bring the content area up to date. When the view moved by less than a
+// screen, the CRTC start address scrolls it and only the exposed rows are
+// copied; otherwise only rows marked dirty are redrawn.
 void redraw_content(void) {
-    unsigned char* vm = (unsigned char*)VGA_MEMORY;
+    perf_t start = perf_now();
+    int top = live_top() - scroll_offset;
+    int shift = top - displayed_top;
     
-    for (int y = 0; y < CONTENT_LINES; y++) {
-        int screen_y = HEADER_LINES + y;
-        int line_offset = scroll_offset + (CONTENT_LINES - 1 - y);
-        
-        if (line_offset < buffer_total_lines) {
-            int buf_idx = get_buffer_line(line_offset);
-            for (int x = 0; x < VGA_WIDTH; x++) {
-                int offset = (screen_y * VGA_WIDTH + x) * 2;
-                vm[offset] = scroll_buffer[buf_idx][x];
-                vm[offset + 1] = scroll_colors[buf_idx][x];
-            }
-        } else {
-            // Clear line if no content
-            for (int x = 0; x < VGA_WIDTH; x++) {
-                int offset = (screen_y * VGA_WIDTH + x) * 2;
-                vm[offset] = ' ';
-                vm[offset + 1] = WHITE_ON_BLACK;
-            }
-        }
+    if (shift > 0 && shift < CONTENT_LINES) {
+        vga_scroll(shift, HEADER_LINES);
+        dirty_rows = (dirty_rows >> shift) | (ALL_ROWS_DIRTY & ~(ALL_ROWS_DIRTY >> shift));
+    } else if (shift < 0 && shift > -CONTENT_LINES) {
+        vga_scroll(shift, HEADER_LINES);
+        dirty_rows = ((dirty_rows << -shift) | ((1u << -shift) - 1)) & ALL_ROWS_DIRTY;
+    } else if (shift != 0) {
+        dirty_rows = ALL_ROWS_DIRTY;
     }
+    displayed_top = top;
+    
+    for (int y = 0; dirty_rows != 0; y++, dirty_rows >>= 1) {
+        if (dirty_rows & 1) draw_row(y, top + y);
+    }
+    perf_add(PERF_SCROLL, perf_now() - start);
 }
 
 // Add a new line to the scroll buffer
 void buffer_newline(void) {
-    buffer_write_line = (buffer_write_line + 1) % SCROLL_BUFFER_LINES;
-    buffer_total_lines++;
+    int line = history_total;
+    history_newline();
     
-    // Clear the new line
-    for (int x = 0; x < VGA_WIDTH; x++) {
-        scroll_buffer[buffer_write_line][x] = ' ';
-        scroll_colors[buffer_write_line][x] = WHITE_ON_BLACK;
-    }
+    // If it is already on screen, its row needs a redraw
+    int y = line - displayed_top;
+    if (y >= 0 && y < CONTENT_LINES) dirty_rows |= 1u << y;
 }
 
-// Write a character to the current buffer line
-void buffer_putchar(int x, char c, unsigned char color) {
-    if (buffer_total_lines == 0) {
-        buffer_total_lines = 1;
-    }
-    int buf_idx = (buffer_write_line) % SCROLL_BUFFER_LINES;
-    if (x >= 0 && x < VGA_WIDTH) {
-        scroll_buffer[buf_idx][x] = c;
-        scroll_colors[buf_idx][x] = color;
-    }
+// Write a character to a buffer line
+void buffer_putchar(int line, int x, char c, unsigned char color) {
+    history_put(line, x, VGA_CELL(c, color));
 }
 
-// Scroll up the content area (when we reach bottom)
-void scroll_content_up(void) {
-    buffer_newline();
+// Make sure the cursor's row has a buffer line. A cursor below the last
+// screen row adds lines and scrolls the content up.
+void ensure_cursor_line(void) {
+    int y = cursor_pos / VGA_WIDTH;
+    if (y < HEADER_LINES) return;
+    
+    int line = live_top() + (y - HEADER_LINES);
+    while (history_total <= line) buffer_newline();
+    
+    if (y >= VGA_HEIGHT) {
+        cursor_pos = (VGA_HEIGHT - 1) * VGA_WIDTH + cursor_pos % VGA_WIDTH;
+    }
     redraw_content();
 }
 
+// Move the cursor to the start of the next line, scrolling if needed
+void cursor_newline(void) {
+    cursor_pos += VGA_WIDTH - (cursor_pos % VGA_WIDTH);
+    ensure_cursor_line();
+}
+
+// Return to the live view before writing
+void scroll_to_bottom(void) {
+    if (scroll_offset > 0) {
+        scroll_offset = 0;
+        redraw_content();
+        update_cursor();
+    }
+}
+
 // Scroll view up (Page Up) - shows older content
 void scroll_view_up(void) {
-    int max_scroll = buffer_total_lines - CONTENT_LINES;
-    if (max_scroll < 0) max_scroll = 0;
+    int max_scroll = live_top() - history_oldest();
     if (scroll_offset < max_scroll) {
         scroll_offset += (CONTENT_LINES / 2);  // Scroll half page
         if (scroll_offset > max_scroll) scroll_offset = max_scroll;
@@ -221,45 +248,33 @@ void scroll_view_down(void) {
 }
 
 void print_char(char c, unsigned char color, int x, int y) {
-    unsigned char* vm = (unsigned char*)VGA_MEMORY;
-    int offset = (y * VGA_WIDTH + x) * 2;
-    vm[offset] = c;
-    vm[offset + 1] = color;
+    vga_row(y)[x] = VGA_CELL(c, color);
     
     // Also store in scroll buffer if in content area
     if (y >= HEADER_LINES && scroll_offset == 0) {
-        buffer_putchar(x, c, color);
+        buffer_putchar(live_top() + (y - HEADER_LINES), x, c, color);
     }
 }
 
+// Print at the cursor and advance it, wrapping onto a new line
+void put_char(char c, unsigned char color) {
+    print_char(c, color, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
+    cursor_pos++;
+    if (cursor_pos % VGA_WIDTH == 0) ensure_cursor_line();
+}
+
 void clear_screen(void) {
-    unsigned char* vm = (unsigned char*)VGA_MEMORY;
-    for (int i = 0; i < VGA_WIDTH * VGA_HEIGHT * 2; i += 2) {
-        vm[i] = ' ';
-        vm[i + 1] = WHITE_ON_BLACK;
-    }
+    vga_init(BLANK_CELL);
     cursor_pos = 0;
     update_cursor();
 }
 
 void print_string(const char* str, unsigned char color) {
     while (*str) {
-        int y = cursor_pos / VGA_WIDTH;
-        int x = cursor_pos % VGA_WIDTH;
-        
-        // Check if we need to scroll
-        if (y >= VGA_HEIGHT) {
-            scroll_content_up();
-            cursor_pos = (VGA_HEIGHT - 1) * VGA_WIDTH;
-            y = VGA_HEIGHT - 1;
-            x = 0;
-        }
-        
         if (*str == '\n') {
-            cursor_pos += VGA_WIDTH - (cursor_pos % VGA_WIDTH);
+            cursor_newline();
         } else {
-            print_char(*str, color, x, y);
-            cursor_pos++;
+            put_char(*str, color);
         }
         str++;
     }
@@ -267,31 +282,36 @@ void print_string(const char* str, unsigned char color) {
 
 void print_line(const char* str, unsigned char color) {
     print_string(str, color);
-    
-    // Add current line to buffer before moving to next
-    if (cursor_pos / VGA_WIDTH >= HEADER_LINES && scroll_offset == 0) {
-        buffer_newline();
-    }
-    
-    // Move to next line
-    cursor_pos += VGA_WIDTH - (cursor_pos % VGA_WIDTH);
-    
-    // Check if we need to scroll
-    if (cursor_pos / VGA_WIDTH >= VGA_HEIGHT) {
-        scroll_content_up();
-        cursor_pos = (VGA_HEIGHT - 1) * VGA_WIDTH;
-    }
+    cursor_newline();
 }
 
-void print_int(int num) {
+// Fixed header (lines 0-3), printed at boot and after a plot closes
+void draw_header(void) {
+    cursor_pos = 0;
+    print_line("Calculator OS v0.2", GREEN_ON_BLACK);
+    print_line("Math: + - * / % ^ sqrt abs root(n,x) n! sin cos tan ln log pi e | [1,2] det inv", WHITE_ON_BLACK);
+    print_line("sum(i=1 to 9, i^2) integral(x=0 to 1, x^2) d/dx(x^3, 2) solve(x^2=2, x) ans $n", WHITE_ON_BLACK);
+    print_line("plot x^2, -2, 2 | x=2 f(x)=x^2 vars | iching moji lasagna cache perf mem", WHITE_ON_BLACK);
+}
+
+// Take the screen back from a plot: header, content rows and cursor
+void restore_screen(void) {
+    int saved = cursor_pos;
+    vga_fill_cells(vga_row(0), BLANK_CELL, VGA_WIDTH * HEADER_LINES);
+    draw_header();
+    cursor_pos = saved;
+    dirty_rows = ALL_ROWS_DIRTY;
+    redraw_content();
+    update_cursor();
+}
+
+void print_int_color(int num, unsigned char color) {
     if (num < 0) {
-        print_char('-', WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-        cursor_pos++;
+        put_char('-', color);
         num = -num;
     }
     if (num == 0) {
-        print_char('0', WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-        cursor_pos++;
+        put_char('0', color);
         return;
     }
     char buffer[12];
@@ -301,51 +321,319 @@ void print_int(int num) {
         num /= 10;
     }
     while (i > 0) {
-        print_char(buffer[--i], WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-        cursor_pos++;
+        put_char(buffer[--i], color);
     }
 }
 
+void print_int(int num) {
+    print_int_color(num, WHITE_ON_BLACK);
+}
+
+// Format once into a buffer, then copy the text out
+void print_number(double num, int mode, int precision) {
+    perf_t start = perf_now();
+    char buf[FMT_MAX];
+    fmt_double(buf, num, mode, precision);
+    print_string(buf, WHITE_ON_BLACK);
+    perf_add(PERF_FORMAT, perf_now() - start);
+}
+
+// Shortest digits that read back as the same double
 void print_float(double num) {
-    // Handle negative
-    if (num < 0) {
-        print_char('-', WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-        cursor_pos++;
-        num = -num;
+    print_number(num, FMT_SHORTEST, 0);
+}
+
+// Exact digits from the bignum path when there are any, else the double
+void print_result(double result, const char* exact) {
+    if (!exact) {
+        print_float(result);
+        return;
     }
-    
-    // Print integer part
-    long int_part = (long)num;
-    if (int_part == 0) {
-        print_char('0', WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-        cursor_pos++;
+    perf_t start = perf_now();
+    print_string(exact, WHITE_ON_BLACK);
+    perf_add(PERF_FORMAT, perf_now() - start);
+}
+
+// Vectors print as [a, b, c]; matrices one such row per line, six
+// significant digits per entry. Anything past what fits on the screen is
+// cut short with ...
+#define MATRIX_SHOW_ROWS 12
+#define MATRIX_SHOW_COLS 6
+
+void print_row(const double* row, int cols) {
+    put_char('[', WHITE_ON_BLACK);
+    for (int c = 0; c < cols && c < MATRIX_SHOW_COLS; c++) {
+        if (c > 0) print_string(", ", WHITE_ON_BLACK);
+        print_number(row[c], FMT_GENERAL, 6);
+    }
+    if (cols > MATRIX_SHOW_COLS) print_string(", ...", WHITE_ON_BLACK);
+    put_char(']', WHITE_ON_BLACK);
+}
+
+// Print a vector/matrix result, or matrix_error if it failed. Scalar
+// results get a result number like any other.
+void show_matrix(int ok, const matrix_value* result) {
+    matrix_value value = *result;
+    if (!ok) {
+        print_string("error: ", YELLOW_ON_BLACK);
+        print_string(matrix_error, YELLOW_ON_BLACK);
+    } else if (value.kind == MATRIX_SCALAR) {
+        int number = math_push_result(value.scalar);
+        print_string("= ", WHITE_ON_BLACK);
+        print_float(value.scalar);
+        print_string("   $", GRAY_ON_BLACK);
+        print_int_color(number, GRAY_ON_BLACK);
+    } else if (value.kind == MATRIX_VECTOR) {
+        print_string("= ", WHITE_ON_BLACK);
+        print_row(value.data, value.cols);
     } else {
-        char buffer[20];
-        int i = 0;
-        long temp = int_part;
-        while (temp > 0) {
-            buffer[i++] = '0' + (temp % 10);
-            temp /= 10;
+        print_string("= ", WHITE_ON_BLACK);
+        print_int(value.rows);
+        print_string(" x ", WHITE_ON_BLACK);
+        print_int(value.cols);
+        for (int r = 0; r < value.rows && r < MATRIX_SHOW_ROWS; r++) {
+            cursor_newline();
+            print_string("  ", WHITE_ON_BLACK);
+            print_row(value.data + r * value.stride, value.cols);
         }
-        while (i > 0) {
-            print_char(buffer[--i], WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-            cursor_pos++;
+        if (value.rows > MATRIX_SHOW_ROWS) {
+            cursor_newline();
+            print_string("  ...", WHITE_ON_BLACK);
         }
     }
+    cursor_newline();
+}
+
+// Evaluate through the result cache. Results too large for a double also
+// get exact decimal text (in the arena), or 0 in *exact otherwise. The
+// cache keeps only whether there was such text, so a hit reruns the exact
+// path just for those results.
+double calculate(const char* expr, int len, const char** exact) {
+    cache_key key;
+    double result;
+    int has_exact;
+    int cacheable = cache_make_key(expr, len, &key);
     
-    // Print decimal part (4 digits)
-    double frac = num - int_part;
-    if (frac > 0.00005) {
-        print_char('.', WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-        cursor_pos++;
+    if (cacheable && cache_lookup(&key, &result, &has_exact)) {
+        LOG(LOG_DEBUG, "[DEBUG] cache hit: %f\n", result);
+        *exact = has_exact ? evaluate_exact(expr, len, result) : 0;
+    } else {
+        LOG(LOG_DEBUG, "[DEBUG] Calling evaluate()...\n");
+        result = evaluate(expr, len);
+        LOG(LOG_DEBUG, "[DEBUG] evaluate() returned: %f\n", result);
+        *exact = cancel_requested ? 0 : evaluate_exact(expr, len, result);
+        if (cacheable && !cancel_requested) cache_store(&key, result, *exact != 0);
+    }
+    LOG(LOG_INFO, "[CACHE] hits=%u misses=%u entries=%u/%u\n",
+        cache_hits, cache_misses, cache_entries, CACHE_SLOTS);
+    return result;
+}
+
+// Cache counters on screen and, unconditionally, over serial
+void show_cache_stats(void) {
+    print_string("cache: ", WHITE_ON_BLACK);
+    print_int(cache_hits);
+    print_string(" hits, ", WHITE_ON_BLACK);
+    print_int(cache_misses);
+    print_string(" misses, ", WHITE_ON_BLACK);
+    print_int(cache_entries);
+    print_string("/", WHITE_ON_BLACK);
+    print_int(CACHE_SLOTS);
+    print_line(" slots used", WHITE_ON_BLACK);
+    
+    serial_puts("[CACHE] hits=");
+    serial_putint(cache_hits);
+    serial_puts(" misses=");
+    serial_putint(cache_misses);
+    serial_puts(" entries=");
+    serial_putint(cache_entries);
+    serial_puts("\n");
+}
+
+// Arena and pool usage on screen and, unconditionally, over serial
+void show_mem_stats(void) {
+    print_string("arena: ", WHITE_ON_BLACK);
+    print_int(arena_used());
+    print_string("/", WHITE_ON_BLACK);
+    print_int(arena_size);
+    print_string(" bytes, peak ", WHITE_ON_BLACK);
+    print_int(arena_peak);
+    print_string(", ", WHITE_ON_BLACK);
+    print_int(arena_resets);
+    print_string(" resets, ", WHITE_ON_BLACK);
+    print_int(arena_failures);
+    print_line(" failed", WHITE_ON_BLACK);
+    
+    serial_puts("[MEM] arena_used=");
+    serial_putint(arena_used());
+    serial_puts(" arena_size=");
+    serial_putint(arena_size);
+    serial_puts(" arena_peak=");
+    serial_putint(arena_peak);
+    serial_puts(" resets=");
+    serial_putint(arena_resets);
+    serial_puts(" failures=");
+    serial_putint(arena_failures);
+    serial_puts("\n");
+    
+    for (unsigned int i = 0; i < mem_pool_count; i++) {
+        mem_pool* pool = mem_pools[i];
+        print_string("pool ", WHITE_ON_BLACK);
+        print_string(pool->name, WHITE_ON_BLACK);
+        print_string(": ", WHITE_ON_BLACK);
+        print_int(pool->used);
+        print_string("/", WHITE_ON_BLACK);
+        print_int(pool->capacity);
+        print_string(" x ", WHITE_ON_BLACK);
+        print_int(pool->object_size);
+        print_string(" bytes, peak ", WHITE_ON_BLACK);
+        print_int(pool->peak);
+        print_string(", ", WHITE_ON_BLACK);
+        print_int(pool->failures);
+        print_line(" failed", WHITE_ON_BLACK);
         
-        for (int i = 0; i < 4; i++) {
-            frac *= 10;
-            int digit = (int)frac;
-            print_char('0' + digit, WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-            cursor_pos++;
-            frac -= digit;
+        serial_puts("[MEM] pool=");
+        serial_puts(pool->name);
+        serial_puts(" used=");
+        serial_putint(pool->used);
+        serial_puts(" capacity=");
+        serial_putint(pool->capacity);
+        serial_puts(" size=");
+        serial_putint(pool->object_size);
+        serial_puts(" peak=");
+        serial_putint(pool->peak);
+        serial_puts(" failures=");
+        serial_putint(pool->failures);
+        serial_puts("\n");
+    }
+}
+
+// A definition just made: a variable's value (exact digits if there are
+// any) and result number, or the function's signature, then how many
+// dependent variables it updated
+void show_definition(const char* exact) {
+    symbol* s = symbols[symbols_last];
+    print_string(s->name, WHITE_ON_BLACK);
+    if (s->param[0]) {
+        print_string("(", WHITE_ON_BLACK);
+        print_string(s->param, WHITE_ON_BLACK);
+        print_string(") defined", WHITE_ON_BLACK);
+    } else {
+        print_string(" = ", WHITE_ON_BLACK);
+        print_result(s->value, exact);
+        print_string("   $", GRAY_ON_BLACK);
+        print_int_color(math_push_result(s->value), GRAY_ON_BLACK);
+    }
+    if (symbols_updated > 0) {
+        print_string("   ", GRAY_ON_BLACK);
+        print_int_color(symbols_updated, GRAY_ON_BLACK);
+        print_string(symbols_updated == 1 ? " dependent updated" : " dependents updated", GRAY_ON_BLACK);
+    }
+    cursor_newline();
+}
+
+// Every definition with its current value on screen and over serial
+void show_vars(void) {
+    for (unsigned int i = 0; i < symbol_count; i++) {
+        symbol* s = symbols[i];
+        print_string(s->name, WHITE_ON_BLACK);
+        serial_puts("[VARS] ");
+        serial_puts(s->name);
+        if (s->param[0]) {
+            print_string("(", WHITE_ON_BLACK);
+            print_string(s->param, WHITE_ON_BLACK);
+            print_string(")", WHITE_ON_BLACK);
+            serial_puts("(");
+            serial_puts(s->param);
+            serial_puts(")");
         }
+        print_string(" = ", WHITE_ON_BLACK);
+        print_string(s->text, WHITE_ON_BLACK);
+        serial_puts(" = ");
+        serial_puts(s->text);
+        if (!s->param[0]) {
+            print_string("   ", GRAY_ON_BLACK);
+            char buf[FMT_MAX];
+            fmt_double(buf, s->value, FMT_SHORTEST, 0);
+            print_string(buf, GRAY_ON_BLACK);
+            serial_puts(" value=");
+            serial_puts(buf);
+        }
+        cursor_newline();
+        serial_puts("\n");
+    }
+    print_int(symbol_count);
+    print_string("/", WHITE_ON_BLACK);
+    print_int(SYMBOL_MAX);
+    print_string(" definitions, ", WHITE_ON_BLACK);
+    print_int(symbols_recomputed);
+    print_line(" dependent updates", WHITE_ON_BLACK);
+    serial_puts("[VARS] count=");
+    serial_putint(symbol_count);
+    serial_puts(" updates=");
+    serial_putint(symbols_recomputed);
+    serial_puts("\n");
+}
+
+// Cycle count right-aligned in a table column
+void print_cycles(perf_t cycles) {
+    char buf[24];
+    int len = perf_format(buf, cycles);
+    buf[len] = '\0';
+    for (int i = len; i < 11; i++) put_char(' ', WHITE_ON_BLACK);
+    print_string(buf, WHITE_ON_BLACK);
+}
+
+// Per-phase cycles for recent commands on screen, key=value over serial
+void show_perf(void) {
+    print_string("perf: ", WHITE_ON_BLACK);
+    print_int(perf_commands);
+    print_string(" commands, TSC ", WHITE_ON_BLACK);
+    print_int(perf_tsc_khz / 1000);
+    print_string(" MHz, cycles over the last ", WHITE_ON_BLACK);
+    print_int(PERF_WINDOW);
+    cursor_newline();
+    print_line("phase          last        min        avg        max", GRAY_ON_BLACK);
+    
+    for (int i = 0; i < PERF_PROBES; i++) {
+        perf_t last, min, avg, max;
+        perf_stats(i, &last, &min, &avg, &max);
+        int len = 0;
+        while (perf_names[i][len]) len++;
+        print_string(perf_names[i], WHITE_ON_BLACK);
+        for (; len < 8; len++) put_char(' ', WHITE_ON_BLACK);
+        print_cycles(last);
+        print_cycles(min);
+        print_cycles(avg);
+        print_cycles(max);
+        cursor_newline();
+    }
+    
+    perf_dump_serial();
+}
+
+// Full vector/matrix value on one line: [1, 2] or [[1, 2], [3, 4]]
+void serial_put_row(const double* row, int cols) {
+    serial_puts("[");
+    for (int c = 0; c < cols; c++) {
+        if (c > 0) serial_puts(", ");
+        serial_putdouble(row[c]);
+    }
+    serial_puts("]");
+}
+
+void serial_put_matrix(const matrix_value* value) {
+    if (value->kind == MATRIX_SCALAR) {
+        serial_putdouble(value->scalar);
+    } else if (value->kind == MATRIX_VECTOR) {
+        serial_put_row(value->data, value->cols);
+    } else {
+        serial_puts("[");
+        for (int r = 0; r < value->rows; r++) {
+            if (r > 0) serial_puts(", ");
+            serial_put_row(value->data + r * value->stride, value->cols);
+        }
+        serial_puts("]");
     }
 }
 
@@ -360,6 +648,17 @@ int str_eq(const char* a, const char* b) {
     return *a == *b;
 }
 
+// Whether s starts with prefix, ignoring case like str_eq()
+int str_prefix(const char* s, const char* prefix) {
+    while (*prefix) {
+        char cs = *s, cp = *prefix;
+        if (cs >= 'A' && cs <= 'Z') cs += 32;
+        if (cs != cp) return 0;
+        s++; prefix++;
+    }
+    return 1;
+}
+
 unsigned int simple_rand(void) {
     rand_seed = rand_seed * 1103515245 + 12345;
     return (rand_seed >> 16) & 0x7FFF;
@@ -368,8 +667,23 @@ unsigned int simple_rand(void) {
 // Special key codes returned by get_key
 #define KEY_PAGE_UP 128
 #define KEY_PAGE_DOWN 129
+#define KEY_SERIAL_LINE 130  // not a key: a batch line arrived on COM1
 
-char get_key(void) {
+// Sleep until an interrupt delivers input. Interrupts are disabled while
+// checking so an IRQ cannot slip in between the check and the hlt; sti
+// only takes effect after the following instruction, so "sti; hlt" is atomic.
+void wait_for_input(void) {
+    __asm__ volatile("cli");
+    if (keyboard_pending() || serial_line_ready()) {
+        __asm__ volatile("sti");
+        return;
+    }
+    __asm__ volatile("sti\n hlt" : : : "memory");
+}
+
+// Translate scancodes waiting in the keyboard ring until one makes a key;
+// -1 once the ring is empty
+int read_key(void) {
     static unsigned char normal[] = {
         0, 27, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', '\b',
         '\t', 'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n',
@@ -383,9 +697,8 @@ char get_key(void) {
         '|', 'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?', 0, '*', 0, ' '
     };
     
-    while (1) {
-        if ((inb(0x64) & 1) == 0) continue;
-        unsigned char sc = inb(0x60);
+    unsigned char sc;
+    while (keyboard_read(&sc)) {
         if (sc == 0x2A || sc == 0x36) { shift_pressed = 1; continue; }
         if (sc == 0xAA || sc == 0xB6) { shift_pressed = 0; continue; }
         if (sc & 0x80) continue;  // Key release
@@ -401,65 +714,341 @@ char get_key(void) {
             return KEY_PAGE_DOWN;
         }
         
+        // Arrows (0x48, 0x50, 0x4B, 0x4D), used by the plotter
+        if (sc == 0x48) return PLOT_KEY_UP;
+        if (sc == 0x50) return PLOT_KEY_DOWN;
+        if (sc == 0x4B) return PLOT_KEY_LEFT;
+        if (sc == 0x4D) return PLOT_KEY_RIGHT;
+        
         if (sc < 60) {
             rand_seed ^= sc * 31337;
             return shift_pressed ? shifted[sc] : normal[sc];
         }
     }
+    return -1;
+}
+
+// Keys typed while a computation ran, replayed before new ones
+#define TYPEAHEAD_MAX 64
+int typeahead[TYPEAHEAD_MAX];
+int typeahead_len = 0;
+int typeahead_pos = 0;
+
+int get_key(void) {
+    if (typeahead_pos < typeahead_len) return typeahead[typeahead_pos++];
+    typeahead_pos = typeahead_len = 0;
+    
+    while (1) {
+        int key = read_key();
+        if (key >= 0) return key;
+        if (serial_line_ready()) return KEY_SERIAL_LINE;
+        wait_for_input();
+    }
+}
+
+// Longest a computation runs before the REPL gets the CPU back, and how
+// often its progress is redrawn
+#define SLICE_MS 10
+#define PROGRESS_MS 100
+
+// A command's calculation, run as a task of its own: a definition with
+// the variables it recomputes, a matrix expression, or a plain expression
+typedef struct {
+    const char* expr;
+    int len;
+    int defined;          // symbols_define(): 1 made, -1 refused, 0 not one
+    int matrix;           // a matrix expression; ok and value hold its result
+    int ok;
+    matrix_value value;
+    double result;        // a plain expression's value
+    const char* exact;    // its exact digits, or a new variable's, if any
+} computation;
+
+// A plot command or key, run as a task like a calculation
+typedef struct {
+    const char* args;     // for plot_open(), 0 for plot_key()
+    int len;
+    int key;
+    int open;             // the plot is still open
+} plot_step;
+
+unsigned int slice_start = 0;
+int progress_level;           // outermost loop level heard from
+double progress_done;         // its fraction done, -1 if unknown
+int progress_len = 0;         // characters of progress on screen
+
+void compute_task(void* arg) {
+    computation* c = arg;
+    c->matrix = 0;
+    c->exact = 0;
+    c->defined = symbols_define(c->expr, c->len);
+    if (c->defined > 0) {
+        symbol* s = symbols[symbols_last];
+        if (!s->param[0] && !cancel_requested) c->exact = evaluate_exact(s->text, s->text_len, s->value);
+    } else if (c->defined == 0 && matrix_expression(c->expr, c->len)) {
+        // Parsing and evaluation happen in one pass, so both count as PERF_EVAL
+        c->matrix = 1;
+        perf_t start = perf_now();
+        c->ok = matrix_evaluate(c->expr, c->len, &c->value);
+        perf_add(PERF_EVAL, perf_now() - start);
+    } else if (c->defined == 0) {
+        c->result = calculate(c->expr, c->len, &c->exact);
+    }
+}
+
+void plot_task(void* arg) {
+    plot_step* p = arg;
+    p->open = p->args ? plot_open(p->args, p->len) : plot_key(p->key);
+}
+
+// math_poll hook: a computation task gives the REPL a turn once its
+// slice is used up, and stops when Esc has been pressed
+int kernel_poll(int level, double done) {
+    if (level <= progress_level) {
+        progress_level = level;
+        progress_done = done;
+    }
+    if (task_current() != 0 && timer_ticks - slice_start >= SLICE_MS) {
+        task_yield();
+        slice_start = timer_ticks;
+    }
+    return cancel_requested;
 }
 
-void __attribute__((section(".text.start"))) kernel_main(void) {
-    // Initialize serial port for debugging
+// Progress text at the cursor, over the previous text, without moving
+// the cursor. Nothing is drawn while the view is scrolled back.
+void draw_progress(const char* text) {
+    if (scroll_offset > 0) return;
+    int x = cursor_pos % VGA_WIDTH, y = cursor_pos / VGA_WIDTH;
+    int len = 0;
+    for (; text[len] && x + len < VGA_WIDTH; len++) print_char(text[len], GRAY_ON_BLACK, x + len, y);
+    for (int i = len; i < progress_len; i++) print_char(' ', WHITE_ON_BLACK, x + i, y);
+    progress_len = len;
+}
+
+// "37%", or the seconds so far when the loop cannot tell how far it is
+void show_progress(unsigned int elapsed_ms) {
+    char text[32];
+    unsigned int n = progress_done >= 0 ? (unsigned int)(progress_done * 100) : elapsed_ms / 1000;
+    int len = 0;
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = '0' + n % 10;
+        n /= 10;
+    } while (n > 0);
+    while (count > 0) text[len++] = digits[--count];
+    const char* suffix = progress_done >= 0 ? "%  (Esc cancels)" : " s  (Esc cancels)";
+    while (*suffix) text[len++] = *suffix++;
+    text[len] = '\0';
+    draw_progress(text);
+}
+
+// Run fn(arg) as a task while the REPL keeps reading keys: Esc cancels,
+// anything else waits in the typeahead. With show set, Page Up and Page
+// Down scroll and progress is drawn at the cursor; otherwise the screen
+// is left alone. Without a free task fn just runs here. Returns whether
+// it was cancelled.
+int run_task(task_fn fn, void* arg, int show) {
+    progress_level = MATH_MAX_VARS;
+    progress_done = -1;
+    slice_start = timer_ticks;
+    
+    int id = task_start(fn, arg);
+    if (id < 0) {
+        fn(arg);
+    } else {
+        unsigned int start = timer_ticks, shown = start;
+        while (task_alive(id)) {
+            task_yield();
+            int key;
+            while ((key = read_key()) >= 0) {
+                if (key == 27) {
+                    cancel_requested = 1;
+                } else if (show && key == KEY_PAGE_UP) {
+                    scroll_view_up();
+                } else if (show && key == KEY_PAGE_DOWN) {
+                    scroll_view_down();
+                } else if (typeahead_len < TYPEAHEAD_MAX) {
+                    typeahead[typeahead_len++] = key;
+                }
+            }
+            if (show && task_alive(id) && timer_ticks - shown >= PROGRESS_MS) {
+                show_progress(timer_ticks - start);
+                shown = timer_ticks;
+                vga_present();
+            }
+        }
+        if (show) {
+            scroll_to_bottom();
+            draw_progress("");
+        }
+    }
+    
+    int cancelled = cancel_requested;
+    cancel_requested = 0;
+    return cancelled;
+}
+
+// Batch mode: evaluate every complete line waiting on COM1 and write one
+// result per line back to it. The screen is left alone and tracing is
+// muted so the serial stream carries nothing but results. Each line runs
+// as a computation task, so Esc on the keyboard cancels it.
+void run_batch(void) {
+    char line[256];
+    int len;
+    
+    log_muted = 1;
+    while ((len = serial_read_line(line, sizeof(line))) >= 0) {
+        if (len == 0) continue;
+        perf_command_begin();
+        computation c;
+        c.expr = line;
+        c.len = len;
+        if (run_task(compute_task, &c, 0)) {
+            serial_puts("error: cancelled");
+        } else if (c.defined < 0) {
+            serial_puts("error: ");
+            serial_puts(symbols_error);
+        } else if (c.defined) {
+            // Variables answer with their value, functions with their signature
+            symbol* s = symbols[symbols_last];
+            serial_puts(s->name);
+            if (s->param[0]) {
+                serial_puts("(");
+                serial_puts(s->param);
+                serial_puts(")");
+            } else {
+                math_push_result(s->value);
+                serial_puts(" = ");
+                if (c.exact) {
+                    serial_puts(c.exact);
+                } else {
+                    serial_putdouble(s->value);
+                }
+            }
+        } else if (c.matrix) {
+            if (c.ok) {
+                if (c.value.kind == MATRIX_SCALAR) math_push_result(c.value.scalar);
+                serial_put_matrix(&c.value);
+            } else {
+                serial_puts("error: ");
+                serial_puts(matrix_error);
+            }
+        } else {
+            math_push_result(c.result);
+            if (c.exact) {
+                serial_puts(c.exact);
+            } else {
+                serial_putdouble(c.result);
+            }
+        }
+        serial_puts("\n");
+        perf_command_end();
+        arena_reset();
+    }
+    log_muted = 0;
+}
+
+void kernel_main(void);
+
+// Entry point at the start of the image: the loader only copies the file
+// contents, so clear .bss before any C code relies on zeroed globals
+__asm__(
+    ".section .text.start, \"ax\"\n"
+    ".global kernel_entry\n"
+    "kernel_entry:\n"
+    "    cld\n"
+    "    movl $__bss_start, %edi\n"
+    "    movl $__bss_end, %ecx\n"
+    "    subl %edi, %ecx\n"
+    "    shrl $2, %ecx\n"
+    "    xorl %eax, %eax\n"
+    "    rep stosl\n"
+    "    call kernel_main\n"
+    "1:  hlt\n"
+    "    jmp 1b\n"
+    ".previous\n"
+);
+
+void kernel_main(void) {
+    // Initialize serial port for debugging, and the TSC rate for timestamps
     serial_init();
-    serial_puts("\n[DEBUG] Calculator OS v0.2 starting...\n");
+    perf_init();
+    math_trace = log_printf;
+    LOG(LOG_DEBUG, "\n[DEBUG] Calculator OS v0.2 starting...\n");
+    LOG(LOG_DEBUG, "[DEBUG] TSC %u kHz\n", perf_tsc_khz);
     
     // Initialize FPU for floating point support
     init_fpu();
-    serial_puts("[DEBUG] FPU initialized\n");
+    LOG(LOG_DEBUG, "[DEBUG] FPU initialized\n");
     
     // Quick FPU test
-    serial_puts("[DEBUG] Testing FPU: 2.5 + 3.5 = ");
     volatile double a = 2.5;
     volatile double b = 3.5;
     volatile double c = a + b;
-    serial_putdouble(c);
-    serial_puts("\n");
-    serial_puts("[DEBUG] FPU test passed!\n");
+    LOG(LOG_DEBUG, "[DEBUG] Testing FPU: 2.5 + 3.5 = %f\n", c);
+    LOG(LOG_DEBUG, "[DEBUG] FPU test passed!\n");
+    
+    init_memory();
+    symbols_init();
+    task_init();
+    math_poll = kernel_poll;
+    
+    // Interrupts: serial output becomes buffered from here on
+    interrupts_init();
+    serial_enable_irq();
+    keyboard_init();
+    timer_init();
+    interrupts_enable();
     
     // Initialize scroll buffer
     init_scroll_buffer();
     
     clear_screen();
-    // Print fixed header (lines 0-3)
-    print_line("Calculator OS v0.2", GREEN_ON_BLACK);
-    print_line("Math: +, -, *, /, %, ^, (), sqrt(), abs(), root(n,x)", WHITE_ON_BLACK);
-    print_line("Extras: iching, moji, lasagna", WHITE_ON_BLACK);
-    print_line("Enter=run, ESC=clear, Backspace=delete", WHITE_ON_BLACK);
+    draw_header();
     
     // Start content area at line 4
     cursor_pos = HEADER_LINES * VGA_WIDTH;
     print_string("> ", WHITE_ON_BLACK);
     update_cursor();
+    vga_present();
     
     input_length = 0;
     input_buffer[0] = '\0';
     
     while (1) {
-        char key = get_key();
+        int key = get_key();
+        int timed = 0;
+        
+        // Every key goes to an open plot; each redraw is timed like a command
+        if (plotting && key != KEY_SERIAL_LINE) {
+            perf_command_begin();
+            plot_step step = { 0, 0, key, 0 };
+            run_task(plot_task, &step, 0);
+            if (!step.open) {
+                plotting = 0;
+                restore_screen();
+            }
+            perf_t start = perf_now();
+            vga_present();
+            perf_add(PERF_PRESENT, perf_now() - start);
+            perf_command_end();
+            arena_reset();
+            continue;
+        }
         
         if (key == '\n') {
-            // Return to current if scrolled back
-            if (scroll_offset > 0) {
-                scroll_offset = 0;
-                redraw_content();
+            if (input_length > 0) {
+                perf_command_begin();
+                timed = 1;
             }
             
+            // Return to current if scrolled back
+            scroll_to_bottom();
+            
             // Move to next line, scroll if needed
-            cursor_pos += VGA_WIDTH - (cursor_pos % VGA_WIDTH);
-            if (cursor_pos / VGA_WIDTH >= VGA_HEIGHT) {
-                scroll_content_up();
-                cursor_pos = (VGA_HEIGHT - 1) * VGA_WIDTH;
-            }
+            cursor_newline();
             update_cursor();
             
             if (input_length > 0) {
@@ -471,37 +1060,59 @@ void __attribute__((section(".text.start"))) kernel_main(void) {
                     show_asciimoji();
                 } else if (str_eq(input_buffer, "lasagna")) {
                     show_lasagna();
+                } else if (str_eq(input_buffer, "cache")) {
+                    show_cache_stats();
+                } else if (str_eq(input_buffer, "perf")) {
+                    show_perf();
+                } else if (str_eq(input_buffer, "mem")) {
+                    show_mem_stats();
+                } else if (str_eq(input_buffer, "vars")) {
+                    show_vars();
+                } else if (input_length > 5 && str_prefix(input_buffer, "plot ")) {
+                    plot_step step = { input_buffer + 5, input_length - 5, 0, 0 };
+                    int cancelled = run_task(plot_task, &step, 1);
+                    plotting = step.open && !cancelled;
+                    if (cancelled) {
+                        print_line("cancelled", YELLOW_ON_BLACK);
+                    } else if (!plotting) {
+                        print_string("error: ", YELLOW_ON_BLACK);
+                        print_string(plot_error, YELLOW_ON_BLACK);
+                        cursor_newline();
+                    }
                 } else {
-                    serial_puts("[DEBUG] Evaluating: ");
-                    serial_puts(input_buffer);
-                    serial_puts("\n");
-                    
-                    print_string("= ", WHITE_ON_BLACK);
-                    serial_puts("[DEBUG] Calling evaluate()...\n");
-                    
-                    double result = evaluate(input_buffer, input_length);
-                    
-                    serial_puts("[DEBUG] evaluate() returned: ");
-                    serial_putdouble(result);
-                    serial_puts("\n");
+                    LOG(LOG_DEBUG, "[DEBUG] Evaluating: %s\n", input_buffer);
                     
-                    serial_puts("[DEBUG] Calling print_float()...\n");
-                    print_float(result);
-                    serial_puts("[DEBUG] print_float() done\n");
-                    
-                    // Move to next line, scroll if needed
-                    cursor_pos += VGA_WIDTH - (cursor_pos % VGA_WIDTH);
-                    if (cursor_pos / VGA_WIDTH >= VGA_HEIGHT) {
-                        scroll_content_up();
-                        cursor_pos = (VGA_HEIGHT - 1) * VGA_WIDTH;
+                    computation c;
+                    c.expr = input_buffer;
+                    c.len = input_length;
+                    if (run_task(compute_task, &c, 1)) {
+                        // A definition is made all the same, with nan where it was cut short
+                        print_line("cancelled", YELLOW_ON_BLACK);
+                    } else if (c.defined > 0) {
+                        show_definition(c.exact);
+                    } else if (c.defined < 0) {
+                        print_string("error: ", YELLOW_ON_BLACK);
+                        print_string(symbols_error, YELLOW_ON_BLACK);
+                        cursor_newline();
+                    } else if (c.matrix) {
+                        show_matrix(c.ok, &c.value);
+                    } else {
+                        int number = math_push_result(c.result);
+                        
+                        print_string("= ", WHITE_ON_BLACK);
+                        LOG(LOG_DEBUG, "[DEBUG] Calling print_float()...\n");
+                        print_result(c.result, c.exact);
+                        LOG(LOG_DEBUG, "[DEBUG] print_float() done\n");
+                        
+                        // Result number for $n references
+                        print_string("   $", GRAY_ON_BLACK);
+                        print_int_color(number, GRAY_ON_BLACK);
+                        
+                        // Move to next line, scroll if needed
+                        cursor_newline();
                     }
                 }
                 
-                // Print prompt, scroll if needed
-                if (cursor_pos / VGA_WIDTH >= VGA_HEIGHT) {
-                    scroll_content_up();
-                    cursor_pos = (VGA_HEIGHT - 1) * VGA_WIDTH;
-                }
                 print_string("> ", WHITE_ON_BLACK);
                 update_cursor();
                 input_length = 0;
@@ -519,28 +1130,30 @@ void __attribute__((section(".text.start"))) kernel_main(void) {
                 print_char(' ', WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
             }
             update_cursor();
+        } else if (key == KEY_SERIAL_LINE) {
+            run_batch();
         } else if (key == KEY_PAGE_UP) {
             scroll_view_up();
         } else if (key == KEY_PAGE_DOWN) {
             scroll_view_down();
         } else if (key >= 32 && key <= 126 && input_length < 255) {
             // If scrolled back, return to current before typing
-            if (scroll_offset > 0) {
-                scroll_offset = 0;
-                redraw_content();
-            }
+            scroll_to_bottom();
             input_buffer[input_length++] = key;
-            
-            // Check if we need to scroll before printing
-            int y = cursor_pos / VGA_WIDTH;
-            if (y >= VGA_HEIGHT) {
-                scroll_content_up();
-                cursor_pos = (VGA_HEIGHT - 1) * VGA_WIDTH;
-            }
-            
-            print_char(key, WHITE_ON_BLACK, cursor_pos % VGA_WIDTH, cursor_pos / VGA_WIDTH);
-            cursor_pos++;
+            put_char(key, WHITE_ON_BLACK);
             update_cursor();
         }
+        
+        // A plot opened by this command goes over everything printed
+        if (plotting) plot_show();
+        
+        // One CRTC update per input event
+        perf_t start = perf_now();
+        vga_present();
+        perf_add(PERF_PRESENT, perf_now() - start);
+        if (timed) {
+            perf_command_end();
+            arena_reset();  // every command's temporaries go at once
+        }
     }
 }
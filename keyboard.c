@@ -0,0 +1,53 @@
+// Keyboard driver for Calculator OS
+// IRQ1 scancode capture into a lock-free ring buffer
+
+#include "keyboard.h"
+#include "interrupts.h"
+#include "io.h"
+#include "log.h"
+
+#define KBD_DATA   0x60
+#define KBD_STATUS 0x64
+
+// Power of two so indices wrap with a mask. The IRQ handler is the only
+// writer of kbd_head and the main loop the only writer of kbd_tail.
+#define KBD_RING_SIZE 128
+#define KBD_RING_MASK (KBD_RING_SIZE - 1)
+
+static unsigned char kbd_ring[KBD_RING_SIZE];
+static volatile unsigned int kbd_head = 0;
+static volatile unsigned int kbd_tail = 0;
+unsigned int keyboard_dropped = 0;
+
+static void keyboard_irq(void) {
+    unsigned char sc = inb(KBD_DATA);
+    unsigned int head = kbd_head;
+    if (((head + 1) & KBD_RING_MASK) == kbd_tail) {
+        keyboard_dropped++;
+        return;
+    }
+    kbd_ring[head] = sc;
+    __asm__ volatile("" : : : "memory");  // publish data before index
+    kbd_head = (head + 1) & KBD_RING_MASK;
+}
+
+void keyboard_init(void) {
+    // Discard anything the BIOS left in the controller's output buffer
+    while (inb(KBD_STATUS) & 1) inb(KBD_DATA);
+    irq_install(IRQ_KEYBOARD, keyboard_irq);
+    LOG(LOG_DEBUG, "[DEBUG] Keyboard IRQ installed\n");
+}
+
+int keyboard_pending(void) {
+    return kbd_head != kbd_tail;
+}
+
+// Pop one scancode; returns 0 if the ring is empty
+int keyboard_read(unsigned char* scancode) {
+    unsigned int tail = kbd_tail;
+    if (tail == kbd_head) return 0;
+    *scancode = kbd_ring[tail];
+    __asm__ volatile("" : : : "memory");  // consume data before freeing slot
+    kbd_tail = (tail + 1) & KBD_RING_MASK;
+    return 1;
+}
@@ -0,0 +1,13 @@
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+// PS/2 keyboard driver. IRQ1 pushes raw scancodes into a single-producer/
+// single-consumer ring; the main loop pops them with keyboard_read().
+
+void keyboard_init(void);
+int keyboard_pending(void);
+int keyboard_read(unsigned char* scancode);
+
+extern unsigned int keyboard_dropped;
+
+#endif
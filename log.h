@@ -0,0 +1,23 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Compile-time log levels. Messages above LOG_LEVEL are removed entirely
+// by the compiler; `make release` builds with LOG_LEVEL=0 (no tracing).
+#define LOG_NONE  0
+#define LOG_ERROR 1
+#define LOG_WARN  2
+#define LOG_INFO  3
+#define LOG_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_DEBUG
+#endif
+
+// Formats %s, %d, %u, %x, %c and %f (shortest round-trip) to the serial port.
+// Never blocks: if the transmit buffer is full the message is dropped.
+void log_printf(const char* fmt, ...);
+
+#define LOG(level, ...) \
+    do { if ((level) <= LOG_LEVEL) log_printf(__VA_ARGS__); } while (0)
+
+#endif
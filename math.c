@@ -1,232 +1,1660 @@
 // Math module for Calculator OS
 // Supports Level 1: +, -, *, /, (), decimals, negatives
 // Supports Level 2: ^, sqrt(), abs(), %
+// Supports Level 3: sin cos tan asin acos atan, ln, log, log(b, x), pi, e
+// Literals: 1.5, 6.02e23, 0xFF, 0b1010, 0o17
+// Earlier results: ans, $n
+// Factorials: n!
+// Sums and integrals: sum(i=1 to N, ...), integral(x=a to b, ...)
+// Derivatives and roots: d/dx(...), solve(lhs = rhs, x), exact slopes
+// from forward-mode automatic differentiation
+// Implicit products: 2x, 3(4 + 1)
+// User variables and functions (symbols.c): x, f(x)
+// Exact bignum results when a double cannot hold the value
 
 #include "math.h"
+#include "bignum.h"
+#include "log.h"
+#include "mem.h"
+#include "perf.h"
+#include "scan.h"
+#include "sci.h"
+#include "symbols.h"
 
-// External serial debug functions from kernel.c
-extern void serial_puts(const char* s);
-extern void serial_putdouble(double num);
-extern void serial_putc(char c);
+// Bytecode opcodes. OP_CONST and OP_RESULT are followed by a one-byte
+// constant index; for OP_RESULT the constant is a result number. OP_VAR
+// is followed by a variable slot, OP_FN and OP_FN2 by an index into
+// math_functions, OP_SYM and OP_CALL by a user symbol id. OP_SUM and
+// OP_INTEGRAL pop their two bounds, OP_DIFF and OP_SOLVE the point and
+// the first guess; all four are followed by a block header (slot, stack
+// depth, 16-bit body length) and the body, which ends in its own OP_END.
+enum {
+    OP_END = 0,
+    OP_CONST,
+    OP_NEG,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_POW,
+    OP_SQRT,
+    OP_ABS,
+    OP_ROOT,
+    OP_RESULT,
+    OP_FACT,
+    OP_VAR,
+    OP_SUM,
+    OP_INTEGRAL,
+    OP_FN,
+    OP_FN2,
+    OP_SYM,
+    OP_CALL,
+    OP_DIFF,
+    OP_SOLVE
+};
 
-static const char* expr_ptr;
-static const char* expr_end;
+#define BLOCK_HEADER 5
+#define BLOCK_LENGTH(op) ((op)[3] | (op)[4] << 8)
+
+// Most terms a sum will run
+#define MATH_MAX_TERMS 100000000
+
+// Subintervals an adaptive integral may split into
+#define MATH_MAX_INTERVALS 200
+
+// Iterations solve() may take: enough for bisection to narrow any
+// bracket down to adjacent doubles
+#define MATH_MAX_SOLVE_STEPS 1100
+
+#define MATH_NAN __builtin_nan("")
+
+// Everything one compile works on, passed down the parser explicitly so
+// that compiles on different threads (libcalc) cannot interfere
+typedef struct {
+    math_lexer lex;
+
+    // Output
+    math_program* prog;
+    int stack_depth;
+    int max_depth;
+    int failed;
+
+    // Variables in scope; the index is the slot
+    const char* scope_name[MATH_MAX_VARS];
+    int scope_len[MATH_MAX_VARS];
+    int scope_count;
+} parser;
+
+// Results of earlier calculations, for ans and $n
+static double results[MATH_RESULT_HISTORY];
+static int result_count = 0;
+
+void (*math_trace)(const char* fmt, ...) = 0;
+int (*math_poll)(int level, double done) = 0;
+
+// Trace through math_trace, compiled out above LOG_LEVEL like LOG
+#define TRACE(level, ...) \
+    do { if ((level) <= LOG_LEVEL && math_trace) math_trace(__VA_ARGS__); } while (0)
 
 // Forward declarations
-static double parse_expr(void);
-static double parse_term(void);
-static double parse_power(void);
-static double parse_unary(void);
-static double parse_primary(void);
+static void parse_expr(parser* ps);
+static void parse_term(parser* ps);
+static void parse_power(parser* ps);
+static void parse_unary(parser* ps);
+static void parse_primary(parser* ps);
 
-static void skip_spaces(void) {
-    while (expr_ptr < expr_end && *expr_ptr == ' ') expr_ptr++;
+static int is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
 
-static int match(const char* s) {
-    skip_spaces();
-    const char* p = expr_ptr;
-    while (*s && p < expr_end && *p == *s) { p++; s++; }
-    if (*s == '\0') { expr_ptr = p; return 1; }
-    return 0;
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
 }
 
+static int same_name(const char* a, int len, const char* b) {
+    int i = 0;
+    while (i < len && a[i] == b[i]) i++;
+    return i == len && b[i] == '\0';
+}
+
+void math_lex_next(math_lexer* lx) {
+    while (lx->ptr < lx->end && *lx->ptr == ' ') lx->ptr++;
+    const char* p = lx->ptr;
+    lx->tok.start = p;
+    lx->tok.call = 0;
+    if (p == lx->end) {
+        lx->tok.kind = MATH_TOK_END;
+        lx->tok.len = 0;
+        return;
+    }
+
+    if (is_digit(*p) || *p == '.') {
+        int used = scan_number(p, lx->end, &lx->tok.value);
+        if (used > 0) {
+            lx->tok.kind = MATH_TOK_NUMBER;
+            lx->tok.len = used;
+            lx->ptr += used;
+            return;
+        }
+    } else if (is_letter(*p)) {
+        while (p < lx->end && is_letter(*p)) p++;
+        // "7mod2" is 7 % 2, not 7 and a name
+        if (p - lx->ptr != 3 || !same_name(lx->ptr, 3, "mod")) {
+            while (p < lx->end && (is_letter(*p) || is_digit(*p))) p++;
+        }
+        lx->tok.len = p - lx->ptr;
+        lx->ptr = p;
+        lx->tok.kind = MATH_TOK_NAME;
+        if (same_name(lx->tok.start, lx->tok.len, "mod")) {
+            lx->tok.kind = '%';
+        } else if (same_name(lx->tok.start, lx->tok.len, "to")) {
+            lx->tok.kind = MATH_TOK_TO;
+        } else if (same_name(lx->tok.start, lx->tok.len, "ans")) {
+            lx->tok.kind = MATH_TOK_RESULT;
+            lx->tok.value = 0;
+        } else {
+            while (p < lx->end && *p == ' ') p++;
+            lx->tok.call = p < lx->end && *p == '(';
+        }
+        return;
+    } else if (*p == '$') {
+        int n = 0;
+        for (p++; p < lx->end && is_digit(*p); p++) {
+            if (n < 100000000) n = n * 10 + (*p - '0');
+        }
+        lx->tok.kind = MATH_TOK_RESULT;
+        lx->tok.value = n > 0 ? n : -1;
+        lx->tok.len = p - lx->ptr;
+        lx->ptr = p;
+        return;
+    }
+    lx->tok.kind = (unsigned char)*p;
+    lx->tok.len = 1;
+    lx->ptr++;
+}
+
+void math_lex_init(math_lexer* lx, const char* expr, int len) {
+    lx->start = lx->ptr = expr;
+    lx->end = expr + len;
+    lx->nesting = 0;
+    math_lex_next(lx);
+}
+
+// Consume the current token if it is kind
+int math_lex_accept(math_lexer* lx, int kind) {
+    if (lx->tok.kind != kind) return 0;
+    math_lex_next(lx);
+    return 1;
+}
+
+static void next(parser* ps) {
+    math_lex_next(&ps->lex);
+}
+
+static int accept(parser* ps, int kind) {
+    return math_lex_accept(&ps->lex, kind);
+}
+
+// One fsqrt with the FPU set to double precision, so the result is
+// rounded once, correctly, instead of to 64 bits and then to 53
 double math_sqrt(double x) {
     if (x < 0) return 0;
-    if (x == 0) return 0;
-    double guess = x / 2;
-    for (int i = 0; i < 20; i++) {
-        guess = (guess + x / guess) / 2;
-    }
-    return guess;
+    unsigned short saved, control;
+    double result;
+    __asm__ ("fnstcw %0" : "=m" (saved));
+    control = (saved & ~0x0300) | 0x0200;
+    __asm__ volatile ("fldcw %2\n\t"
+                      "fsqrt\n\t"
+                      "fldcw %3"
+                      : "=t" (result) : "0" (x), "m" (control), "m" (saved));
+    return result;
+}
+
+// x87 kernels. Work in 80-bit extended precision so the final double
+// result is correctly rounded in all but the hardest cases.
+
+// Round to nearest integer (default FPU rounding mode)
+static long double x87_round(long double x) {
+    long double result;
+    __asm__ ("frndint" : "=t" (result) : "0" (x));
+    return result;
+}
+
+// 2^x: split x into integer and fraction so f2xm1 stays inside its
+// [-1, 1] domain, then apply the integer part with fscale.
+static long double x87_exp2(long double x) {
+    long double whole = x87_round(x);
+    long double frac = x - whole;
+    long double result;
+    __asm__ ("f2xm1" : "=t" (result) : "0" (frac));
+    result += 1.0L;
+    __asm__ ("fscale" : "=t" (result) : "0" (result), "u" (whole));
+    return result;
+}
+
+// y * log2(x) in one fyl2x
+static long double x87_ylog2(long double y, long double x) {
+    long double result;
+    __asm__ ("fyl2x" : "=t" (result) : "0" (x), "u" (y) : "st(1)");
+    return result;
+}
+
+double math_exp(double x) {
+    long double log2e;
+    __asm__ ("fldl2e" : "=t" (log2e));
+    return (double)x87_exp2(x * log2e);
+}
+
+// Whether y is an odd integer, for the sign of a negative base's power.
+// From 2^53 up every double is an even integer.
+static int odd_integer(double y) {
+    return math_abs(y) < 9007199254740992.0 && x87_round(y) == y && x87_round(y / 2) != y / 2;
 }
 
 double math_pow(double base, double exp) {
     if (exp == 0) return 1;
     if (base == 0) return 0;
     
-    // Handle negative exponents
-    int neg = 0;
-    if (exp < 0) { neg = 1; exp = -exp; }
-    
-    // Integer part
-    int int_exp = (int)exp;
-    double result = 1;
-    for (int i = 0; i < int_exp; i++) {
-        result *= base;
-    }
-    
-    // Fractional part using sqrt approximation
-    double frac = exp - int_exp;
-    if (frac > 0 && base > 0) {
-        // x^0.5 = sqrt(x), approximate other fractions
-        double ln_base = 0;
-        double term = (base - 1) / (base + 1);
-        double term_sq = term * term;
-        double current = term;
-        for (int i = 0; i < 10; i++) {
-            ln_base += current / (2 * i + 1);
-            current *= term_sq;
-        }
-        ln_base *= 2;
-        
-        double exp_val = frac * ln_base;
-        double frac_result = 1;
-        double term2 = 1;
-        for (int i = 1; i < 15; i++) {
-            term2 *= exp_val / i;
-            frac_result += term2;
+    // Results past the double range come back at once: x87 overflow and
+    // denormal handling below would take microseconds. log2|base| is
+    // within 1 of its binary exponent, so only powers that might leave
+    // the range pay for the exact y * log2|x|.
+    union { double d; unsigned long long bits; } u = { base };
+    int e2 = (int)((u.bits >> 52) & 0x7FF) - 1023;
+    if (math_abs(exp) * (e2 < 0 ? -e2 : e2 + 1) >= 1022) {
+        long double scale = x87_ylog2(exp, math_abs(base));
+        if (scale >= 1024 || scale < -1080) {
+            if (base < 0 && x87_round(exp) != exp) return 0;
+            double result = scale >= 1024 ? __builtin_inf() : 0;
+            return base < 0 && odd_integer(exp) ? -result : result;
         }
-        result *= frac_result;
     }
     
-    return neg ? 1 / result : result;
+    // Integer exponents: square-and-multiply, at most 32 steps
+    if (exp >= -2147483647.0 && exp <= 2147483647.0 && exp == (double)(int)exp) {
+        int e = (int)exp;
+        unsigned int n = e < 0 ? -(unsigned int)e : (unsigned int)e;
+        long double b = base;
+        long double result = 1;
+        while (n) {
+            if (n & 1) result *= b;
+            b *= b;
+            n >>= 1;
+        }
+        return e < 0 ? (double)(1 / result) : (double)result;
+    }
+    
+    // General case: |base|^exp = 2^(exp * log2|base|)
+    int negate = 0;
+    if (base < 0) {
+        // Negative bases only have real powers for integer exponents
+        if (x87_round(exp) != exp) return 0;
+        negate = odd_integer(exp);
+        base = -base;
+    }
+    double result = (double)x87_exp2(x87_ylog2(exp, base));
+    return negate ? -result : result;
 }
 
 double math_abs(double x) {
     return x < 0 ? -x : x;
 }
 
+// a - trunc(a / b) * b, computed exactly by fprem for any magnitudes
 double math_mod(double a, double b) {
     if (b == 0) return 0;
-    int q = (int)(a / b);
-    return a - q * b;
-}
-
-// Parse a number (integer or decimal)
-static double parse_number(void) {
-    skip_spaces();
-    double num = 0;
-    int has_decimal = 0;
-    double decimal_place = 0.1;
-    
-    while (expr_ptr < expr_end) {
-        char c = *expr_ptr;
-        if (c >= '0' && c <= '9') {
-            if (!has_decimal) {
-                num = num * 10 + (c - '0');
-            } else {
-                num += (c - '0') * decimal_place;
-                decimal_place *= 0.1;
-            }
-            expr_ptr++;
-        } else if (c == '.' && !has_decimal) {
-            has_decimal = 1;
-            expr_ptr++;
-        } else {
-            break;
+    long double x = a, y = b;
+    unsigned short status;
+    do {
+        __asm__ ("fprem\n fnstsw %1" : "+t" (x), "=a" (status) : "u" (y));
+    } while (status & 0x400);  // C2: reduction incomplete
+    return (double)x;
+}
+
+// n! for integers up to 170; beyond that it overflows to infinity, which
+// sends the expression down the exact path
+double math_fact(double n) {
+    if (n < 0 || x87_round(n) != n) return 0;
+    long double result = 1;
+    for (int i = 2; i <= n && i <= 171; i++) result *= i;
+    return (double)result;
+}
+
+// root(n, x) = x^(1/n)
+static double math_root(double n, double x) {
+    return math_pow(x, 1.0 / n);
+}
+
+// Derivatives of the Level 3 functions
+static double d_sin(double x) {
+    return sci_cos(x);
+}
+
+static double d_cos(double x) {
+    return -sci_sin(x);
+}
+
+static double d_tan(double x) {
+    double c = sci_cos(x);
+    return 1 / (c * c);
+}
+
+static double d_asin(double x) {
+    return 1 / math_sqrt(1 - x * x);
+}
+
+static double d_acos(double x) {
+    return -1 / math_sqrt(1 - x * x);
+}
+
+static double d_atan(double x) {
+    return 1 / (1 + x * x);
+}
+
+static double d_ln(double x) {
+    return 1 / x;
+}
+
+static double d_log10(double x) {
+    return 1 / (x * sci_ln(10));
+}
+
+// log(b, x) = ln x / ln b
+static void d_logb(double base, double x, double* d_base, double* d_x) {
+    double ln_base = sci_ln(base);
+    *d_x = 1 / (x * ln_base);
+    *d_base = -sci_ln(x) / (base * ln_base * ln_base);
+}
+
+// Built-in functions. A name may appear once per arity, in adjacent
+// entries. Those with an opcode of their own compile to it; the rest
+// call their handler through OP_FN or OP_FN2.
+const math_function math_functions[] = {
+    { "sqrt", 1, OP_SQRT, math_sqrt, 0, 0, 0 },
+    { "abs", 1, OP_ABS, math_abs, 0, 0, 0 },
+    { "root", 2, OP_ROOT, 0, math_root, 0, 0 },
+    { "sin", 1, OP_FN, sci_sin, 0, d_sin, 0 },
+    { "cos", 1, OP_FN, sci_cos, 0, d_cos, 0 },
+    { "tan", 1, OP_FN, sci_tan, 0, d_tan, 0 },
+    { "asin", 1, OP_FN, sci_asin, 0, d_asin, 0 },
+    { "acos", 1, OP_FN, sci_acos, 0, d_acos, 0 },
+    { "atan", 1, OP_FN, sci_atan, 0, d_atan, 0 },
+    { "ln", 1, OP_FN, sci_ln, 0, d_ln, 0 },
+    { "log", 1, OP_FN, sci_log10, 0, d_log10, 0 },
+    { "log", 2, OP_FN2, 0, sci_logb, 0, d_logb },
+    { 0, 0, 0, 0, 0, 0, 0 }
+};
+
+// Perfect hash of the names: a seeded FNV-1a whose top bits index
+// FUNCTION_SLOTS, with the seed searched on first use until no two names
+// share a slot. A lookup is one hash and one name compare.
+#define FUNCTION_SLOT_BITS 6
+#define FUNCTION_SLOTS (1 << FUNCTION_SLOT_BITS)
+
+static unsigned char function_slot[FUNCTION_SLOTS];  // entry + 1, 0 if empty
+static unsigned int function_seed;
+
+static unsigned int name_hash(const char* name, int len, unsigned int seed) {
+    unsigned int h = seed;
+    for (int i = 0; i < len; i++) h = (h ^ (unsigned char)name[i]) * 16777619u;
+    return h >> (32 - FUNCTION_SLOT_BITS);
+}
+
+static void build_function_table(void) {
+    for (unsigned int seed = 2166136261u; ; seed++) {
+        int i, ok = 1;
+        for (i = 0; i < FUNCTION_SLOTS; i++) function_slot[i] = 0;
+        for (i = 0; ok && math_functions[i].name; i++) {
+            const char* name = math_functions[i].name;
+            int len = 0;
+            while (name[len]) len++;
+            if (i > 0 && same_name(name, len, math_functions[i - 1].name)) continue;  // same name, other arity
+            unsigned int h = name_hash(name, len, seed);
+            if (function_slot[h]) ok = 0;
+            else function_slot[h] = i + 1;
+        }
+        if (ok) {
+            function_seed = seed;
+            return;
         }
     }
-    return num;
 }
 
-// Parse primary: numbers, parentheses, functions
-static double parse_primary(void) {
-    skip_spaces();
+int math_find_function(const char* name, int len, int arity) {
+    if (!function_seed) build_function_table();
+    int i = function_slot[name_hash(name, len, function_seed)] - 1;
+    if (i < 0 || !same_name(name, len, math_functions[i].name)) return -1;
+    for (; math_functions[i].name && same_name(name, len, math_functions[i].name); i++) {
+        if (arity < 0 || math_functions[i].arity == arity) return i;
+    }
+    return -1;
+}
+
+// Emit an opcode; delta is its net effect on the run-time stack depth
+static void emit(parser* ps, unsigned char op, int delta) {
+    if (ps->prog->code_len >= MATH_MAX_CODE - 1) { ps->failed = 1; return; }
+    ps->prog->code[ps->prog->code_len++] = op;
+    ps->stack_depth += delta;
+    if (ps->stack_depth > ps->max_depth) ps->max_depth = ps->stack_depth;
+    if (ps->stack_depth > MATH_MAX_STACK) ps->failed = 1;
+}
+
+// Emit an operand byte for the opcode just emitted
+static void emit_byte(parser* ps, unsigned char value) {
+    if (ps->prog->code_len >= MATH_MAX_CODE - 1) { ps->failed = 1; return; }
+    ps->prog->code[ps->prog->code_len++] = value;
+}
+
+// Emit a constant with the source span of its literal
+static void emit_const(parser* ps, double value, const char* text, int len) {
+    if (ps->prog->const_count >= MATH_MAX_CONSTS) { ps->failed = 1; return; }
+    emit(ps, OP_CONST, 1);
+    if (ps->failed) return;
+    int i = ps->prog->const_count++;
+    ps->prog->code[ps->prog->code_len++] = (unsigned char)i;
+    ps->prog->consts[i] = value;
+    ps->prog->const_pos[i] = text - ps->lex.start;
+    ps->prog->const_len[i] = len;
+}
+
+// Push a stored result; n = 0 means the latest (ans)
+static void emit_result(parser* ps, int n) {
+    emit_const(ps, n, ps->lex.tok.start, 0);
+    if (ps->failed) return;
+    ps->prog->code[ps->prog->code_len - 2] = OP_RESULT;
+}
+
+// Record a result; returns its number for $n references
+int math_push_result(double value) {
+    results[result_count % MATH_RESULT_HISTORY] = value;
+    return ++result_count;
+}
+
+// Result number n (1-based), or the latest for n = 0. Results that were
+// never produced or have been overwritten read as 0.
+double math_result(int n) {
+    if (n == 0) n = result_count;
+    if (n < 1 || n > result_count || n <= result_count - MATH_RESULT_HISTORY) return 0;
+    return results[(n - 1) % MATH_RESULT_HISTORY];
+}
+
+// Slot of the variable with the len-character name, the innermost one
+// if names repeat; -1 if it is not in scope
+static int lookup_var(parser* ps, const char* name, int len) {
+    for (int i = ps->scope_count - 1; i >= 0; i--) {
+        if (ps->scope_len[i] != len) continue;
+        int j = 0;
+        while (j < len && ps->scope_name[i][j] == name[j]) j++;
+        if (j == len) return i;
+    }
+    return -1;
+}
+
+// Record that the program reads a user symbol
+static void use_symbol(parser* ps, int id) {
+    for (int i = 0; i < ps->prog->use_count; i++) {
+        if (ps->prog->uses[i] == id) return;
+    }
+    if (ps->prog->use_count == MATH_MAX_USES) {
+        ps->failed = 1;
+        return;
+    }
+    ps->prog->uses[ps->prog->use_count++] = id;
+}
+
+// Push the value of the named variable, of an enclosing block or a user
+// one. Returns 0 if there is no such variable.
+static int emit_var(parser* ps, const char* name, int len) {
+    int slot = lookup_var(ps, name, len);
+    if (slot >= 0) {
+        emit(ps, OP_VAR, 1);
+        emit_byte(ps, slot);
+        return 1;
+    }
+    int id = symbols_find(name, len);
+    if (id < 0 || symbols_is_function(id)) return 0;
+    use_symbol(ps, id);
+    emit(ps, OP_SYM, 1);
+    emit_byte(ps, id);
+    return 1;
+}
+
+// A block: op and its header, then the body with the variable name in
+// scope and a stack of its own, so sums and integrals can run it over
+// many values at once. With equation set, "lhs = rhs" compiles to
+// lhs - rhs. Delta is op's effect on the enclosing stack.
+static void parse_block(parser* ps, unsigned char op, int delta, const char* name, int name_len, int equation) {
+    if (ps->scope_count == MATH_MAX_VARS) ps->failed = 1;
+    emit(ps, op, delta);
+    emit_byte(ps, ps->scope_count);
+    int header = ps->prog->code_len;
+    emit_byte(ps, 0);
+    emit_byte(ps, 0);
+    emit_byte(ps, 0);
+    if (ps->failed) return;
+    
+    int outer_depth = ps->stack_depth, outer_max = ps->max_depth;
+    ps->stack_depth = ps->max_depth = 0;
+    ps->scope_name[ps->scope_count] = name;
+    ps->scope_len[ps->scope_count++] = name_len;
+    parse_expr(ps);
+    if (equation && accept(ps, '=')) {
+        parse_expr(ps);
+        emit(ps, OP_SUB, -1);
+    }
+    emit(ps, OP_END, 0);
+    ps->scope_count--;
+    
+    int body_len = ps->prog->code_len - (header + 3);
+    ps->prog->code[header] = ps->max_depth;
+    ps->prog->code[header + 1] = body_len & 0xFF;
+    ps->prog->code[header + 2] = body_len >> 8;
+    ps->prog->loops = 1;
+    ps->stack_depth = outer_depth;
+    ps->max_depth = outer_max;
+}
+
+// Swap the code from start to split with the code after it, so what
+// was compiled second runs first
+static void rotate_code(parser* ps, int start, int split) {
+    unsigned char moved[MATH_MAX_CODE];
+    int n = split - start, end = ps->prog->code_len;
+    if (ps->failed) return;
+    for (int i = 0; i < n; i++) moved[i] = ps->prog->code[start + i];
+    for (int i = split; i < end; i++) ps->prog->code[i - n] = ps->prog->code[i];
+    for (int i = 0; i < n; i++) ps->prog->code[end - n + i] = moved[i];
+}
+
+// sum(i=lo to hi, body) and integral(x=a to b, body), after the "(".
+// The bounds compile inline, ahead of the block.
+static void parse_loop(parser* ps, unsigned char op) {
+    const char* name = ps->lex.tok.start;
+    int name_len = ps->lex.tok.len;
+    if (ps->lex.tok.kind != MATH_TOK_NAME) {
+        ps->failed = 1;
+        return;
+    }
+    next(ps);
+    if (!accept(ps, '=')) ps->failed = 1;
+    parse_expr(ps);
+    if (!accept(ps, MATH_TOK_TO) && !accept(ps, ',')) ps->failed = 1;
+    parse_expr(ps);
+    if (!accept(ps, ',')) ps->failed = 1;
+    parse_block(ps, op, -1, name, name_len, 0);
+    accept(ps, ')');
+}
+
+// Length of the variable name in "/dx(" right after a "d" token, which
+// makes it d/dx; 0 if the text does not match
+static int diff_var(parser* ps, const char** name) {
+    const char* p = ps->lex.ptr;
+    while (p < ps->lex.end && *p == ' ') p++;
+    if (p == ps->lex.end || *p++ != '/') return 0;
+    while (p < ps->lex.end && *p == ' ') p++;
+    if (p == ps->lex.end || *p++ != 'd' || p == ps->lex.end || !is_letter(*p)) return 0;
+    *name = p;
+    while (p < ps->lex.end && (is_letter(*p) || is_digit(*p))) p++;
+    int len = p - *name;
+    while (p < ps->lex.end && *p == ' ') p++;
+    if (p == ps->lex.end || *p != '(') return 0;
+    ps->lex.ptr = p + 1;
+    return len;
+}
+
+// d/dx(body) or d/dx(body, at), after the "(": the slope of body in x
+// at the point, by default x's own value. The point compiles after the
+// block and is moved ahead of it.
+static void parse_diff(parser* ps, const char* name, int len) {
+    int start = ps->prog->code_len;
+    parse_block(ps, OP_DIFF, 0, name, len, 0);
+    int split = ps->prog->code_len;
+    if (accept(ps, ',')) {
+        parse_expr(ps);
+    } else if (!emit_var(ps, name, len)) {
+        ps->failed = 1;
+    }
+    accept(ps, ')');
+    rotate_code(ps, start, split);
+}
+
+// solve(lhs = rhs, x) or solve(lhs = rhs, x, guess), after the "(": a
+// root in x of lhs - rhs, searched from the guess, by default x's own
+// value if it has one, else 0. The variable is only named after the
+// equation, so the text is scanned ahead for it.
+static void parse_solve(parser* ps) {
+    const char* p = ps->lex.tok.start;
+    for (int depth = 0; p < ps->lex.end && (depth > 0 || *p != ','); p++) {
+        if (*p == '(' || *p == '[') depth++;
+        if (*p == ')' || *p == ']') depth--;
+    }
+    if (p < ps->lex.end) p++;
+    while (p < ps->lex.end && *p == ' ') p++;
+    const char* name = p;
+    while (p < ps->lex.end && (is_letter(*p) || (p > name && is_digit(*p)))) p++;
+    int len = p - name;
+    if (len == 0) {
+        ps->failed = 1;
+        return;
+    }
+    
+    int start = ps->prog->code_len;
+    parse_block(ps, OP_SOLVE, 0, name, len, 1);
+    if (!accept(ps, ',') || ps->lex.tok.kind != MATH_TOK_NAME) ps->failed = 1;
+    next(ps);
+    int split = ps->prog->code_len;
+    if (accept(ps, ',')) {
+        parse_expr(ps);
+    } else if (!emit_var(ps, name, len)) {
+        emit_const(ps, 0, name, 0);
+    }
+    accept(ps, ')');
+    rotate_code(ps, start, split);
+}
+
+// A call of the function named by the current token, which is followed
+// by "(". The argument count picks the entry: log(x) or log(b, x).
+static void parse_call(parser* ps) {
+    const char* name = ps->lex.tok.start;
+    int len = ps->lex.tok.len;
+    next(ps);
+    next(ps);
+    int arity = 1;
+    parse_expr(ps);
+    while (!ps->failed && accept(ps, ',')) {
+        parse_expr(ps);
+        arity++;
+    }
+    accept(ps, ')');
     
-    // Check for functions
-    if (match("sqrt(")) {
-        double val = parse_expr();
-        match(")");
-        return math_sqrt(val);
+    int fn = math_find_function(name, len, arity);
+    if (fn < 0) {
+        ps->failed = 1;
+        return;
+    }
+    unsigned char op = math_functions[fn].op;
+    emit(ps, op, 1 - arity);
+    if (op == OP_FN || op == OP_FN2) emit_byte(ps, fn);
+}
+
+// Parse primary: numbers, parentheses, functions, variables
+static void parse_primary(parser* ps) {
+    switch (ps->lex.tok.kind) {
+    case MATH_TOK_NUMBER:
+        emit_const(ps, ps->lex.tok.value, ps->lex.tok.start, ps->lex.tok.len);
+        next(ps);
+        // 2x, 2pi, 3(x + 1): a product, binding like a power's base
+        if (ps->lex.tok.kind == MATH_TOK_NAME || ps->lex.tok.kind == '(') {
+            parse_power(ps);
+            emit(ps, OP_MUL, -1);
+        }
+        return;
+    case MATH_TOK_RESULT:
+        emit_result(ps, (int)ps->lex.tok.value);
+        next(ps);
+        return;
+    case '(':
+        next(ps);
+        parse_expr(ps);
+        accept(ps, ')');
+        return;
+    case MATH_TOK_NAME:
+        break;
+    default:
+        // Nothing that starts an operand: "2#3", "1+", ""
+        ps->failed = 1;
+        return;
+    }
+    
+    if (ps->lex.tok.call) {
+        if (same_name(ps->lex.tok.start, ps->lex.tok.len, "sum") || same_name(ps->lex.tok.start, ps->lex.tok.len, "integral")) {
+            unsigned char op = ps->lex.tok.start[0] == 's' ? OP_SUM : OP_INTEGRAL;
+            next(ps);
+            next(ps);
+            parse_loop(ps, op);
+            return;
+        }
+        if (same_name(ps->lex.tok.start, ps->lex.tok.len, "solve")) {
+            next(ps);
+            next(ps);
+            parse_solve(ps);
+            return;
+        }
+        if (math_find_function(ps->lex.tok.start, ps->lex.tok.len, -1) >= 0) {
+            parse_call(ps);
+            return;
+        }
     }
-    if (match("abs(")) {
-        double val = parse_expr();
-        match(")");
-        return math_abs(val);
+    
+    const char* var;
+    int var_len;
+    if (same_name(ps->lex.tok.start, ps->lex.tok.len, "d") && (var_len = diff_var(ps, &var)) > 0) {
+        next(ps);
+        parse_diff(ps, var, var_len);
+        return;
     }
-    if (match("root(")) {
-        double n = parse_expr();
-        match(",");
-        double x = parse_expr();
-        match(")");
-        return math_pow(x, 1.0 / n);
+    
+    // Variables of enclosing blocks, then user variables
+    if (!ps->lex.tok.call && emit_var(ps, ps->lex.tok.start, ps->lex.tok.len)) {
+        next(ps);
+        return;
     }
     
-    // Parentheses
-    if (match("(")) {
-        double val = parse_expr();
-        match(")");
-        return val;
+    // User functions, with their one argument
+    int id = symbols_find(ps->lex.tok.start, ps->lex.tok.len);
+    if (id >= 0 && ps->lex.tok.call && symbols_is_function(id)) {
+        use_symbol(ps, id);
+        next(ps);
+        next(ps);
+        parse_expr(ps);
+        if (ps->lex.tok.kind == ',') ps->failed = 1;
+        accept(ps, ')');
+        emit(ps, OP_CALL, 0);
+        emit_byte(ps, id);
+        return;
     }
     
-    // Number
-    return parse_number();
+    // Constants, unless a variable has the name. Length 0 keeps them off
+    // the exact path, like results.
+    double constant = 0;
+    if (same_name(ps->lex.tok.start, ps->lex.tok.len, "pi")) constant = SCI_PI;
+    if (same_name(ps->lex.tok.start, ps->lex.tok.len, "e")) constant = SCI_E;
+    emit_const(ps, constant, ps->lex.tok.start, 0);
+    if (constant == 0) ps->failed = 1;
+    next(ps);
 }
 
-// Parse unary: -x, +x
-static double parse_unary(void) {
-    skip_spaces();
-    if (match("-")) {
-        return -parse_unary();
+// Parse unary: -x, +x, and postfix n! which binds tighter than both.
+// Every nested operand passes through here, so the depth limit does too.
+static void parse_unary(parser* ps) {
+    if (ps->failed) return;
+    if (ps->lex.nesting == MATH_MAX_DEPTH) {
+        ps->failed = 1;
+        return;
     }
-    if (match("+")) {
-        return parse_unary();
+    ps->lex.nesting++;
+    if (accept(ps, '-')) {
+        parse_unary(ps);
+        emit(ps, OP_NEG, 0);
+    } else if (accept(ps, '+')) {
+        parse_unary(ps);
+    } else {
+        parse_primary(ps);
+        while (!ps->failed && accept(ps, '!')) emit(ps, OP_FACT, 0);
     }
-    return parse_primary();
+    ps->lex.nesting--;
 }
 
 // Parse power: x^y (right associative)
-static double parse_power(void) {
-    double left = parse_unary();
-    skip_spaces();
-    if (match("^")) {
-        double right = parse_power();  // Right associative
-        return math_pow(left, right);
+static void parse_power(parser* ps) {
+    parse_unary(ps);
+    if (accept(ps, '^')) {
+        parse_power(ps);  // Right associative
+        emit(ps, OP_POW, -1);
     }
-    return left;
 }
 
 // Parse term: *, /, %
-static double parse_term(void) {
-    double left = parse_power();
+static void parse_term(parser* ps) {
+    parse_power(ps);
     
-    while (1) {
-        skip_spaces();
-        if (match("*")) {
-            left *= parse_power();
-        } else if (match("/")) {
-            double right = parse_power();
-            left = (right != 0) ? left / right : 0;
-        } else if (match("%") || match("mod")) {
-            left = math_mod(left, parse_power());
+    while (!ps->failed) {
+        if (accept(ps, '*')) {
+            parse_power(ps);
+            emit(ps, OP_MUL, -1);
+        } else if (accept(ps, '/')) {
+            parse_power(ps);
+            emit(ps, OP_DIV, -1);
+        } else if (accept(ps, '%')) {
+            parse_power(ps);
+            emit(ps, OP_MOD, -1);
         } else {
             break;
         }
     }
-    return left;
 }
 
 // Parse expression: +, -
-static double parse_expr(void) {
-    double left = parse_term();
+static void parse_expr(parser* ps) {
+    parse_term(ps);
+    
+    while (!ps->failed) {
+        if (accept(ps, '+')) {
+            parse_term(ps);
+            emit(ps, OP_ADD, -1);
+        } else if (accept(ps, '-')) {
+            parse_term(ps);
+            emit(ps, OP_SUB, -1);
+        } else {
+            break;
+        }
+    }
+}
+
+// Compile an expression into prog, with var (if any) as variable slot 0.
+// Returns 0 on success, -1 if the expression does not fit in the program
+// limits, a sum/integral is malformed, a name is not known, or the text
+// is not a single expression.
+static int compile(const char* expr, int len, const char* var, math_program* prog) {
+    parser state;
+    parser* ps = &state;
+    ps->prog = prog;
+    prog->code_len = 0;
+    prog->const_count = 0;
+    prog->loops = 0;
+    prog->use_count = 0;
+    ps->stack_depth = ps->max_depth = 0;
+    ps->failed = 0;
+    ps->scope_count = 0;
+    if (var) {
+        ps->scope_name[0] = var;
+        ps->scope_len[0] = 0;
+        while (var[ps->scope_len[0]]) ps->scope_len[0]++;
+        ps->scope_count = 1;
+    }
+    
+    math_lex_init(&ps->lex, expr, len);
+    parse_expr(ps);
+    if (ps->lex.tok.kind != MATH_TOK_END) ps->failed = 1;  // "2 3", "1)"
+    emit(ps, OP_END, 0);
+    prog->max_depth = ps->max_depth;
+    
+    if (ps->failed) {
+        prog->code_len = 0;
+        prog->code[0] = OP_END;
+        return -1;
+    }
+    return 0;
+}
+
+int math_compile(const char* expr, int len, math_program* prog) {
+    return compile(expr, len, 0, prog);
+}
+
+// For math_run_array(): var is the input variable, e.g. "x"
+int math_compile_fn(const char* expr, int len, const char* var, math_program* prog) {
+    return compile(expr, len, var, prog);
+}
+
+// Variable values while a block runs: one per lane (step 1) or one
+// shared by all lanes (step 0)
+typedef struct {
+    const double* value[MATH_MAX_VARS];
+    int step[MATH_MAX_VARS];
+} lane_vars;
+
+typedef double lane[MATH_LANES];
+
+// A value with its slope in the variable being differentiated
+typedef struct {
+    double value;
+    double slope;
+} dual;
+
+static double run_loop(const math_program* prog, const unsigned char* op,
+                       const lane_vars* outer, double lo, double hi);
+static double run_point(const math_program* prog, const unsigned char* op,
+                        const dual* outer, double at);
+
+// Run code over n lanes, leaving the results in stack[0]. Each opcode
+// finishes every lane before the next one is dispatched, and the
+// arithmetic loops are plain enough for the compiler to vectorize.
+static void run_lanes(const math_program* prog, const unsigned char* pc,
+                      lane* stack, const lane_vars* vars, int n) {
+    int sp = 0;
+    
+    while (1) {
+        unsigned char op = *pc++;
+        double* a = sp >= 2 ? stack[sp - 2] : 0;
+        double* b = sp >= 1 ? stack[sp - 1] : 0;
+        double value;
+        int i;
+        
+        switch (op) {
+        case OP_CONST:
+        case OP_RESULT:
+            value = prog->consts[*pc++];
+            if (op == OP_RESULT) value = math_result((int)value);
+            b = stack[sp++];
+            for (i = 0; i < n; i++) b[i] = value;
+            break;
+        case OP_SYM:
+            value = symbols_value(*pc++);
+            b = stack[sp++];
+            for (i = 0; i < n; i++) b[i] = value;
+            break;
+        case OP_CALL: {
+            int id = *pc++;
+            for (i = 0; i < n; i++) b[i] = symbols_call(id, b[i]);
+            break;
+        }
+        case OP_VAR: {
+            const double* x = vars->value[*pc];
+            int step = vars->step[*pc++];
+            b = stack[sp++];
+            for (i = 0; i < n; i++) b[i] = x[i * step];
+            break;
+        }
+        case OP_NEG:
+            for (i = 0; i < n; i++) b[i] = -b[i];
+            break;
+        case OP_ADD:
+            for (i = 0; i < n; i++) a[i] += b[i];
+            sp--;
+            break;
+        case OP_SUB:
+            for (i = 0; i < n; i++) a[i] -= b[i];
+            sp--;
+            break;
+        case OP_MUL:
+            for (i = 0; i < n; i++) a[i] *= b[i];
+            sp--;
+            break;
+        case OP_DIV:
+            for (i = 0; i < n; i++) a[i] = b[i] != 0 ? a[i] / b[i] : 0;
+            sp--;
+            break;
+        case OP_MOD:
+            for (i = 0; i < n; i++) a[i] = math_mod(a[i], b[i]);
+            sp--;
+            break;
+        case OP_POW:
+            // Squares are common enough in sums and integrands to skip math_pow
+            for (i = 0; i < n; i++) a[i] = b[i] == 2 ? a[i] * a[i] : math_pow(a[i], b[i]);
+            sp--;
+            break;
+        case OP_ROOT:
+            for (i = 0; i < n; i++) a[i] = math_pow(b[i], 1.0 / a[i]);
+            sp--;
+            break;
+        case OP_SQRT:
+            for (i = 0; i < n; i++) b[i] = math_sqrt(b[i]);
+            break;
+        case OP_ABS:
+            for (i = 0; i < n; i++) b[i] = math_abs(b[i]);
+            break;
+        case OP_FACT:
+            for (i = 0; i < n; i++) b[i] = math_fact(b[i]);
+            break;
+        case OP_FN: {
+            double (*fn)(double) = math_functions[*pc++].fn;
+            for (i = 0; i < n; i++) b[i] = fn(b[i]);
+            break;
+        }
+        case OP_FN2: {
+            double (*fn)(double, double) = math_functions[*pc++].fn2;
+            for (i = 0; i < n; i++) a[i] = fn(a[i], b[i]);
+            sp--;
+            break;
+        }
+        case OP_SUM:
+        case OP_INTEGRAL:
+            // Nested loops run once per lane, seeing that lane's variables
+            for (i = 0; i < n; i++) {
+                lane_vars inner;
+                for (int v = 0; v < MATH_MAX_VARS; v++) {
+                    inner.value[v] = vars->value[v] ? vars->value[v] + i * vars->step[v] : 0;
+                    inner.step[v] = 0;
+                }
+                a[i] = run_loop(prog, pc - 1, &inner, a[i], b[i]);
+            }
+            sp--;
+            pc += BLOCK_HEADER - 1 + BLOCK_LENGTH(pc - 1);
+            break;
+        case OP_DIFF:
+        case OP_SOLVE:
+            for (i = 0; i < n; i++) {
+                dual inner[MATH_MAX_VARS];
+                for (int v = 0; v < MATH_MAX_VARS; v++) {
+                    inner[v].value = vars->value[v] ? vars->value[v][i * vars->step[v]] : 0;
+                    inner[v].slope = 0;
+                }
+                b[i] = run_point(prog, pc - 1, inner, b[i]);
+            }
+            pc += BLOCK_HEADER - 1 + BLOCK_LENGTH(pc - 1);
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+// In-place pairwise sum of n values
+static double pairwise(double* v, int n) {
+    for (int width = 1; width < n; width *= 2) {
+        for (int i = 0; i + width < n; i += 2 * width) v[i] += v[i + width];
+    }
+    return v[0];
+}
+
+// Terms lo, lo + 1, ... up to hi: each pass of lanes is summed pairwise,
+// and the passes are added with Neumaier's compensated summation
+static double run_sum(const math_program* prog, const unsigned char* body, lane* stack,
+                      lane_vars* vars, int slot, double lo, double hi) {
+    if (!(hi >= lo && hi - lo < MATH_MAX_TERMS)) return 0;
+    int terms = (int)(hi - lo) + 1;
+    double x[MATH_LANES];
+    vars->value[slot] = x;
+    
+    double sum = 0, carry = 0;
+    for (int k = 0; k < terms; k += MATH_LANES) {
+        if ((k & (MATH_POLL_STEPS - 1)) == 0 && k > 0 && math_poll &&
+            math_poll(slot, (double)k / terms)) return MATH_NAN;
+        int n = terms - k < MATH_LANES ? terms - k : MATH_LANES;
+        for (int i = 0; i < n; i++) x[i] = lo + (k + i);
+        run_lanes(prog, body, stack, vars, n);
+        
+        double part = pairwise(stack[0], n);
+        double t = sum + part;
+        carry += math_abs(sum) >= math_abs(part) ? (sum - t) + part : (part - t) + sum;
+        sum = t;
+    }
+    return sum + carry;
+}
+
+// Gauss-Kronrod 7/15 rule on [-1, 1]: the non-negative Kronrod nodes,
+// their weights, and the Gauss weights for nodes 1, 3, 5 and 7
+static const double gk_nodes[8] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.0
+};
+static const double gk_weights[8] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+static const double gauss_weights[4] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+typedef struct {
+    double a, b;
+    double value, error;
+} quad_interval;
+
+// The 15 nodes of [a, b]: the midpoint, then pairs either side of it
+static void gk_points(double* x, double a, double b) {
+    double center = (a + b) / 2, half = (b - a) / 2;
+    x[0] = center;
+    for (int j = 0; j < 7; j++) {
+        x[1 + 2 * j] = center - half * gk_nodes[j];
+        x[2 + 2 * j] = center + half * gk_nodes[j];
+    }
+}
+
+// Kronrod value, with its distance from the embedded Gauss rule as the error
+static void gk_estimate(quad_interval* q, const double* f) {
+    double half = (q->b - q->a) / 2;
+    double kronrod = gk_weights[7] * f[0];
+    double gauss = gauss_weights[3] * f[0];
+    for (int j = 0; j < 7; j++) {
+        double pair = f[1 + 2 * j] + f[2 + 2 * j];
+        kronrod += gk_weights[j] * pair;
+        if (j & 1) gauss += gauss_weights[j / 2] * pair;
+    }
+    q->value = kronrod * half;
+    q->error = math_abs((kronrod - gauss) * half);
+}
+
+// Adaptive quadrature: split the interval with the largest error until
+// the total error is negligible next to the integral. Both halves of a
+// split go through the body together, 30 lanes in one pass.
+static double run_integral(const math_program* prog, const unsigned char* body, lane* stack,
+                           lane_vars* vars, int slot, double a, double b) {
+    if (a != a || b != b || a == b) return 0;
+    quad_interval* q = arena_alloc(MATH_MAX_INTERVALS * sizeof(quad_interval));
+    if (!q) return 0;
+    double x[MATH_LANES];
+    vars->value[slot] = x;
+    
+    q[0].a = a;
+    q[0].b = b;
+    gk_points(x, a, b);
+    run_lanes(prog, body, stack, vars, 15);
+    gk_estimate(&q[0], stack[0]);
+    
+    for (int count = 1; ; count++) {
+        if (math_poll && math_poll(slot, -1)) return MATH_NAN;
+        double total = 0, scale = 0, error = 0;
+        int worst = 0;
+        for (int i = 0; i < count; i++) {
+            total += q[i].value;
+            scale += math_abs(q[i].value);
+            error += q[i].error;
+            if (q[i].error > q[worst].error) worst = i;
+        }
+        if (error <= 1e-13 * scale || count == MATH_MAX_INTERVALS) return total;
+        
+        double mid = (q[worst].a + q[worst].b) / 2;
+        q[count].a = mid;
+        q[count].b = q[worst].b;
+        q[worst].b = mid;
+        gk_points(x, q[worst].a, mid);
+        gk_points(x + 15, mid, q[count].b);
+        run_lanes(prog, body, stack, vars, 30);
+        gk_estimate(&q[worst], stack[0]);
+        gk_estimate(&q[count], stack[0] + 15);
+    }
+}
+
+// Run the sum or integral block at op for bounds lo, hi. Its stack and
+// working storage come from the arena and are released afterwards.
+static double run_loop(const math_program* prog, const unsigned char* op,
+                       const lane_vars* outer, double lo, double hi) {
+    void* mark = arena_mark();
+    lane* stack = arena_alloc(op[2] * sizeof(lane));
+    double result = 0;
+    
+    if (stack) {
+        lane_vars vars = *outer;
+        int slot = op[1];
+        vars.step[slot] = 1;
+        if (op[0] == OP_SUM) {
+            result = run_sum(prog, op + BLOCK_HEADER, stack, &vars, slot, lo, hi);
+        } else {
+            result = run_integral(prog, op + BLOCK_HEADER, stack, &vars, slot, lo, hi);
+        }
+    }
+    arena_release(mark);
+    return result;
+}
+
+// a^b: b a^(b-1) a' for the base, a^b ln(a) b' for the exponent, which
+// needs a > 0
+static dual dual_pow(dual a, dual b) {
+    dual r = { math_pow(a.value, b.value), 0 };
+    if (a.slope != 0 && b.value != 0) r.slope = b.value * math_pow(a.value, b.value - 1) * a.slope;
+    if (b.slope != 0) r.slope += a.value > 0 ? r.value * sci_ln(a.value) * b.slope : MATH_NAN;
+    return r;
+}
+
+// Run the code at pc on dual numbers: forward-mode differentiation,
+// each operation applying its derivative rule to the slopes it is given.
+// n!, sums, integrals and nested d/dx or solve have no slope here; they
+// make it NaN, so the result says it has none.
+static dual run_dual(const math_program* prog, const unsigned char* pc, const dual* vars) {
+    dual stack[MATH_MAX_STACK];
+    int sp = 0;
+    dual* a;
+    dual* b;
     
     while (1) {
-        skip_spaces();
-        if (match("+")) {
-            left += parse_term();
-        } else if (match("-")) {
-            left -= parse_term();
+        unsigned char op = *pc++;
+        a = sp >= 2 ? &stack[sp - 2] : 0;
+        b = sp >= 1 ? &stack[sp - 1] : 0;
+        
+        switch (op) {
+        case OP_CONST:
+            stack[sp].value = prog->consts[*pc++];
+            stack[sp++].slope = 0;
+            break;
+        case OP_RESULT:
+            stack[sp].value = math_result((int)prog->consts[*pc++]);
+            stack[sp++].slope = 0;
+            break;
+        case OP_SYM:
+            stack[sp].value = symbols_value(*pc++);
+            stack[sp++].slope = 0;
+            break;
+        case OP_VAR:
+            stack[sp++] = vars[*pc++];
+            break;
+        case OP_NEG:
+            b->value = -b->value;
+            b->slope = -b->slope;
+            break;
+        case OP_ADD:
+            a->value += b->value;
+            a->slope += b->slope;
+            sp--;
+            break;
+        case OP_SUB:
+            a->value -= b->value;
+            a->slope -= b->slope;
+            sp--;
+            break;
+        case OP_MUL:
+            a->slope = a->slope * b->value + a->value * b->slope;
+            a->value *= b->value;
+            sp--;
+            break;
+        case OP_DIV:
+            if (b->value != 0) {
+                a->value /= b->value;
+                a->slope = (a->slope - a->value * b->slope) / b->value;
+            } else {
+                a->value = a->slope = 0;
+            }
+            sp--;
+            break;
+        case OP_MOD: {
+            // a - q b for the whole quotient q
+            double r = math_mod(a->value, b->value);
+            a->slope = b->value != 0 ? a->slope - (a->value - r) / b->value * b->slope : 0;
+            a->value = r;
+            sp--;
+            break;
+        }
+        case OP_POW:
+            *a = dual_pow(*a, *b);
+            sp--;
+            break;
+        case OP_ROOT: {
+            // root(n, x) = x^(1/n)
+            dual e = { 1 / a->value, -a->slope / (a->value * a->value) };
+            *a = dual_pow(*b, e);
+            sp--;
+            break;
+        }
+        case OP_SQRT:
+            b->value = math_sqrt(b->value);
+            b->slope = b->value > 0 ? b->slope / (2 * b->value) : 0;
+            break;
+        case OP_ABS:
+            if (b->value < 0) {
+                b->value = -b->value;
+                b->slope = -b->slope;
+            }
+            break;
+        case OP_FACT:
+            b->value = math_fact(b->value);
+            b->slope = MATH_NAN;
+            break;
+        case OP_FN: {
+            const math_function* f = &math_functions[*pc++];
+            if (b->slope != 0) b->slope *= f->deriv(b->value);
+            b->value = f->fn(b->value);
+            break;
+        }
+        case OP_FN2: {
+            const math_function* f = &math_functions[*pc++];
+            double da, db;
+            f->deriv2(a->value, b->value, &da, &db);
+            a->slope = (a->slope != 0 ? a->slope * da : 0) + (b->slope != 0 ? b->slope * db : 0);
+            a->value = f->fn2(a->value, b->value);
+            sp--;
+            break;
+        }
+        case OP_CALL: {
+            // The chain rule through a user function: its parameter
+            // carries the argument's slope
+            const math_program* callee = &symbols[*pc++]->prog;
+            dual arg[MATH_MAX_VARS] = { *b };
+            *b = run_dual(callee, callee->code, arg);
+            break;
+        }
+        case OP_SUM:
+        case OP_INTEGRAL: {
+            lane_vars outer;
+            for (int v = 0; v < MATH_MAX_VARS; v++) {
+                outer.value[v] = &vars[v].value;
+                outer.step[v] = 0;
+            }
+            a->value = run_loop(prog, pc - 1, &outer, a->value, b->value);
+            a->slope = MATH_NAN;
+            sp--;
+            pc += BLOCK_HEADER - 1 + BLOCK_LENGTH(pc - 1);
+            break;
+        }
+        case OP_DIFF:
+        case OP_SOLVE:
+            b->value = run_point(prog, pc - 1, vars, b->value);
+            b->slope = MATH_NAN;
+            pc += BLOCK_HEADER - 1 + BLOCK_LENGTH(pc - 1);
+            break;
+        default:
+            if (sp > 0) return stack[sp - 1];
+            stack[0].value = stack[0].slope = 0;
+            return stack[0];
+        }
+    }
+}
+
+// A root of the block's body in its variable, from the guess x: Newton
+// steps on exact slopes. Once two points show a sign change the root is
+// bracketed, and a step that leaves the bracket, or follows a Newton
+// step that failed to halve |f|, bisects it instead. Without a usable
+// slope, or when Newton stops making progress before any sign change,
+// probe farther and farther either side of the guess. NaN if no root
+// turns up.
+static double solve(const math_program* prog, const unsigned char* body, dual* vars, int slot, double x) {
+    double guess = x, reach = math_abs(x) + 1;
+    double a = 0, fa = 0, b = 0, best, last = 0;
+    int bracket = 0, newton = 0, stalled = 0, probes = 0;
+    
+    vars[slot].value = x;
+    vars[slot].slope = 1;
+    dual f = run_dual(prog, body, vars);
+    best = math_abs(f.value);
+    
+    for (int step = 0; step < MATH_MAX_SOLVE_STEPS; step++) {
+        if (math_poll && math_poll(slot, -1)) return MATH_NAN;
+        if (f.value == 0) return x;
+        if (f.value != f.value) return MATH_NAN;
+        
+        // Done when a Newton step no longer moves x
+        double next = x - f.value / f.slope;
+        if (next == x) return x;
+        int finite = next - next == 0;
+        if (bracket) {
+            int inside = (next - a) * (next - b) < 0;
+            newton = finite && inside && !(newton && math_abs(f.value) > last / 2);
+            if (!newton) next = a / 2 + b / 2;
+        } else if (!finite || stalled >= 8) {
+            if (!(reach <= 1.7976931348623157e308)) return MATH_NAN;
+            next = probes & 1 ? guess - reach : guess + reach;
+            if (probes++ & 1) reach *= 2;
+            newton = stalled = 0;
         } else {
+            newton = 1;
+        }
+        
+        vars[slot].value = next;
+        dual g = run_dual(prog, body, vars);
+        if (math_abs(g.value) < best) {
+            best = math_abs(g.value);
+            stalled = 0;
+        } else {
+            stalled++;
+        }
+        
+        // Keep the bracket's ends on opposite sides of the root; done
+        // when they are at most an ulp apart
+        int done = 0;
+        if (bracket) {
+            if ((g.value < 0) == (fa < 0)) {
+                a = next;
+                fa = g.value;
+            } else {
+                b = next;
+            }
+            done = math_abs(b - a) <= 0x1p-52 * math_abs(next) + 0x1p-1022;
+        } else if ((g.value < 0) != (f.value < 0)) {
+            a = x;
+            fa = f.value;
+            b = next;
+            bracket = 1;
+        }
+        if (done) {
+            if (g.value != g.value) return MATH_NAN;
+            return math_abs(f.value) < math_abs(g.value) ? x : next;
+        }
+        last = math_abs(f.value);
+        x = next;
+        f = g;
+    }
+    return bracket ? x : MATH_NAN;
+}
+
+// Run the d/dx or solve block at op for the point or guess at. Outer
+// variables hold still: their slopes are 0 here.
+static double run_point(const math_program* prog, const unsigned char* op,
+                        const dual* outer, double at) {
+    dual vars[MATH_MAX_VARS];
+    for (int v = 0; v < MATH_MAX_VARS; v++) {
+        vars[v].value = outer[v].value;
+        vars[v].slope = 0;
+    }
+    int slot = op[1];
+    if (op[0] == OP_SOLVE) return solve(prog, op + BLOCK_HEADER, vars, slot, at);
+    vars[slot].value = at;
+    vars[slot].slope = 1;
+    return run_dual(prog, op + BLOCK_HEADER, vars).slope;
+}
+
+// Doubles hold every integer below 2^53 exactly
+#define EXACT_LIMIT 9007199254740992.0
+
+// Run a compiled program. Stack depth was bounded at compile time. Arg,
+// if set, is the value of variable slot 0. With big set, also report
+// whether any value reached EXACT_LIMIT, where the double result may no
+// longer be exact.
+static inline double run(const math_program* prog, const double* arg, int* big) {
+    double stack[MATH_MAX_STACK];
+    int sp = 0;
+    const unsigned char* pc = prog->code;
+    double right;
+    
+    while (1) {
+        switch (*pc++) {
+        case OP_CONST:
+            stack[sp++] = prog->consts[*pc++];
+            break;
+        case OP_NEG:
+            stack[sp - 1] = -stack[sp - 1];
+            break;
+        case OP_ADD:
+            sp--;
+            stack[sp - 1] += stack[sp];
+            break;
+        case OP_SUB:
+            sp--;
+            stack[sp - 1] -= stack[sp];
+            break;
+        case OP_MUL:
+            sp--;
+            stack[sp - 1] *= stack[sp];
+            break;
+        case OP_DIV:
+            right = stack[--sp];
+            stack[sp - 1] = (right != 0) ? stack[sp - 1] / right : 0;
+            break;
+        case OP_MOD:
+            sp--;
+            stack[sp - 1] = math_mod(stack[sp - 1], stack[sp]);
+            break;
+        case OP_POW:
+            sp--;
+            stack[sp - 1] = math_pow(stack[sp - 1], stack[sp]);
+            break;
+        case OP_SQRT:
+            stack[sp - 1] = math_sqrt(stack[sp - 1]);
+            break;
+        case OP_ABS:
+            stack[sp - 1] = math_abs(stack[sp - 1]);
+            break;
+        case OP_RESULT:
+            stack[sp++] = math_result((int)prog->consts[*pc++]);
+            break;
+        case OP_ROOT:
+            // root(n, x) = x^(1/n)
+            sp--;
+            stack[sp - 1] = math_pow(stack[sp], 1.0 / stack[sp - 1]);
+            break;
+        case OP_FACT:
+            stack[sp - 1] = math_fact(stack[sp - 1]);
+            break;
+        case OP_FN:
+            stack[sp - 1] = math_functions[*pc++].fn(stack[sp - 1]);
+            break;
+        case OP_FN2:
+            sp--;
+            stack[sp - 1] = math_functions[*pc++].fn2(stack[sp - 1], stack[sp]);
+            break;
+        case OP_SYM:
+            stack[sp++] = symbols_value(*pc++);
+            break;
+        case OP_CALL:
+            stack[sp - 1] = symbols_call(*pc++, stack[sp - 1]);
+            break;
+        case OP_VAR:
+            // Other free variables only have values in math_run_array()
+            stack[sp++] = *pc++ == 0 && arg ? *arg : 0;
+            break;
+        case OP_SUM:
+        case OP_INTEGRAL: {
+            lane_vars outer = {{arg}, {0}};
+            sp--;
+            stack[sp - 1] = run_loop(prog, pc - 1, &outer, stack[sp - 1], stack[sp]);
+            pc += BLOCK_HEADER - 1 + BLOCK_LENGTH(pc - 1);
+            break;
+        }
+        case OP_DIFF:
+        case OP_SOLVE: {
+            dual outer[MATH_MAX_VARS] = {{ arg ? *arg : 0, 0 }};
+            stack[sp - 1] = run_point(prog, pc - 1, outer, stack[sp - 1]);
+            pc += BLOCK_HEADER - 1 + BLOCK_LENGTH(pc - 1);
             break;
         }
+        default:
+            return sp > 0 ? stack[sp - 1] : 0;
+        }
+        if (big && !(stack[sp - 1] > -EXACT_LIMIT && stack[sp - 1] < EXACT_LIMIT)) *big = 1;
+    }
+}
+
+double math_run(const math_program* prog) {
+    return run(prog, 0, 0);
+}
+
+// Evaluate a math_compile_fn() program at a single x
+double math_run_at(const math_program* prog, double x) {
+    return run(prog, &x, 0);
+}
+
+// Evaluate a math_compile_fn() program at every x[i], MATH_LANES at a time
+void math_run_array(const math_program* prog, const double* x, double* out, int n) {
+    void* mark = arena_mark();
+    lane* stack = arena_alloc(prog->max_depth * sizeof(lane));
+    lane_vars vars = {{0}, {0}};
+    vars.step[0] = 1;
+    
+    for (int k = 0; k < n; k += MATH_LANES) {
+        int m = n - k < MATH_LANES ? n - k : MATH_LANES;
+        vars.value[0] = x + k;
+        if (stack) run_lanes(prog, prog->code, stack, &vars, m);
+        for (int i = 0; i < m; i++) out[k + i] = stack ? stack[0][i] : 0;
     }
-    return left;
+    arena_release(mark);
 }
 
 double evaluate(const char* expr, int len) {
-    serial_puts("[MATH] evaluate() called, len=");
-    serial_putdouble((double)len);
-    serial_puts("\n");
+    math_program prog;
+    
+    TRACE(LOG_DEBUG, "[MATH] evaluate() called, len=%d\n", len);
     
-    expr_ptr = expr;
-    expr_end = expr + len;
+    perf_t start = perf_now();
+    int failed = math_compile(expr, len, &prog);
+    perf_add(PERF_PARSE, perf_now() - start);
+    if (failed) {
+        TRACE(LOG_WARN, "[MATH] cannot compile expression\n");
+        return 0;
+    }
     
-    serial_puts("[MATH] calling parse_expr()...\n");
-    double result = parse_expr();
-    serial_puts("[MATH] parse_expr() returned: ");
-    serial_putdouble(result);
-    serial_puts("\n");
+    TRACE(LOG_DEBUG, "[MATH] compiled, running bytecode...\n");
+    start = perf_now();
+    double result = math_run(&prog);
+    perf_add(PERF_EVAL, perf_now() - start);
+    TRACE(LOG_DEBUG, "[MATH] math_run() returned: %f\n", result);
     
     return result;
 }
+
+// Rerun a program on bignums, reading constants from the source text.
+// Returns 0 for operations with no exact form (sqrt, root, non-integer
+// powers, Level 3 and user functions, constants, non-integral earlier
+// results and variables) or results too large to hold.
+static int run_exact(const math_program* prog, const char* expr, bignum* out) {
+    bignum stack[MATH_MAX_STACK];
+    int sp = 0;
+    const unsigned char* pc = prog->code;
+    int i, ok = 1;
+    
+    while (ok) {
+        // Bignum steps take up to milliseconds each; a cancel gives no text
+        if (math_poll && math_poll(0, -1)) return 0;
+        switch (*pc++) {
+        case OP_CONST:
+            i = *pc++;
+            if (prog->const_len[i] == 0) return 0;  // pi, e
+            ok = big_parse(&stack[sp++], expr + prog->const_pos[i], prog->const_len[i]);
+            break;
+        case OP_RESULT:
+            ok = big_from_double(&stack[sp++], math_result((int)prog->consts[*pc++]));
+            break;
+        case OP_SYM:
+            ok = big_from_double(&stack[sp++], symbols_value(*pc++));
+            break;
+        case OP_NEG:
+            if (stack[sp - 1].len) stack[sp - 1].neg = !stack[sp - 1].neg;
+            break;
+        case OP_ABS:
+            stack[sp - 1].neg = 0;
+            break;
+        case OP_ADD:
+            sp--;
+            ok = big_add(&stack[sp - 1], &stack[sp - 1], &stack[sp]);
+            break;
+        case OP_SUB:
+            sp--;
+            ok = big_sub(&stack[sp - 1], &stack[sp - 1], &stack[sp]);
+            break;
+        case OP_MUL:
+            sp--;
+            ok = big_mul(&stack[sp - 1], &stack[sp - 1], &stack[sp]);
+            break;
+        case OP_DIV:
+            sp--;
+            ok = big_div(&stack[sp - 1], &stack[sp - 1], &stack[sp]);
+            break;
+        case OP_MOD:
+            sp--;
+            ok = big_mod(&stack[sp - 1], &stack[sp - 1], &stack[sp]);
+            break;
+        case OP_POW:
+            sp--;
+            ok = big_pow(&stack[sp - 1], &stack[sp - 1], &stack[sp]);
+            break;
+        case OP_FACT:
+            ok = big_fact(&stack[sp - 1], &stack[sp - 1]);
+            break;
+        case OP_END:
+            if (sp == 0) return 0;
+            *out = stack[sp - 1];
+            return 1;
+        default:
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Exact decimal text when the double path may have lost integer digits:
+// the result, or any value on the way to it, reached 2^53 in magnitude
+// or overflowed. Returns 0 when the double result stands. The text lives
+// in the arena until the command ends.
+const char* evaluate_exact(const char* expr, int len, double approx) {
+    math_program prog;
+    if (math_compile(expr, len, &prog) != 0) return 0;
+    return math_exact(&prog, expr, approx);
+}
+
+const char* math_exact(const math_program* prog, const char* expr, double approx) {
+    if (prog->loops) return 0;
+    
+    perf_t start = perf_now();
+    int big = !(approx > -EXACT_LIMIT && approx < EXACT_LIMIT);
+    if (!big) run(prog, 0, &big);
+    perf_add(PERF_EVAL, perf_now() - start);
+    if (!big) return 0;
+    
+    void* mark = arena_mark();
+    bignum value;
+    start = perf_now();
+    int ok = run_exact(prog, expr, &value);
+    perf_add(PERF_EVAL, perf_now() - start);
+    
+    int max = BIG_MAX_LIMBS * BIG_DIGITS + BIG_SCALE + 4;
+    char* text = ok && big_round(&value, BIG_SCALE) ? arena_alloc(max) : 0;
+    if (!text || !big_format(&value, text, max)) {
+        TRACE(LOG_DEBUG, "[MATH] no exact result, keeping the double\n");
+        arena_release(mark);
+        return 0;
+    }
+    TRACE(LOG_DEBUG, "[MATH] exact result, %d limbs\n", value.len);
+    return text;
+}
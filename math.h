@@ -1,11 +1,140 @@
 #ifndef MATH_H
 #define MATH_H
 
+// Compiled expression: flat stack-machine bytecode plus a constant pool.
+// Compile once with math_compile(), then math_run() as often as needed.
+#define MATH_MAX_CODE 512
+#define MATH_MAX_CONSTS 128
+#define MATH_MAX_STACK 64
+
+// User symbols one program may read
+#define MATH_MAX_USES 16
+
+// Variables in scope at once: a function's own plus nested sum/integral ones
+#define MATH_MAX_VARS 4
+
+// Nesting the parser accepts: parentheses, signs, powers and calls,
+// each level one recursion, so hostile input cannot exhaust the stack
+#define MATH_MAX_DEPTH 64
+
+// Values per pass when a program runs over many inputs; each opcode loops
+// over this many lanes before the next one is dispatched
+#define MATH_LANES 32
+
+// Terms a sum runs between calls to math_poll (a power of two)
+#define MATH_POLL_STEPS 4096
+
+// Each constant also records where its literal sits in the source text,
+// so the exact path can reread the digits a double would round.
+typedef struct {
+    unsigned char code[MATH_MAX_CODE];
+    double consts[MATH_MAX_CONSTS];
+    unsigned short const_pos[MATH_MAX_CONSTS];
+    unsigned short const_len[MATH_MAX_CONSTS];  // 0 for result numbers, pi, e
+    int code_len;
+    int const_count;
+    int max_depth;     // deepest run-time stack
+    int loops;         // contains a block (sum, integral, d/dx, solve), which has no exact form
+    unsigned char uses[MATH_MAX_USES];  // user symbols read, each once
+    int use_count;
+} math_program;
+
+// Built-in functions by name; math_find_function() looks one up with a
+// perfect hash. Exactly one of fn and fn2 is set, to match arity, and
+// for OP_FN and OP_FN2 the matching derivative (partial derivatives for
+// two arguments), used by d/dx and solve.
+typedef struct {
+    const char* name;
+    unsigned char arity;
+    unsigned char op;  // bytecode the parser emits for a call
+    double (*fn)(double);
+    double (*fn2)(double, double);
+    double (*deriv)(double);
+    void (*deriv2)(double a, double b, double* da, double* db);
+} math_function;
+
+// Ends with a null name
+extern const math_function math_functions[];
+
+// Index of the function with the len-character name and arity (any
+// arity if negative), -1 if there is none
+int math_find_function(const char* name, int len, int arity);
+
+// Earlier results referenced as ans (latest) and $n
+#define MATH_RESULT_HISTORY 256
+
+// Compiling keeps its state on the caller's stack and running only reads
+// the program, so both may happen on several threads at once as long as
+// results and user symbols do not change meanwhile. Sums and integrals
+// take scratch space from the calling thread's arena (mem.h).
+int math_compile(const char* expr, int len, math_program* prog);
+int math_compile_fn(const char* expr, int len, const char* var, math_program* prog);
+double math_run(const math_program* prog);
+double math_run_at(const math_program* prog, double x);
+void math_run_array(const math_program* prog, const double* x, double* out, int n);
+
+// The lexer, shared with the matrix parser (matrix.c). Tokens besides
+// single-character operators, which are their own character ('+', '(',
+// ...); "mod" lexes as '%'.
+enum {
+    MATH_TOK_END = 0,
+    MATH_TOK_NUMBER = 256,  // value, text in start/len
+    MATH_TOK_NAME,          // identifier; call is set when a "(" follows
+    MATH_TOK_RESULT,        // ans (value 0) or $n (value n)
+    MATH_TOK_TO             // "to" in sum and integral bounds
+};
+
+typedef struct {
+    const char* start;  // the source text
+    const char* ptr;    // lexer position
+    const char* end;
+
+    // The current token. The lexer makes a single pass over the input,
+    // one token ahead of the parser.
+    struct {
+        int kind;
+        const char* start;
+        int len;
+        int call;
+        double value;
+    } tok;
+
+    int nesting;  // the parser's unary levels under way, up to MATH_MAX_DEPTH
+} math_lexer;
+
+// Start on expr with its first token read
+void math_lex_init(math_lexer* lx, const char* expr, int len);
+void math_lex_next(math_lexer* lx);
+int math_lex_accept(math_lexer* lx, int kind);
+
+// Trace output from the engine, in log_printf() format. The kernel
+// points it at the serial log; null, the default, drops the trace.
+extern void (*math_trace)(const char* fmt, ...);
+
+// Called from long loops, every MATH_POLL_STEPS terms of a sum, every
+// split of an integral, every solve() step and every step of the exact
+// bignum path, with the loop's nesting level (0 for the outermost in the
+// expression) and the fraction of it done, -1 if that cannot be known.
+// A nonzero return abandons the loop, which then gives nan (no exact
+// text); the hook should keep returning nonzero until the evaluation is
+// over. The kernel yields to the REPL task here, and matrix.c calls it
+// between row sweeps too. Null by default.
+extern int (*math_poll)(int level, double done);
+
 double evaluate(const char* expr, int len);
+const char* evaluate_exact(const char* expr, int len, double approx);
+
+// evaluate_exact() for a program already compiled from expr
+const char* math_exact(const math_program* prog, const char* expr, double approx);
+
+int math_push_result(double value);
+double math_result(int n);
 
 double math_sqrt(double x);
 double math_pow(double base, double exp);
 double math_abs(double x);
 double math_mod(double a, double b);
+double math_fact(double n);
+double math_exp(double x);
 
 #endif
@@ -0,0 +1,735 @@
+// Matrix module for Calculator OS
+// Vector and matrix expressions: [1,2,3] literals, dot, cross, products,
+// det, inv. Built with SSE2; every kernel handles two doubles at a time.
+
+#include "matrix.h"
+#include "math.h"
+#include "mem.h"
+#include "sci.h"
+#include "symbols.h"
+
+typedef double v2df __attribute__((vector_size(16)));
+
+// Matrix product blocking: a BLOCK_K x BLOCK_J panel of the right operand
+// (16 KB) stays in L1 while every row of the left one streams past it
+#define BLOCK_K 32
+#define BLOCK_J 64
+
+// Literals may nest this deep; each level keeps its elements on the stack,
+// as many as a 256-character input line can hold
+#define MAX_NESTING 4
+#define MAX_ITEMS 128
+
+#define AT(v, r, c) ((v)->data[(r) * (v)->stride + (c)])
+
+// For the operations the parser applies: inlined, their locals would
+// widen every parse frame, and those add up per nesting level
+#define OUT_OF_LINE __attribute__((noinline))
+
+const char* matrix_error = 0;
+int matrix_sse_ready = 0;
+
+static unsigned int rand_state = 12345;
+
+static int fail(const char* message) {
+    if (!matrix_error) matrix_error = message;
+    return 0;
+}
+
+// Between row sweeps: give the REPL a turn (math_poll), 0 once cancelled
+static int keep_going(void) {
+    if (math_poll && math_poll(0, -1)) return fail("cancelled");
+    return 1;
+}
+
+// ---- Row kernels: n is an even stride, rows are 16-byte aligned ----
+
+static void row_zero(double* dst, int n) {
+    v2df* d = (v2df*)dst;
+    for (int i = 0; i < n / 2; i++) d[i] = (v2df){0, 0};
+}
+
+static void row_copy(double* dst, const double* src, int n) {
+    v2df* d = (v2df*)dst;
+    const v2df* s = (const v2df*)src;
+    for (int i = 0; i < n / 2; i++) d[i] = s[i];
+}
+
+static void row_swap(double* a, double* b, int n) {
+    v2df* x = (v2df*)a;
+    v2df* y = (v2df*)b;
+    for (int i = 0; i < n / 2; i++) {
+        v2df t = x[i];
+        x[i] = y[i];
+        y[i] = t;
+    }
+}
+
+// dst += a * src, two vectors per iteration
+static void row_axpy(double* dst, const double* src, double a, int n) {
+    v2df va = {a, a};
+    v2df* d = (v2df*)dst;
+    const v2df* s = (const v2df*)src;
+    int i = 0;
+    for (; i + 2 <= n / 2; i += 2) {
+        d[i] += va * s[i];
+        d[i + 1] += va * s[i + 1];
+    }
+    if (i < n / 2) d[i] += va * s[i];
+}
+
+static void row_scale(double* dst, const double* src, double a, int n) {
+    v2df va = {a, a};
+    v2df* d = (v2df*)dst;
+    const v2df* s = (const v2df*)src;
+    for (int i = 0; i < n / 2; i++) d[i] = va * s[i];
+}
+
+// dst = a + sign * b
+static void row_add(double* dst, const double* a, const double* b, double sign, int n) {
+    v2df vs = {sign, sign};
+    v2df* d = (v2df*)dst;
+    const v2df* x = (const v2df*)a;
+    const v2df* y = (const v2df*)b;
+    for (int i = 0; i < n / 2; i++) d[i] = x[i] + vs * y[i];
+}
+
+// Two accumulators hide the add latency
+static double row_dot(const double* a, const double* b, int n) {
+    const v2df* x = (const v2df*)a;
+    const v2df* y = (const v2df*)b;
+    v2df s0 = {0, 0}, s1 = {0, 0};
+    int i = 0;
+    for (; i + 2 <= n / 2; i += 2) {
+        s0 += x[i] * y[i];
+        s1 += x[i + 1] * y[i + 1];
+    }
+    if (i < n / 2) s0 += x[i] * y[i];
+    s0 += s1;
+    return s0[0] + s0[1];
+}
+
+// ---- Values ----
+
+static void make_scalar(matrix_value* v, double x) {
+    v->kind = MATRIX_SCALAR;
+    v->scalar = x;
+    v->rows = v->cols = v->stride = 0;
+    v->data = 0;
+}
+
+// Zeroed rows x cols elements, rows padded to an even stride
+static int alloc_value(matrix_value* v, int kind, int rows, int cols) {
+    if (rows < 1 || cols < 1 || rows > MATRIX_MAX_DIM || cols > MATRIX_MAX_DIM) {
+        return fail("size out of range");
+    }
+    int stride = (cols + 1) & ~1;
+    unsigned char* raw = arena_alloc(rows * stride * sizeof(double) + 8);
+    if (!raw) return fail("out of memory");
+
+    v->kind = kind;
+    v->scalar = 0;
+    v->rows = rows;
+    v->cols = cols;
+    v->stride = stride;
+    v->data = (double*)(((unsigned long)raw + 15) & ~15UL);
+    row_zero(v->data, rows * stride);
+    return 1;
+}
+
+static int copy_value(matrix_value* out, const matrix_value* a) {
+    if (a->kind == MATRIX_SCALAR) {
+        *out = *a;
+        return 1;
+    }
+    matrix_value v;
+    if (!alloc_value(&v, a->kind, a->rows, a->cols)) return 0;
+    row_copy(v.data, a->data, a->rows * a->stride);
+    *out = v;
+    return 1;
+}
+
+static int same_shape(const matrix_value* a, const matrix_value* b) {
+    return a->kind == b->kind && a->rows == b->rows && a->cols == b->cols;
+}
+
+// ---- Operations ----
+
+// a + sign * b; a scalar with a matrix applies to every element
+OUT_OF_LINE static int apply_add(matrix_value* out, const matrix_value* a, const matrix_value* b, double sign) {
+    if (a->kind == MATRIX_SCALAR && b->kind == MATRIX_SCALAR) {
+        make_scalar(out, a->scalar + sign * b->scalar);
+        return 1;
+    }
+    if (a->kind == MATRIX_SCALAR || b->kind == MATRIX_SCALAR) {
+        const matrix_value* m = a->kind == MATRIX_SCALAR ? b : a;
+        double s = a->kind == MATRIX_SCALAR ? a->scalar : sign * b->scalar;
+        double mul = a->kind == MATRIX_SCALAR ? sign : 1;
+        matrix_value v;
+        if (!alloc_value(&v, m->kind, m->rows, m->cols)) return 0;
+        for (int r = 0; r < m->rows; r++) {
+            for (int c = 0; c < m->cols; c++) AT(&v, r, c) = s + mul * AT(m, r, c);
+        }
+        *out = v;
+        return 1;
+    }
+    if (!same_shape(a, b)) return fail("shape mismatch");
+
+    matrix_value v;
+    if (!alloc_value(&v, a->kind, a->rows, a->cols)) return 0;
+    row_add(v.data, a->data, b->data, sign, a->rows * a->stride);
+    *out = v;
+    return 1;
+}
+
+OUT_OF_LINE static int apply_scale(matrix_value* out, const matrix_value* m, double s) {
+    matrix_value v;
+    if (!alloc_value(&v, m->kind, m->rows, m->cols)) return 0;
+    row_scale(v.data, m->data, s, m->rows * m->stride);
+    *out = v;
+    return 1;
+}
+
+// c = a * b for matrices, blocked over k and j (i-k-j order, so the inner
+// loop runs along rows of b and c)
+static int multiply(matrix_value* c, const matrix_value* a, const matrix_value* b) {
+    for (int kk = 0; kk < a->cols; kk += BLOCK_K) {
+        if (!keep_going()) return 0;
+        int kend = kk + BLOCK_K < a->cols ? kk + BLOCK_K : a->cols;
+        for (int jj = 0; jj < b->stride; jj += BLOCK_J) {
+            int width = b->stride - jj < BLOCK_J ? b->stride - jj : BLOCK_J;
+            for (int i = 0; i < a->rows; i++) {
+                double* row = c->data + i * c->stride + jj;
+                const double* left = a->data + i * a->stride;
+                for (int k = kk; k < kend; k++) {
+                    if (left[k] != 0) row_axpy(row, b->data + k * b->stride + jj, left[k], width);
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+OUT_OF_LINE static int apply_mul(matrix_value* out, const matrix_value* a, const matrix_value* b) {
+    if (a->kind == MATRIX_SCALAR && b->kind == MATRIX_SCALAR) {
+        make_scalar(out, a->scalar * b->scalar);
+        return 1;
+    }
+    if (a->kind == MATRIX_SCALAR) return apply_scale(out, b, a->scalar);
+    if (b->kind == MATRIX_SCALAR) return apply_scale(out, a, b->scalar);
+    if (a->kind == MATRIX_VECTOR && b->kind == MATRIX_VECTOR) {
+        return fail("use dot() or cross() for vectors");
+    }
+
+    matrix_value v;
+    if (b->kind == MATRIX_VECTOR) {
+        // Matrix times column vector: one dot product per row
+        if (a->cols != b->cols) return fail("shape mismatch");
+        if (!alloc_value(&v, MATRIX_VECTOR, 1, a->rows)) return 0;
+        for (int r = 0; r < a->rows; r++) {
+            v.data[r] = row_dot(a->data + r * a->stride, b->data, a->stride);
+        }
+    } else {
+        // Row vector or matrix on the left
+        if (a->cols != b->rows) return fail("shape mismatch");
+        if (!alloc_value(&v, a->kind, a->rows, b->cols) || !multiply(&v, a, b)) return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+static int identity(matrix_value* v, int n) {
+    if (!alloc_value(v, MATRIX_MATRIX, n, n)) return 0;
+    for (int i = 0; i < n; i++) AT(v, i, i) = 1;
+    return 1;
+}
+
+static double max_abs(const matrix_value* a) {
+    double m = 0;
+    for (int i = 0; i < a->rows * a->stride; i++) {
+        double x = a->data[i] < 0 ? -a->data[i] : a->data[i];
+        if (x > m) m = x;
+    }
+    return m;
+}
+
+// Row with the largest |value| in column c, from row c down
+static int pivot_row(const matrix_value* a, int c) {
+    int best = c;
+    double best_abs = -1;
+    for (int r = c; r < a->rows; r++) {
+        double x = AT(a, r, c) < 0 ? -AT(a, r, c) : AT(a, r, c);
+        if (x > best_abs) {
+            best_abs = x;
+            best = r;
+        }
+    }
+    return best;
+}
+
+// Determinant by LU elimination with partial pivoting
+static int determinant(double* out, const matrix_value* m) {
+    if (m->kind != MATRIX_MATRIX || m->rows != m->cols) return fail("det needs a square matrix");
+
+    matrix_value a;
+    if (!copy_value(&a, m)) return 0;
+    double det = 1;
+    for (int c = 0; c < a.rows; c++) {
+        if (!keep_going()) return 0;
+        int p = pivot_row(&a, c);
+        if (AT(&a, p, c) == 0) {
+            *out = 0;
+            return 1;
+        }
+        if (p != c) {
+            row_swap(a.data + p * a.stride, a.data + c * a.stride, a.stride);
+            det = -det;
+        }
+        double pivot = AT(&a, c, c);
+        det *= pivot;
+
+        // Columns left of c are already zero in the pivot row
+        int start = c & ~1;
+        for (int r = c + 1; r < a.rows; r++) {
+            double f = AT(&a, r, c) / pivot;
+            if (f != 0) {
+                row_axpy(a.data + r * a.stride + start, a.data + c * a.stride + start,
+                         -f, a.stride - start);
+            }
+        }
+    }
+    *out = det;
+    return 1;
+}
+
+// Inverse by Gauss-Jordan elimination on [m | I]
+static int invert(matrix_value* out, const matrix_value* m) {
+    if (m->kind != MATRIX_MATRIX || m->rows != m->cols) return fail("inv needs a square matrix");
+
+    int n = m->rows;
+    matrix_value aug;
+    if (!alloc_value(&aug, MATRIX_MATRIX, n, 2 * n)) return 0;
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) AT(&aug, r, c) = AT(m, r, c);
+        AT(&aug, r, n + r) = 1;
+    }
+
+    double limit = 1e-13 * max_abs(m);
+    for (int c = 0; c < n; c++) {
+        if (!keep_going()) return 0;
+        int p = pivot_row(&aug, c);
+        double x = AT(&aug, p, c);
+        if (!(x > limit || x < -limit)) return fail("singular matrix");
+        if (p != c) row_swap(aug.data + p * aug.stride, aug.data + c * aug.stride, aug.stride);
+
+        int start = c & ~1;
+        double* pivot = aug.data + c * aug.stride;
+        row_scale(pivot + start, pivot + start, 1 / pivot[c], aug.stride - start);
+        for (int r = 0; r < n; r++) {
+            double f = AT(&aug, r, c);
+            if (r != c && f != 0) {
+                row_axpy(aug.data + r * aug.stride + start, pivot + start, -f, aug.stride - start);
+            }
+        }
+    }
+
+    matrix_value v;
+    if (!alloc_value(&v, MATRIX_MATRIX, n, n)) return 0;
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) AT(&v, r, c) = AT(&aug, r, n + c);
+    }
+    *out = v;
+    return 1;
+}
+
+static int transpose(matrix_value* out, const matrix_value* m) {
+    if (m->kind == MATRIX_SCALAR) {
+        *out = *m;
+        return 1;
+    }
+    matrix_value v;
+    if (!alloc_value(&v, MATRIX_MATRIX, m->cols, m->rows)) return 0;
+    for (int r = 0; r < m->rows; r++) {
+        for (int c = 0; c < m->cols; c++) AT(&v, c, r) = AT(m, r, c);
+    }
+    *out = v;
+    return 1;
+}
+
+// Square matrices to integer powers; negative powers invert first
+OUT_OF_LINE static int matrix_power(matrix_value* out, const matrix_value* m, double exp) {
+    if (m->rows != m->cols) return fail("power needs a square matrix");
+    if (exp != (int)exp || exp > 1e6 || exp < -1e6) return fail("matrix power must be an integer");
+
+    matrix_value base, result, next;
+    int n = (int)exp;
+    if (n < 0) {
+        if (!invert(&base, m)) return 0;
+        n = -n;
+    } else {
+        base = *m;
+    }
+    if (!identity(&result, m->rows)) return 0;
+
+    while (n) {
+        if (n & 1) {
+            if (!apply_mul(&next, &result, &base)) return 0;
+            result = next;
+        }
+        n >>= 1;
+        if (n) {
+            if (!apply_mul(&next, &base, &base)) return 0;
+            base = next;
+        }
+    }
+    *out = result;
+    return 1;
+}
+
+// ---- Parser ----
+
+// One evaluation: the math.c lexer, whose nesting count holds this parser
+// to the same MATH_MAX_DEPTH, and the literals open
+typedef struct {
+    math_lexer lex;
+    int literals;
+} matrix_parser;
+
+static int parse_expr(matrix_parser* mp, matrix_value* out);
+static int parse_power(matrix_parser* mp, matrix_value* out);
+
+// Functions implemented here. Those before FN_SQRT exist only for
+// matrices, so a call of one sends the expression to this module.
+enum {
+    FN_DOT,
+    FN_CROSS,
+    FN_DET,
+    FN_INV,
+    FN_TRANSPOSE,
+    FN_EYE,
+    FN_RAND,
+    FN_SQRT,
+    FN_COUNT
+};
+
+static const char* const builtin_names[FN_COUNT] = {
+    "dot", "cross", "det", "inv", "transpose", "eye", "rand", "sqrt"
+};
+
+static int same_name(const char* a, int len, const char* b) {
+    int i = 0;
+    while (i < len && a[i] == b[i]) i++;
+    return i == len && b[i] == '\0';
+}
+
+static int find_builtin(const char* name, int len) {
+    for (int i = 0; i < FN_COUNT; i++) {
+        if (same_name(name, len, builtin_names[i])) return i;
+    }
+    return -1;
+}
+
+static int scalar_arg(matrix_value* v, const char* name) {
+    if (v->kind != MATRIX_SCALAR) return fail(name);
+    return 1;
+}
+
+// [a, b, c] is a vector; a list of equal-length vectors is a matrix.
+// Called after the "[".
+static int parse_literal(matrix_parser* mp, matrix_value* out) {
+    union {
+        double x;
+        const double* row;
+    } items[MAX_ITEMS];
+    int count = 0, kind = -1, cols = 0;
+
+    if (++mp->literals > MAX_NESTING) return fail("nested too deep");
+    do {
+        matrix_value item;
+        if (count == MAX_ITEMS) return fail("size out of range");
+        if (!parse_expr(mp, &item)) return 0;
+
+        if (kind < 0) {
+            kind = item.kind;
+            cols = item.cols;
+        }
+        if (item.kind != kind || item.kind == MATRIX_MATRIX || item.cols != cols) {
+            return fail("literal rows must match");
+        }
+        if (kind == MATRIX_SCALAR) {
+            items[count++].x = item.scalar;
+        } else {
+            items[count++].row = item.data;
+        }
+    } while (math_lex_accept(&mp->lex, ','));
+    if (!math_lex_accept(&mp->lex, ']')) return fail("missing ]");
+    mp->literals--;
+
+    if (kind == MATRIX_SCALAR) {
+        if (!alloc_value(out, MATRIX_VECTOR, 1, count)) return 0;
+        for (int i = 0; i < count; i++) out->data[i] = items[i].x;
+    } else {
+        if (!alloc_value(out, MATRIX_MATRIX, count, cols)) return 0;
+        for (int r = 0; r < count; r++) row_copy(out->data + r * out->stride, items[r].row, out->stride);
+    }
+    return 1;
+}
+
+OUT_OF_LINE static int apply_builtin(matrix_value* out, int fn, matrix_value* a, int count) {
+    if (fn == FN_RAND ? count > 2 : count != (fn <= FN_CROSS ? 2 : 1)) {
+        return fail("wrong number of arguments");
+    }
+    switch (fn) {
+    case FN_DOT:
+        if (a[0].kind != MATRIX_VECTOR || !same_shape(&a[0], &a[1])) {
+            return fail("dot needs two vectors of one length");
+        }
+        make_scalar(out, row_dot(a[0].data, a[1].data, a[0].stride));
+        return 1;
+    case FN_CROSS: {
+        if (a[0].kind != MATRIX_VECTOR || a[0].cols != 3 || !same_shape(&a[0], &a[1])) {
+            return fail("cross needs two 3-vectors");
+        }
+        if (!alloc_value(out, MATRIX_VECTOR, 1, 3)) return 0;
+        const double* u = a[0].data;
+        const double* w = a[1].data;
+        out->data[0] = u[1] * w[2] - u[2] * w[1];
+        out->data[1] = u[2] * w[0] - u[0] * w[2];
+        out->data[2] = u[0] * w[1] - u[1] * w[0];
+        return 1;
+    }
+    case FN_DET: {
+        double det;
+        if (!determinant(&det, &a[0])) return 0;
+        make_scalar(out, det);
+        return 1;
+    }
+    case FN_INV:
+        return invert(out, &a[0]);
+    case FN_TRANSPOSE:
+        return transpose(out, &a[0]);
+    case FN_EYE:
+        if (!scalar_arg(&a[0], "eye needs a size")) return 0;
+        return identity(out, (int)a[0].scalar);
+    case FN_RAND:
+        // rand(n) is square, rand(r, c) is r x c; elements in [0, 1)
+        if (!scalar_arg(&a[0], "rand needs sizes")) return 0;
+        if (count == 1) a[1] = a[0];
+        if (!scalar_arg(&a[1], "rand needs sizes")) return 0;
+        if (!alloc_value(out, MATRIX_MATRIX, (int)a[0].scalar, (int)a[1].scalar)) return 0;
+        for (int r = 0; r < out->rows; r++) {
+            for (int c = 0; c < out->cols; c++) {
+                rand_state = rand_state * 1103515245 + 12345;
+                AT(out, r, c) = (rand_state >> 8) / 16777216.0;
+            }
+        }
+        return 1;
+    default:  // FN_SQRT
+        if (a[0].kind == MATRIX_SCALAR) {
+            make_scalar(out, math_sqrt(a[0].scalar));
+            return 1;
+        }
+        if (!copy_value(out, &a[0])) return 0;
+        v2df* d = (v2df*)out->data;
+        for (int i = 0; i < out->rows * out->stride / 2; i++) {
+            d[i] = __builtin_ia32_sqrtpd(__builtin_ia32_maxpd(d[i], (v2df){0, 0}));
+        }
+        return 1;
+    }
+}
+
+// f, or user function id when f is null, on every element
+OUT_OF_LINE static int apply_each(matrix_value* out, const matrix_value* a, double (*f)(double), int id) {
+    if (a->kind == MATRIX_SCALAR) {
+        make_scalar(out, f ? f(a->scalar) : symbols_call(id, a->scalar));
+        return 1;
+    }
+    if (!copy_value(out, a)) return 0;
+    for (int r = 0; r < out->rows; r++) {
+        for (int c = 0; c < out->cols; c++) {
+            AT(out, r, c) = f ? f(AT(out, r, c)) : symbols_call(id, AT(out, r, c));
+        }
+    }
+    return 1;
+}
+
+// A call of the function named by the current token: one of the above,
+// a math.c function (one-argument ones element-wise) or a user function
+static int parse_call(matrix_parser* mp, matrix_value* out) {
+    const char* name = mp->lex.tok.start;
+    int len = mp->lex.tok.len;
+    matrix_value a[2];
+    int count = 0;
+    math_lex_next(&mp->lex);
+    math_lex_next(&mp->lex);
+    do {
+        if (count == 2) return fail("wrong number of arguments");
+        if (!parse_expr(mp, &a[count++])) return 0;
+    } while (math_lex_accept(&mp->lex, ','));
+    if (!math_lex_accept(&mp->lex, ')')) return fail("missing )");
+
+    int fn = find_builtin(name, len);
+    if (fn >= 0) return apply_builtin(out, fn, a, count);
+    fn = math_find_function(name, len, count);
+    if (fn >= 0 && count == 1) return apply_each(out, &a[0], math_functions[fn].fn, -1);
+    if (fn >= 0) {
+        if (!scalar_arg(&a[0], "needs scalars") || !scalar_arg(&a[1], "needs scalars")) return 0;
+        make_scalar(out, math_functions[fn].fn2(a[0].scalar, a[1].scalar));
+        return 1;
+    }
+    int id = symbols_find(name, len);
+    if (id >= 0 && symbols_is_function(id) && count == 1) return apply_each(out, &a[0], 0, id);
+    return fail("unknown function");
+}
+
+static int parse_primary(matrix_parser* mp, matrix_value* out) {
+    math_lexer* lx = &mp->lex;
+    switch (lx->tok.kind) {
+    case MATH_TOK_NUMBER:
+        make_scalar(out, lx->tok.value);
+        math_lex_next(lx);
+        // 2x, 3(x + 1), 2[1, 2]: a product, binding like a power's base
+        if (lx->tok.kind == MATH_TOK_NAME || lx->tok.kind == '(' || lx->tok.kind == '[') {
+            matrix_value right;
+            return parse_power(mp, &right) && apply_mul(out, out, &right);
+        }
+        return 1;
+    case MATH_TOK_RESULT:
+        make_scalar(out, math_result((int)lx->tok.value));
+        math_lex_next(lx);
+        return 1;
+    case '[':
+        math_lex_next(lx);
+        return parse_literal(mp, out);
+    case '(':
+        math_lex_next(lx);
+        if (!parse_expr(mp, out)) return 0;
+        return math_lex_accept(lx, ')') ? 1 : fail("missing )");
+    case MATH_TOK_NAME:
+        break;
+    default:
+        return fail("syntax error");
+    }
+
+    if (lx->tok.call) return parse_call(mp, out);
+
+    // User variables are scalars; then constants, as in math.c
+    int id = symbols_find(lx->tok.start, lx->tok.len);
+    if (id >= 0 && !symbols_is_function(id)) {
+        make_scalar(out, symbols_value(id));
+    } else if (same_name(lx->tok.start, lx->tok.len, "pi")) {
+        make_scalar(out, SCI_PI);
+    } else if (same_name(lx->tok.start, lx->tok.len, "e")) {
+        make_scalar(out, SCI_E);
+    } else {
+        return fail("unknown name");
+    }
+    math_lex_next(lx);
+    return 1;
+}
+
+// Every nested operand passes through here, so the depth limit does too
+static int parse_unary(matrix_parser* mp, matrix_value* out) {
+    math_lexer* lx = &mp->lex;
+    if (lx->nesting == MATH_MAX_DEPTH) return fail("nested too deep");
+    lx->nesting++;
+    if (math_lex_accept(lx, '-')) {
+        if (!parse_unary(mp, out)) return 0;
+        if (out->kind == MATRIX_SCALAR) {
+            out->scalar = -out->scalar;
+        } else if (!apply_scale(out, out, -1)) {
+            return 0;
+        }
+    } else if (math_lex_accept(lx, '+')) {
+        if (!parse_unary(mp, out)) return 0;
+    } else {
+        if (!parse_primary(mp, out)) return 0;
+        while (math_lex_accept(lx, '!')) {
+            if (out->kind != MATRIX_SCALAR) return fail("! needs a scalar");
+            out->scalar = math_fact(out->scalar);
+        }
+    }
+    lx->nesting--;
+    return 1;
+}
+
+static int parse_power(matrix_parser* mp, matrix_value* out) {
+    if (!parse_unary(mp, out)) return 0;
+    if (!math_lex_accept(&mp->lex, '^')) return 1;
+
+    matrix_value exp;
+    if (!parse_power(mp, &exp)) return 0;
+    if (exp.kind != MATRIX_SCALAR) return fail("exponent must be a scalar");
+    if (out->kind == MATRIX_SCALAR) {
+        out->scalar = math_pow(out->scalar, exp.scalar);
+        return 1;
+    }
+    if (out->kind != MATRIX_MATRIX) return fail("power needs a square matrix");
+    return matrix_power(out, out, exp.scalar);
+}
+
+static int parse_term(matrix_parser* mp, matrix_value* out) {
+    if (!parse_power(mp, out)) return 0;
+
+    while (1) {
+        matrix_value right;
+        if (math_lex_accept(&mp->lex, '*')) {
+            if (!parse_power(mp, &right) || !apply_mul(out, out, &right)) return 0;
+        } else if (math_lex_accept(&mp->lex, '/')) {
+            if (!parse_power(mp, &right)) return 0;
+            if (right.kind != MATRIX_SCALAR) return fail("cannot divide by a matrix");
+            double inverse = right.scalar != 0 ? 1 / right.scalar : 0;
+            if (out->kind == MATRIX_SCALAR) {
+                out->scalar *= inverse;
+            } else if (!apply_scale(out, out, inverse)) {
+                return 0;
+            }
+        } else if (math_lex_accept(&mp->lex, '%')) {
+            if (!parse_power(mp, &right)) return 0;
+            if (out->kind != MATRIX_SCALAR || right.kind != MATRIX_SCALAR) return fail("% needs scalars");
+            out->scalar = math_mod(out->scalar, right.scalar);
+        } else {
+            return 1;
+        }
+    }
+}
+
+static int parse_expr(matrix_parser* mp, matrix_value* out) {
+    if (!parse_term(mp, out)) return 0;
+
+    while (1) {
+        matrix_value right;
+        if (math_lex_accept(&mp->lex, '+')) {
+            if (!parse_term(mp, &right) || !apply_add(out, out, &right, 1)) return 0;
+        } else if (math_lex_accept(&mp->lex, '-')) {
+            if (!parse_term(mp, &right) || !apply_add(out, out, &right, -1)) return 0;
+        } else {
+            return 1;
+        }
+    }
+}
+
+// Whole tokens, so a user function named grand or myinv stays with math.c
+int matrix_expression(const char* expr, int len) {
+    math_lexer lx;
+    for (math_lex_init(&lx, expr, len); lx.tok.kind != MATH_TOK_END; math_lex_next(&lx)) {
+        if (lx.tok.kind == '[') return 1;
+        if (lx.tok.kind == MATH_TOK_NAME && lx.tok.call) {
+            int fn = find_builtin(lx.tok.start, lx.tok.len);
+            if (fn >= 0 && fn < FN_SQRT) return 1;
+        }
+    }
+    return 0;
+}
+
+int matrix_evaluate(const char* expr, int len, matrix_value* result) {
+    matrix_error = 0;
+    if (!matrix_sse_ready) return fail("matrices need SSE2");
+
+    matrix_parser mp;
+    math_lex_init(&mp.lex, expr, len);
+    mp.literals = 0;
+    if (!parse_expr(&mp, result)) return 0;
+    if (mp.lex.tok.kind != MATH_TOK_END) return fail("syntax error");
+    return 1;
+}
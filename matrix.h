@@ -0,0 +1,34 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+// Vectors and matrices. Elements are plain double arrays in the arena,
+// one 16-byte aligned row after another with an even stride, so every
+// kernel works two doubles at a time with SSE2 and padding stays zero.
+// A vector is a single row; on the right of a product it acts as a column.
+
+#define MATRIX_MAX_DIM 512
+
+enum {
+    MATRIX_SCALAR,
+    MATRIX_VECTOR,
+    MATRIX_MATRIX
+};
+
+typedef struct {
+    int kind;
+    double scalar;       // MATRIX_SCALAR only
+    int rows, cols;
+    int stride;          // doubles from one row to the next, even
+    double* data;
+} matrix_value;
+
+// Whether an expression needs this module: [ literals or matrix functions
+int matrix_expression(const char* expr, int len);
+
+// Returns 1 with the value in result, or 0 with matrix_error set
+int matrix_evaluate(const char* expr, int len, matrix_value* result);
+
+extern const char* matrix_error;
+extern int matrix_sse_ready;     // set once SSE is enabled at boot
+
+#endif
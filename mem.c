@@ -0,0 +1,120 @@
+// Memory module for Calculator OS
+// Bump arena for per-command temporaries, fixed-size pools for the rest
+
+#include "mem.h"
+#include "log.h"
+
+static MEM_LOCAL unsigned char* arena_base = 0;
+static MEM_LOCAL unsigned char* arena_ptr = 0;
+static MEM_LOCAL unsigned char* pool_top = 0;  // pools occupy [pool_top, region end)
+
+MEM_LOCAL unsigned int arena_size = 0;
+MEM_LOCAL unsigned int arena_peak = 0;
+MEM_LOCAL unsigned int arena_resets = 0;
+MEM_LOCAL unsigned int arena_failures = 0;
+mem_pool* mem_pools[MEM_MAX_POOLS];
+unsigned int mem_pool_count = 0;
+
+static unsigned int align_up(unsigned int n) {
+    return (n + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
+}
+
+void mem_init(void* base, unsigned int size) {
+    unsigned long mask = MEM_ALIGN - 1;
+    unsigned long start = ((unsigned long)base + mask) & ~mask;
+    unsigned long end = ((unsigned long)base + size) & ~mask;
+    
+    arena_base = arena_ptr = (unsigned char*)start;
+    pool_top = (unsigned char*)end;
+    arena_size = end - start;
+    LOG(LOG_DEBUG, "[MEM] %u bytes at 0x%x\n", arena_size, (unsigned int)start);
+}
+
+void* arena_alloc(unsigned int size) {
+    size = align_up(size);
+    if (size > (unsigned int)(pool_top - arena_ptr)) {
+        arena_failures++;
+        LOG(LOG_WARN, "[MEM] arena exhausted (%u bytes requested)\n", size);
+        return 0;
+    }
+    
+    void* p = arena_ptr;
+    arena_ptr += size;
+    if (arena_used() > arena_peak) arena_peak = arena_used();
+    return p;
+}
+
+// Scoped temporaries: everything allocated after a mark goes at release
+void* arena_mark(void) {
+    return arena_ptr;
+}
+
+void arena_release(void* mark) {
+    arena_ptr = mark;
+}
+
+void arena_reset(void) {
+    arena_ptr = arena_base;
+    arena_resets++;
+}
+
+unsigned int arena_used(void) {
+    return arena_ptr - arena_base;
+}
+
+unsigned int arena_available(void) {
+    return pool_top - arena_ptr;
+}
+
+// Reserve a pool and its objects from the top of the region. The arena
+// shrinks by the same amount, so pools are meant to be created at init.
+mem_pool* pool_create(const char* name, unsigned int object_size, unsigned int count) {
+    if (object_size < sizeof(void*)) object_size = sizeof(void*);
+    object_size = align_up(object_size);
+    unsigned int bytes = align_up(sizeof(mem_pool)) + object_size * count;
+    
+    if (mem_pool_count == MEM_MAX_POOLS || bytes > (unsigned int)(pool_top - arena_ptr)) {
+        LOG(LOG_WARN, "[MEM] cannot create pool %s\n", name);
+        return 0;
+    }
+    pool_top -= bytes;
+    arena_size -= bytes;
+    
+    mem_pool* pool = (mem_pool*)pool_top;
+    unsigned char* objects = pool_top + align_up(sizeof(mem_pool));
+    pool->name = name;
+    pool->object_size = object_size;
+    pool->capacity = count;
+    pool->used = 0;
+    pool->peak = 0;
+    pool->failures = 0;
+    pool->free_list = 0;
+    
+    // Thread the free list through the objects, lowest address first
+    for (unsigned int i = count; i > 0; i--) {
+        void** object = (void**)(objects + (i - 1) * object_size);
+        *object = pool->free_list;
+        pool->free_list = object;
+    }
+    
+    mem_pools[mem_pool_count++] = pool;
+    return pool;
+}
+
+void* pool_alloc(mem_pool* pool) {
+    void** object = pool->free_list;
+    if (!object) {
+        pool->failures++;
+        return 0;
+    }
+    pool->free_list = *object;
+    if (++pool->used > pool->peak) pool->peak = pool->used;
+    return object;
+}
+
+void pool_free(mem_pool* pool, void* object) {
+    if (!object) return;
+    *(void**)object = pool->free_list;
+    pool->free_list = object;
+    pool->used--;
+}
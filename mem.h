@@ -0,0 +1,50 @@
+#ifndef MEM_H
+#define MEM_H
+
+// Kernel memory: one region split between a bump arena growing up from
+// the bottom and fixed-size object pools carved from the top. The arena
+// holds temporaries and is reset after every command; pools hold objects
+// that outlive a command. Neither can fragment. Allocation failures
+// return 0.
+
+#define MEM_ALIGN 8
+#define MEM_MAX_POOLS 8
+
+// Storage class of the arena state. Multithreaded host builds (libcalc)
+// define it as __thread so each thread has an arena of its own, set up
+// with mem_init(); the kernel has one thread and one arena.
+#ifndef MEM_LOCAL
+#define MEM_LOCAL
+#endif
+
+typedef struct {
+    const char* name;
+    unsigned int object_size;
+    unsigned int capacity;
+    unsigned int used;
+    unsigned int peak;
+    unsigned int failures;
+    void* free_list;
+} mem_pool;
+
+void mem_init(void* base, unsigned int size);
+
+void* arena_alloc(unsigned int size);
+void* arena_mark(void);
+void arena_release(void* mark);
+void arena_reset(void);
+unsigned int arena_used(void);
+unsigned int arena_available(void);
+
+mem_pool* pool_create(const char* name, unsigned int object_size, unsigned int count);
+void* pool_alloc(mem_pool* pool);
+void pool_free(mem_pool* pool, void* object);
+
+extern MEM_LOCAL unsigned int arena_size;  // bytes between the arena base and the pools
+extern MEM_LOCAL unsigned int arena_peak;  // most bytes in use at once
+extern MEM_LOCAL unsigned int arena_resets;
+extern MEM_LOCAL unsigned int arena_failures;
+extern mem_pool* mem_pools[MEM_MAX_POOLS];
+extern unsigned int mem_pool_count;
+
+#endif
@@ -0,0 +1,332 @@
+// Generated by host/gen_sci.c at build time; do not edit.
+
+#ifndef SCI_TABLE_H
+#define SCI_TABLE_H
+
+#define SCI_SIN_STEPS 64
+#define SCI_ATAN_STEPS 64
+#define SCI_LOG_STEPS 128
+
+static const long double sci_pio2 = 0xc.90fdaa22168c235p-3L;
+static const long double sci_pio32 = 0xc.90fdaa22168c235p-7L;
+static const long double sci_ln2 = 0xb.17217f7d1cf79acp-4L;
+static const long double sci_inv_ln10 = 0xd.e5bd8a937287195p-5L;
+
+// pi/32 as two parts of 40 bits, so k * part is exact for k < 2^24,
+// and the rest to 64 bits
+static const long double sci_pio32_parts[3] = { 0xc.90fdaa221p-7L, 0xd.18469898cp-48L, 0xc.51701b839a25205p-88L };
+
+// Bits of 2/pi from the 1/2 place on, most significant first
+#define SCI_TWO_OVER_PI_WORDS 40
+static const unsigned int sci_two_over_pi[40] = {
+    0xA2F9836E, 0x4E441529, 0xFC2757D1, 0xF534DDC0, 0xDB629599, 0x3C439041,
+    0xFE5163AB, 0xDEBBC561, 0xB7246E3A, 0x424DD2E0, 0x06492EEA, 0x09D1921C,
+    0xFE1DEB1C, 0xB129A73E, 0xE88235F5, 0x2EBB4484, 0xE99C7026, 0xB45F7E41,
+    0x3991D639, 0x835339F4, 0x9C845F8B, 0xBDF9283B, 0x1FF897FF, 0xDE05980F,
+    0xEF2F118B, 0x5A0A6D1F, 0x6D367ECF, 0x27CB09B7, 0x4F463F66, 0x9E5FEA2D,
+    0x7527BAC7, 0xEBE5F17B, 0x3D0739F7, 0x8A5292EA, 0x6BFB5FB1, 0x1F8D5D08,
+    0x56033046, 0xFC7B6BAB, 0xF0CFBC20, 0x9AF4361D,
+};
+
+static const long double sci_sin_table[64] = {
+    0x0p+0L,
+    0xc.8bd35e14da15f0fp-7L,
+    0xc.7c5c1e34d3055b3p-6L,
+    0x9.4a03176acf82d46p-5L,
+    0xc.3ef1535754b168dp-5L,
+    0xf.15ae9c037b1d8fp-5L,
+    0x8.e39d9cd73464365p-4L,
+    0xa.267992848eeb0cp-4L,
+    0xb.504f333f9de6485p-4L,
+    0xc.5e40358a8ba05a8p-4L,
+    0xd.4db3148750d181ap-4L,
+    0xe.1c5978c05ed8692p-4L,
+    0xe.c835e79946a3146p-4L,
+    0xf.4fa0ab6316ed2ecp-4L,
+    0xf.b14be7fbae58156p-4L,
+    0xf.ec46d1e89292cfp-4L,
+    0x8p-3L,
+    0xf.ec46d1e89292cfp-4L,
+    0xf.b14be7fbae58156p-4L,
+    0xf.4fa0ab6316ed2ecp-4L,
+    0xe.c835e79946a3146p-4L,
+    0xe.1c5978c05ed8692p-4L,
+    0xd.4db3148750d181ap-4L,
+    0xc.5e40358a8ba05a8p-4L,
+    0xb.504f333f9de6485p-4L,
+    0xa.267992848eeb0cp-4L,
+    0x8.e39d9cd73464365p-4L,
+    0xf.15ae9c037b1d8fp-5L,
+    0xc.3ef1535754b168dp-5L,
+    0x9.4a03176acf82d46p-5L,
+    0xc.7c5c1e34d3055b3p-6L,
+    0xc.8bd35e14da15f0fp-7L,
+    0x0p+0L,
+    -0xc.8bd35e14da15f0fp-7L,
+    -0xc.7c5c1e34d3055b3p-6L,
+    -0x9.4a03176acf82d46p-5L,
+    -0xc.3ef1535754b168dp-5L,
+    -0xf.15ae9c037b1d8fp-5L,
+    -0x8.e39d9cd73464365p-4L,
+    -0xa.267992848eeb0cp-4L,
+    -0xb.504f333f9de6485p-4L,
+    -0xc.5e40358a8ba05a8p-4L,
+    -0xd.4db3148750d181ap-4L,
+    -0xe.1c5978c05ed8692p-4L,
+    -0xe.c835e79946a3146p-4L,
+    -0xf.4fa0ab6316ed2ecp-4L,
+    -0xf.b14be7fbae58156p-4L,
+    -0xf.ec46d1e89292cfp-4L,
+    -0x8p-3L,
+    -0xf.ec46d1e89292cfp-4L,
+    -0xf.b14be7fbae58156p-4L,
+    -0xf.4fa0ab6316ed2ecp-4L,
+    -0xe.c835e79946a3146p-4L,
+    -0xe.1c5978c05ed8692p-4L,
+    -0xd.4db3148750d181ap-4L,
+    -0xc.5e40358a8ba05a8p-4L,
+    -0xb.504f333f9de6485p-4L,
+    -0xa.267992848eeb0cp-4L,
+    -0x8.e39d9cd73464365p-4L,
+    -0xf.15ae9c037b1d8fp-5L,
+    -0xc.3ef1535754b168dp-5L,
+    -0x9.4a03176acf82d46p-5L,
+    -0xc.7c5c1e34d3055b3p-6L,
+    -0xc.8bd35e14da15f0fp-7L,
+};
+
+static const long double sci_atan_table[65] = {
+    0x0p+0L,
+    0xf.ffaaadddb94d5bcp-10L,
+    0xf.feaaddd4bb12542p-9L,
+    0xb.fdc0c2186d14fcfp-8L,
+    0xf.faaddb967ef4e37p-8L,
+    0x9.facf873e2aceb59p-7L,
+    0xb.f70c13017887461p-7L,
+    0xd.f1cf5f3783e1befp-7L,
+    0xf.eadd4d5617b6e33p-7L,
+    0x8.f0fd7d821b93726p-6L,
+    0x9.eb77746331362c3p-6L,
+    0xa.e4c08f1f6134efbp-6L,
+    0xb.dcbda5e72d81134p-6L,
+    0xc.d35474b643130e8p-6L,
+    0xd.c86ba9493051023p-6L,
+    0xe.bbeaef902b9b38dp-6L,
+    0xf.adbafc96406eb15p-6L,
+    0x8.4ee2cbec31b12c6p-5L,
+    0x8.c5fad185f8bc131p-5L,
+    0x9.3c1b902bf7a2df1p-5L,
+    0x9.b13b9b83f5e5e6ap-5L,
+    0xa.25521b615784d45p-5L,
+    0xa.9856cca8e6a4edbp-5L,
+    0xb.0a420184e7f0cb2p-5L,
+    0xb.7b0ca0f26f78474p-5L,
+    0xb.eab025b1d9fbad4p-5L,
+    0xc.59269ca50d92b6ep-5L,
+    0xc.c66aa2a6b58c33dp-5L,
+    0xd.327761e611fe5b6p-5L,
+    0xd.9d488ed32e3635cp-5L,
+    0xe.06da64a764f7c68p-5L,
+    0xe.6f29a19609a84bap-5L,
+    0xe.d63382b0dda7b45p-5L,
+    0xf.3bf5bf8bad1a21dp-5L,
+    0xf.a06e85aa0a0be5cp-5L,
+    0x8.01ce39e0d205c9ap-4L,
+    0x8.32bf4a6d9867e2ap-4L,
+    0x8.630a2dada1ed066p-4L,
+    0x8.92aecdfde9547b5p-4L,
+    0x8.c1ad445f3e09b8cp-4L,
+    0x8.f005d5ef7f59f9bp-4L,
+    0x9.1db8f1664f350e2p-4L,
+    0x9.4ac72c9847186f6p-4L,
+    0x9.7731420365e538cp-4L,
+    0x9.a2f80e671bdda2p-4L,
+    0x9.ce1c8e6a0b8cdbap-4L,
+    0x9.f89fdc4f4b7a1edp-4L,
+    0xa.22832dbcadaae09p-4L,
+    0xa.4bc7d1934f70924p-4L,
+    0xa.746f2ddb7602294p-4L,
+    0xa.9c7abdc4830f5c9p-4L,
+    0xa.c3ec0fb997dd6a2p-4L,
+    0xa.eac4c38b4d8c08p-4L,
+    0xb.110688aebdc6f6ap-4L,
+    0xb.36b31c91f043691p-4L,
+    0xb.5bcc49059ecc4bp-4L,
+    0xb.8053e2bc2319e74p-4L,
+    0xb.a44bc7dd470782fp-4L,
+    0xb.c7b5deae98af281p-4L,
+    0xb.ea94144fd049aacp-4L,
+    0xc.0ce85b8ac52664p-4L,
+    0xc.2eb4abb661628b6p-4L,
+    0xc.4ffaffabf8fbd54p-4L,
+    0xc.70bd54ce602ee14p-4L,
+    0xc.90fdaa22168c235p-4L,
+};
+
+static const long double sci_log_table[129] = {
+    0x0p+0L,
+    0xf.f015358833c47e2p-11L,
+    0xf.e054587e01f1e7dp-10L,
+    0xb.dc8d83ead88d549p-9L,
+    0xf.c14d873c1980268p-9L,
+    0x9.cf43dcff5eafd48p-8L,
+    0xb.ba2c7b196e7e232p-8L,
+    0xd.a16eb88cb8df614p-8L,
+    0xf.85186008b15330cp-8L,
+    0x8.b29b7751bd70743p-7L,
+    0x9.a0ebcb0de8e8495p-7L,
+    0xa.8d839f830c1fb49p-7L,
+    0xb.78694572b5a5cdfp-7L,
+    0xc.61a2eb18cd907adp-7L,
+    0xd.49369d256ab1b29p-7L,
+    0xe.2f2a47ade3a18afp-7L,
+    0xf.1383b7157972f4fp-7L,
+    0xf.f64898edf55d552p-7L,
+    0x8.6bbf3e68472cb35p-6L,
+    0x8.db956a97b3d0148p-6L,
+    0x9.4aa97c0ffa91a6p-6L,
+    0x9.b8fe100f47ba1dfp-6L,
+    0xa.2695b665be8f33fp-6L,
+    0xa.9372f1d0da1bd17p-6L,
+    0xa.ff983853c9e9e44p-6L,
+    0xb.6b07f38ce90e46bp-6L,
+    0xb.d5c481086c848dfp-6L,
+    0xc.3fd032906488481p-6L,
+    0xc.a92d4e7a2b5a3b2p-6L,
+    0xd.11de0ff15ab18cap-6L,
+    0xd.79e4a7405ff96c7p-6L,
+    0xd.e1433a16c66b15p-6L,
+    0xe.47fbe3cd4d10d61p-6L,
+    0xe.ae10b5a7ddc8addp-6L,
+    0xf.1383b7157972f5p-6L,
+    0xf.7856e5ee2c9b291p-6L,
+    0xf.dc8c36af1f1546bp-6L,
+    0x8.2012ca5a68206d7p-5L,
+    0x8.51927139c871afcp-5L,
+    0x8.82c5fcd7256a8c5p-5L,
+    0x8.b3ae55d5d30701dp-5L,
+    0x8.e44c60b4ccfd7dep-5L,
+    0x9.14a0fde7bcb2d12p-5L,
+    0x9.44ad09ef4351af6p-5L,
+    0x9.74715d708e984e2p-5L,
+    0x9.a3eecd4c3eaa6b2p-5L,
+    0x9.d3262ab4a2f4e3ap-5L,
+    0xa.0218434353f1de9p-5L,
+    0xa.30c5e10e2f613e8p-5L,
+    0xa.5f2fcabbbc506dbp-5L,
+    0xa.8d56c396fc1684ep-5L,
+    0xa.bb3b8ba2ad362a5p-5L,
+    0xa.e8dedfac04e5285p-5L,
+    0xb.1641795ce3ca97cp-5L,
+    0xb.43640f4d8a57622p-5L,
+    0xb.70475515d0f1c61p-5L,
+    0xb.9cebfb5de8034e7p-5L,
+    0xb.c952afeea3d13e1p-5L,
+    0xb.f57c1dc157e1b26p-5L,
+    0xc.2168ed0f458ba4ap-5L,
+    0xc.4d19c360a12d5adp-5L,
+    0xc.788f439b3163bf1p-5L,
+    0xc.a3ca0e108b7d5d3p-5L,
+    0xc.cecac08bf04565ep-5L,
+    0xc.f991f65fcc25f96p-5L,
+    0xd.24204872dd8516p-5L,
+    0xd.4e764d4d0424c6ap-5L,
+    0xd.78949923bc3588ap-5L,
+    0xd.a27bbde647b1466p-5L,
+    0xd.cc2c4b49887dacdp-5L,
+    0xd.f5a6ced38dbdfbcp-5L,
+    0xe.1eebd3e6d6a6b9ep-5L,
+    0xe.47fbe3cd4d10d61p-5L,
+    0xe.70d785c2f9f5bdcp-5L,
+    0xe.997f3f0075eab0fp-5L,
+    0xe.c1f392c5179f283p-5L,
+    0xe.ea350260e2505f7p-5L,
+    0xf.12440d3e36130e6p-5L,
+    0xf.3a2130eb43c3f1cp-5L,
+    0xf.61cce92346600bbp-5L,
+    0xf.8947afd7837659bp-5L,
+    0xf.b091fd38145630ap-5L,
+    0xf.d7ac47bc798f6cep-5L,
+    0xf.fe97042bfa4c2adp-5L,
+    0x8.12a952d2e87f635p-4L,
+    0x8.25efced4936933p-4L,
+    0x8.391f2e0e6fa0273p-4L,
+    0x8.4c37a7ab9a905c9p-4L,
+    0x8.5f39721295415b5p-4L,
+    0x8.7224c2e8e645fb7p-4L,
+    0x8.84f9cf16a64b7efp-4L,
+    0x8.97b8cac9f7de298p-4L,
+    0x8.aa61e97a6af4d4dp-4L,
+    0x8.bcf55dec4cd05fep-4L,
+    0x8.cf735a33e4b7663p-4L,
+    0x8.e1dc0fb89e125e5p-4L,
+    0x8.f42faf3820681fp-4L,
+    0x9.066e68c955b6c9bp-4L,
+    0x9.18986bdf5fa1417p-4L,
+    0x9.2aade74c7be59ep-4L,
+    0x9.3caf0944d88d75cp-4L,
+    0x9.4e9bff615845643p-4L,
+    0x9.6074f6a24745dccp-4L,
+    0x9.723a1b720134203p-4L,
+    0x9.83eb99a7885f0fep-4L,
+    0x9.95899c890eb899p-4L,
+    0x9.a7144ece70e98b7p-4L,
+    0x9.b88bdaa3a3dae2fp-4L,
+    0x9.c9f069ab150cd4ep-4L,
+    0x9.db4224fffe1157dp-4L,
+    0x9.ec813538ab7d52p-4L,
+    0x9.fdadc268b7a12dbp-4L,
+    0xa.0ec7f4233957323p-4L,
+    0xa.1fcff17ce733bd4p-4L,
+    0xa.30c5e10e2f613e8p-4L,
+    0xa.41a9e8f5446fb9fp-4L,
+    0xa.527c2ed81f5d811p-4L,
+    0xa.633cd7e6771cd8bp-4L,
+    0xa.73ec08dbadd84e6p-4L,
+    0xa.8489e600b435a5fp-4L,
+    0xa.9516932de2d5774p-4L,
+    0xa.a59233ccca4bd49p-4L,
+    0xa.b5fcead9f9cca09p-4L,
+    0xa.c656dae6bcc4985p-4L,
+    0xa.d6a0261acf967d9p-4L,
+    0xa.e6d8ee360bb2468p-4L,
+    0xa.f70154920b3ab87p-4L,
+    0xb.07197a23c46c654p-4L,
+    0xb.17217f7d1cf79acp-4L,
+};
+
+// P(t), t = r^2 <= (pi/64)^2, max error 4.066e-20
+static const long double sci_sin_poly[4] = {
+    -0xa.aaaaaaaaaaaaaa9p-6L,
+    0x8.888888888869ffdp-10L,
+    -0xd.00d00cc9ba5c254p-16L,
+    0xb.8ecfb4575574be9p-22L,
+};
+
+// Q(t), t = r^2 <= (pi/64)^2, max error 9.250e-19
+static const long double sci_cos_poly[4] = {
+    0xa.aaaaaaaaaaaaaacp-8L,
+    -0xb.60b60b60b7b174cp-13L,
+    0xd.00d088512d93bfap-19L,
+    -0x9.ec5a246e2adcbe1p-25L,
+};
+
+// A(t), t = u^2 <= (1/128)^2, max error 8.132e-20
+static const long double sci_atan_poly[4] = {
+    -0xa.aaaaaaaaaaaaaa9p-5L,
+    0xc.cccccccccc5834fp-6L,
+    -0x9.249248aa3d2c13ep-6L,
+    0xe.3885b0fb1de4398p-7L,
+};
+
+// L(r), |r| <= 1/256, max error 1.317e-17
+static const long double sci_log_poly[6] = {
+    0xa.aaaaaaaaaaaac9p-5L,
+    -0x8.0000000000009a7p-5L,
+    0xc.ccccccc8a333c8bp-6L,
+    -0xa.aaaaaaa29c89b8ep-6L,
+    0x9.249d2a926b6f107p-6L,
+    -0x8.000d665566c5ec3p-6L,
+};
+
+#endif
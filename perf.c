@@ -0,0 +1,163 @@
+// Cycle counter and timing for Calculator OS
+// TSC profiling: calibration, per-command probe totals and recent stats
+
+#include "perf.h"
+#include "io.h"
+#include "log.h"
+#include "serial.h"
+
+#define PIT_CH2 0x42
+#define PIT_CMD 0x43
+#define PIT_GATE 0x61
+#define PIT_HZ 1193182
+#define CALIBRATE_MS 10
+
+const char* const perf_names[PERF_PROBES] = {
+    "total", "parse", "eval", "format", "scroll", "present"
+};
+
+unsigned int perf_tsc_khz = 0;
+unsigned int perf_commands = 0;
+
+static perf_t boot_tsc = 0;
+static perf_t command_start = 0;
+static perf_t current[PERF_PROBES];
+static perf_t window[PERF_WINDOW][PERF_PROBES];
+
+// Count TSC ticks across a 10 ms one-shot on PIT channel 2. The gate
+// wait is bounded so a missing PIT leaves the rate unknown, not a hang.
+void perf_init(void) {
+    unsigned int latch = PIT_HZ / (1000 / CALIBRATE_MS);
+    
+    outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01);  // gate on, speaker off
+    outb(PIT_CMD, 0xB0);                              // ch2, lo/hi, mode 0
+    outb(PIT_CH2, latch & 0xFF);
+    outb(PIT_CH2, latch >> 8);
+    
+    perf_t start = perf_now();
+    for (unsigned int i = 0; i < (1u << 24); i++) {
+        if (inb(PIT_GATE) & 0x20) {
+            perf_tsc_khz = div_u64(perf_now() - start, CALIBRATE_MS, 0);
+            break;
+        }
+    }
+    boot_tsc = start;
+}
+
+void perf_add(int probe, perf_t cycles) {
+    current[probe] += cycles;
+}
+
+void perf_command_begin(void) {
+    for (int i = 0; i < PERF_PROBES; i++) current[i] = 0;
+    command_start = perf_now();
+}
+
+static int append(char* buf, int len, const char* s) {
+    while (*s) buf[len++] = *s++;
+    return len;
+}
+
+// One "name=value" pair per probe for the given samples
+static int format_probes(char* buf, const perf_t* samples) {
+    int len = 0;
+    for (int i = 0; i < PERF_PROBES; i++) {
+        if (i) buf[len++] = ' ';
+        len = append(buf, len, perf_names[i]);
+        buf[len++] = '=';
+        len += perf_format(buf + len, samples[i]);
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+void perf_command_end(void) {
+    current[PERF_TOTAL] = perf_now() - command_start;
+    
+    perf_t* slot = window[perf_commands % PERF_WINDOW];
+    for (int i = 0; i < PERF_PROBES; i++) slot[i] = current[i];
+    perf_commands++;
+    
+    if (LOG_INFO <= LOG_LEVEL) {
+        char line[160];
+        format_probes(line, current);
+        LOG(LOG_INFO, "[PERF] %s\n", line);
+    }
+}
+
+// Stats over the commands still in the window; returns how many there are
+int perf_stats(int probe, perf_t* last, perf_t* min, perf_t* avg, perf_t* max) {
+    int count = perf_commands < PERF_WINDOW ? perf_commands : PERF_WINDOW;
+    perf_t sum = 0, lo = ~0ULL, hi = 0;
+    
+    for (int i = 0; i < count; i++) {
+        perf_t v = window[i][probe];
+        sum += v;
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    *last = count ? window[(perf_commands - 1) % PERF_WINDOW][probe] : 0;
+    *min = count ? lo : 0;
+    *avg = count ? div_u64(sum, count, 0) : 0;
+    *max = hi;
+    return count;
+}
+
+int perf_format(char* buf, perf_t value) {
+    char digits[20];
+    int n = 0, len = 0;
+    do {
+        unsigned int digit;
+        value = div_u64(value, 10, &digit);
+        digits[n++] = '0' + digit;
+    } while (value);
+    while (n > 0) buf[len++] = digits[--n];
+    return len;
+}
+
+// Seconds since calibration as "s.uuuuuu", or raw cycles if uncalibrated
+int perf_format_time(char* buf) {
+    perf_t elapsed = perf_now() - boot_tsc;
+    if (perf_tsc_khz == 0) return perf_format(buf, elapsed);
+    
+    unsigned int usec;
+    perf_t sec = div_u64(div_u64(elapsed * 1000, perf_tsc_khz, 0), 1000000, &usec);
+    int len = perf_format(buf, sec);
+    buf[len++] = '.';
+    for (int i = 5; i >= 0; i--, usec /= 10) buf[len + i] = '0' + usec % 10;
+    return len + 6;
+}
+
+// Machine-readable dump: one "key=value" line per probe
+void perf_dump_serial(void) {
+    char line[160];
+    int len;
+    
+    len = append(line, 0, "[PERF] tsc_khz=");
+    len += perf_format(line + len, perf_tsc_khz);
+    len = append(line, len, " commands=");
+    len += perf_format(line + len, perf_commands);
+    len = append(line, len, " window=");
+    len += perf_format(line + len, PERF_WINDOW);
+    line[len] = '\0';
+    serial_puts(line);
+    serial_puts("\n");
+    
+    for (int i = 0; i < PERF_PROBES; i++) {
+        perf_t v[4];
+        int count = perf_stats(i, &v[0], &v[1], &v[2], &v[3]);
+        static const char* const keys[4] = { " last=", " min=", " avg=", " max=" };
+        
+        len = append(line, 0, "[PERF] probe=");
+        len = append(line, len, perf_names[i]);
+        len = append(line, len, " n=");
+        len += perf_format(line + len, count);
+        for (int k = 0; k < 4; k++) {
+            len = append(line, len, keys[k]);
+            len += perf_format(line + len, v[k]);
+        }
+        line[len] = '\0';
+        serial_puts(line);
+        serial_puts("\n");
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef PERF_H
+#define PERF_H
+
+// Cycle counting with the TSC. Probes add cycles to the command being
+// timed; the last PERF_WINDOW commands are kept for min/avg/max. Probe
+// times are inclusive: scrolling done while printing a result counts
+// towards both "format" and "scroll".
+
+enum perf_probe {
+    PERF_TOTAL,    // Enter pressed until the screen is presented
+    PERF_PARSE,    // math_compile()
+    PERF_EVAL,     // math_run()
+    PERF_FORMAT,   // print_number()
+    PERF_SCROLL,   // redraw_content()
+    PERF_PRESENT,  // vga_present()
+    PERF_PROBES
+};
+
+#define PERF_WINDOW 32
+
+typedef unsigned long long perf_t;
+
+// Host library builds (libcalc) define PERF_NONE: there is no profiler to
+// feed, and a TSC read is not free, so the probes compile to nothing
+#ifdef PERF_NONE
+static inline perf_t perf_now(void) {
+    return 0;
+}
+
+static inline void perf_add(int probe, perf_t cycles) {
+    (void)probe;
+    (void)cycles;
+}
+#else
+static inline perf_t perf_now(void) {
+    unsigned int lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((perf_t)hi << 32) | lo;
+}
+
+void perf_add(int probe, perf_t cycles);
+#endif
+
+void perf_init(void);
+void perf_command_begin(void);
+void perf_command_end(void);
+
+int perf_stats(int probe, perf_t* last, perf_t* min, perf_t* avg, perf_t* max);
+int perf_format(char* buf, perf_t value);
+int perf_format_time(char* buf);
+void perf_dump_serial(void);
+
+extern const char* const perf_names[PERF_PROBES];
+extern unsigned int perf_tsc_khz;      // 0 if calibration failed
+extern unsigned int perf_commands;
+
+#endif
@@ -0,0 +1,350 @@
+// Plot module for Calculator OS
+// plot f(x), a, b: graphs a function in text mode with half-block pixels
+
+#include "plot.h"
+#include "fmt.h"
+#include "log.h"
+#include "math.h"
+#include "mem.h"
+#include "perf.h"
+#include "vga.h"
+
+#define ROWS (PLOT_HEIGHT / 2)   // screen rows below the status row
+
+// Pixel colors; only the curve is bright, so any two fit in one cell
+#define COLOR_BACK 0
+#define COLOR_AXIS 7
+#define COLOR_CURVE 14
+#define STATUS_COLOR 0x70
+
+#define HALF_UPPER 0xDF
+#define HALF_LOWER 0xDC
+#define FULL_BLOCK 0xDB
+
+// Steep columns get this many extra samples
+#define REFINE 15
+
+// Columns panned per arrow key
+#define PAN_COLUMNS 10
+
+const char* plot_error = 0;
+
+static math_program prog;
+static char title[32];
+static double x_min, x_max, y_min, y_max;
+
+// Per column: the range of f across it, from both edges, the midpoint and,
+// where the curve is steep, REFINE more samples. lo > hi: nothing to draw.
+static double column_lo[PLOT_WIDTH];
+static double column_hi[PLOT_WIDTH];
+
+// Cells last written to the screen, status row first
+static unsigned short frame[ROWS + 1][VGA_WIDTH];
+
+static int is_finite(double v) {
+    return v == v && v - v == 0;
+}
+
+static void widen(int column, double v) {
+    if (!is_finite(v)) return;
+    if (v < column_lo[column]) column_lo[column] = v;
+    if (v > column_hi[column]) column_hi[column] = v;
+}
+
+// Evaluate columns [first, first + count) in two batches: edges and
+// midpoints for all of them, then extra samples inside the steep ones
+static void evaluate_columns(int first, int count) {
+    perf_t start = perf_now();
+    void* mark = arena_mark();
+    int edges = count + 1;
+    double dx = (x_max - x_min) / PLOT_WIDTH;
+    double pixel = (y_max - y_min) / PLOT_HEIGHT;
+    double* x = arena_alloc((edges + count + count * REFINE) * sizeof(double));
+    double* y = arena_alloc((edges + count + count * REFINE) * sizeof(double));
+    if (!x || !y) {
+        arena_release(mark);
+        return;
+    }
+
+    for (int i = 0; i < edges; i++) x[i] = x_min + (first + i) * dx;
+    for (int i = 0; i < count; i++) x[edges + i] = x_min + (first + i + 0.5) * dx;
+    math_run_array(&prog, x, y, edges + count);
+
+    // A column is steep if its samples span more than a pixel
+    int steep[PLOT_WIDTH];
+    int steep_count = 0;
+    for (int i = 0; i < count; i++) {
+        int c = first + i;
+        column_lo[c] = 1e308;
+        column_hi[c] = -1e308;
+        widen(c, y[i]);
+        widen(c, y[i + 1]);
+        widen(c, y[edges + i]);
+        if (!(column_hi[c] - column_lo[c] <= pixel)) steep[steep_count++] = c;
+    }
+
+    if (steep_count > 0) {
+        double* rx = x + edges + count;
+        double* ry = y + edges + count;
+        for (int k = 0; k < steep_count; k++) {
+            for (int j = 0; j < REFINE; j++) {
+                rx[k * REFINE + j] = x_min + (steep[k] + (j + 1.0) / (REFINE + 1)) * dx;
+            }
+        }
+        math_run_array(&prog, rx, ry, steep_count * REFINE);
+        for (int k = 0; k < steep_count * REFINE; k++) widen(steep[k / REFINE], ry[k]);
+    }
+    arena_release(mark);
+    perf_add(PERF_EVAL, perf_now() - start);
+    LOG(LOG_DEBUG, "[PLOT] %d columns, %d steep, %d evaluations\n",
+        count, steep_count, edges + count + steep_count * REFINE);
+}
+
+// Sideways pans shift the columns already known and evaluate the rest
+static void pan_columns(int shift) {
+    double dx = (x_max - x_min) / PLOT_WIDTH;
+    x_min += shift * dx;
+    x_max += shift * dx;
+    if (shift > 0) {
+        for (int c = 0; c + shift < PLOT_WIDTH; c++) {
+            column_lo[c] = column_lo[c + shift];
+            column_hi[c] = column_hi[c + shift];
+        }
+        evaluate_columns(PLOT_WIDTH - shift, shift);
+    } else {
+        for (int c = PLOT_WIDTH - 1; c + shift >= 0; c--) {
+            column_lo[c] = column_lo[c + shift];
+            column_hi[c] = column_hi[c + shift];
+        }
+        evaluate_columns(0, -shift);
+    }
+}
+
+// Fit y to the samples. A few huge values near a pole would flatten the
+// rest of the curve, so those are left off-screen.
+static void autoscale(void) {
+    double values[PLOT_WIDTH];
+    int n = 0;
+    for (int c = 0; c < PLOT_WIDTH; c++) {
+        if (column_lo[c] > column_hi[c]) continue;
+        double v = (column_lo[c] + column_hi[c]) / 2;
+        int i = n++;
+        while (i > 0 && values[i - 1] > v) {
+            values[i] = values[i - 1];
+            i--;
+        }
+        values[i] = v;
+    }
+    if (n == 0) {
+        y_min = -1;
+        y_max = 1;
+        return;
+    }
+
+    double low = values[0], high = values[n - 1];
+    double p5 = values[n / 20], p95 = values[n - 1 - n / 20];
+    if (high - p95 > 10 * (p95 - p5)) high = p95;
+    if (p5 - low > 10 * (p95 - p5)) low = p5;
+    if (high - low < 1e-12) {
+        low -= 1;
+        high += 1;
+    }
+    double margin = (high - low) / 10;
+    y_min = low - margin;
+    y_max = high + margin;
+}
+
+// Pixel row of y (0 at the top), clamped just outside the canvas
+static int pixel_row(double v) {
+    double r = (y_max - v) / (y_max - y_min) * PLOT_HEIGHT;
+    if (r < -1) return -1;
+    if (r > PLOT_HEIGHT) return PLOT_HEIGHT;
+    return (int)r;
+}
+
+static void put_text(unsigned short* row, int* x, const char* s) {
+    while (*s && *x < VGA_WIDTH) row[(*x)++] = VGA_CELL(*s++, STATUS_COLOR);
+}
+
+static void put_number(unsigned short* row, int* x, double v) {
+    char buf[FMT_MAX];
+    fmt_double(buf, v, FMT_GENERAL, 5);
+    put_text(row, x, buf);
+}
+
+// One cell from a top and a bottom pixel. The bright curve color can only
+// be a foreground, so the half block is picked to make it one.
+static unsigned short pixel_cell(int top, int bottom) {
+    if (top == bottom) {
+        return top == COLOR_BACK ? VGA_CELL(' ', COLOR_BACK) : VGA_CELL(FULL_BLOCK, top);
+    }
+    if (bottom < 8) return VGA_CELL(HALF_UPPER, top | bottom << 4);
+    return VGA_CELL(HALF_LOWER, bottom | top << 4);
+}
+
+// Rasterize and write the cells that differ from the last frame
+static void draw(void) {
+    perf_t start = perf_now();
+    static unsigned char pixels[PLOT_HEIGHT][PLOT_WIDTH];
+    unsigned short next[VGA_WIDTH];
+
+    for (int r = 0; r < PLOT_HEIGHT; r++) {
+        for (int c = 0; c < PLOT_WIDTH; c++) pixels[r][c] = COLOR_BACK;
+    }
+    int axis = pixel_row(0);
+    if (axis >= 0 && axis < PLOT_HEIGHT) {
+        for (int c = 0; c < PLOT_WIDTH; c++) pixels[axis][c] = COLOR_AXIS;
+    }
+    if (x_min <= 0 && x_max > 0) {
+        int c = (int)(-x_min / (x_max - x_min) * PLOT_WIDTH);
+        for (int r = 0; r < PLOT_HEIGHT; r++) pixels[r][c] = COLOR_AXIS;
+    }
+    for (int c = 0; c < PLOT_WIDTH; c++) {
+        if (column_lo[c] > column_hi[c]) continue;
+        int top = pixel_row(column_hi[c]);
+        int bottom = pixel_row(column_lo[c]);
+        if (top >= PLOT_HEIGHT || bottom < 0) continue;
+        if (top < 0) top = 0;
+        if (bottom >= PLOT_HEIGHT) bottom = PLOT_HEIGHT - 1;
+        for (int r = top; r <= bottom; r++) pixels[r][c] = COLOR_CURVE;
+    }
+
+    // Status row: what is plotted, the visible ranges, the keys
+    int x = 0;
+    for (int i = 0; i < VGA_WIDTH; i++) next[i] = VGA_CELL(' ', STATUS_COLOR);
+    put_text(next, &x, " y=");
+    put_text(next, &x, title);
+    put_text(next, &x, "  x ");
+    put_number(next, &x, x_min);
+    put_text(next, &x, "..");
+    put_number(next, &x, x_max);
+    put_text(next, &x, "  y ");
+    put_number(next, &x, y_min);
+    put_text(next, &x, "..");
+    put_number(next, &x, y_max);
+    x = VGA_WIDTH - 29;
+    put_text(next, &x, "arrows pan  +/- zoom  ESC  ");
+
+    int written = 0;
+    for (int y = 0; y <= ROWS; y++) {
+        if (y > 0) {
+            for (int c = 0; c < VGA_WIDTH; c++) {
+                next[c] = pixel_cell(pixels[2 * y - 2][c], pixels[2 * y - 1][c]);
+            }
+        }
+        unsigned short* row = vga_row(y);
+        for (int c = 0; c < VGA_WIDTH; c++) {
+            if (frame[y][c] != next[c]) {
+                frame[y][c] = row[c] = next[c];
+                written++;
+            }
+        }
+    }
+    perf_add(PERF_FORMAT, perf_now() - start);
+    LOG(LOG_DEBUG, "[PLOT] %d cells rewritten\n", written);
+}
+
+// Zoom by factor around the center, refitting nothing but the ranges
+static void zoom(double factor) {
+    double cx = (x_min + x_max) / 2, hx = (x_max - x_min) / 2 * factor;
+    double cy = (y_min + y_max) / 2, hy = (y_max - y_min) / 2 * factor;
+    if (hx < 1e-12 || hx > 1e12 || hy < 1e-300 || hy > 1e300) return;
+    x_min = cx - hx;
+    x_max = cx + hx;
+    y_min = cy - hy;
+    y_max = cy + hy;
+    evaluate_columns(0, PLOT_WIDTH);
+}
+
+// Split "f(x), a, b" at its last two top-level commas
+int plot_open(const char* args, int len) {
+    int commas[2] = {-1, -1};
+    int depth = 0;
+    for (int i = 0; i < len; i++) {
+        if (args[i] == '(') depth++;
+        if (args[i] == ')') depth--;
+        if (args[i] == ',' && depth == 0) {
+            commas[0] = commas[1];
+            commas[1] = i;
+        }
+    }
+
+    int expr_len = len;
+    x_min = -10;
+    x_max = 10;
+    if (commas[0] >= 0) {
+        expr_len = commas[0];
+        x_min = evaluate(args + commas[0] + 1, commas[1] - commas[0] - 1);
+        x_max = evaluate(args + commas[1] + 1, len - commas[1] - 1);
+    } else if (commas[1] >= 0) {
+        plot_error = "use plot f(x), a, b";
+        return 0;
+    }
+    if (!(x_max > x_min) || !is_finite(x_max - x_min)) {
+        plot_error = "empty range";
+        return 0;
+    }
+    if (math_compile_fn(args, expr_len, "x", &prog) != 0) {
+        plot_error = "cannot compile f(x)";
+        return 0;
+    }
+
+    int n = 0;
+    while (n < expr_len && args[n] == ' ') { args++; expr_len--; }
+    while (n < expr_len && n < (int)sizeof(title) - 1) {
+        title[n] = args[n];
+        n++;
+    }
+    title[n] = '\0';
+
+    // Sample once to fit y, then again at the resolution of that fit
+    y_min = -1;
+    y_max = 1;
+    evaluate_columns(0, PLOT_WIDTH);
+    autoscale();
+    evaluate_columns(0, PLOT_WIDTH);
+    return 1;
+}
+
+void plot_show(void) {
+    for (int y = 0; y <= ROWS; y++) {
+        for (int c = 0; c < VGA_WIDTH; c++) frame[y][c] = 0;
+    }
+    vga_set_cursor(-1);
+    draw();
+}
+
+int plot_key(int key) {
+    double dy = (y_max - y_min) / 8;
+
+    switch (key) {
+    case 27:
+    case 'q':
+        return 0;
+    case PLOT_KEY_LEFT:
+        pan_columns(-PAN_COLUMNS);
+        break;
+    case PLOT_KEY_RIGHT:
+        pan_columns(PAN_COLUMNS);
+        break;
+    case PLOT_KEY_UP:
+        y_min += dy;
+        y_max += dy;
+        break;
+    case PLOT_KEY_DOWN:
+        y_min -= dy;
+        y_max -= dy;
+        break;
+    case '+':
+    case '=':
+        zoom(0.5);
+        break;
+    case '-':
+        zoom(2);
+        break;
+    default:
+        return 1;
+    }
+    draw();
+    return 1;
+}
@@ -0,0 +1,31 @@
+#ifndef PLOT_H
+#define PLOT_H
+
+// Function plotter. Takes over the whole text screen: a status row, then
+// half-block characters for two pixels per cell, 80 x 48 in all. Samples
+// are kept per column so panning sideways only evaluates the columns that
+// scroll into view, and only cells that changed are rewritten.
+
+#define PLOT_WIDTH 80
+#define PLOT_HEIGHT 48
+
+// Keys plot_key() understands besides + - ESC
+#define PLOT_KEY_UP 131
+#define PLOT_KEY_DOWN 132
+#define PLOT_KEY_LEFT 133
+#define PLOT_KEY_RIGHT 134
+
+// Open a plot from "f(x), a, b" (the range defaults to -10, 10). Returns
+// 0 with plot_error set if the arguments are unusable.
+int plot_open(const char* args, int len);
+
+// Draw the whole plot over the screen, once the caller is done with it
+void plot_show(void);
+
+// Handle a key while the plot is open; returns 0 once it has closed and
+// the screen belongs to the caller again
+int plot_key(int key);
+
+extern const char* plot_error;
+
+#endif
@@ -0,0 +1,322 @@
+// Scan module for Calculator OS
+// Correctly rounded number literals: decimal (Eisel-Lemire) and 0x/0b/0o
+
+#include "scan.h"
+#include "scan_table.h"
+
+typedef unsigned long long u64;
+
+#define MANTISSA_BITS 52
+#define EXPONENT_BIAS 1023
+#define INFINITY_BITS 0x7FF0000000000000ULL
+
+// Significant digits that fit in a u64, and the most the slow path
+// reads exactly (later digits only count as nonzero or not)
+#define FAST_DIGITS 19
+#define MAX_DIGITS 768
+
+// Exponents are clamped here; anything near it is 0 or infinity anyway
+#define MAX_EXPONENT 100000
+
+// Room for 768 digits brought to the size of a double by powers of 2 and 5
+#define WIDE_WORDS 128
+
+static double from_bits(u64 bits) {
+    union {
+        u64 bits;
+        double d;
+    } u = { bits };
+    return u.d;
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Value of c as a digit in base, -1 if it is not one
+static int digit_value(char c, int base) {
+    int d = 99;
+    if (c >= '0' && c <= '9') d = c - '0';
+    else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+    return d < base ? d : -1;
+}
+
+// High 64 bits of a * b, low 64 in *low, from 32-bit partial products
+static u64 mul_high(u64 a, u64 b, u64* low) {
+    unsigned int a0 = (unsigned int)a, a1 = a >> 32;
+    unsigned int b0 = (unsigned int)b, b1 = b >> 32;
+    u64 p00 = (u64)a0 * b0, p01 = (u64)a0 * b1;
+    u64 p10 = (u64)a1 * b0, p11 = (u64)a1 * b1;
+    u64 mid = (p00 >> 32) + (unsigned int)p01 + (unsigned int)p10;
+    *low = (mid << 32) | (unsigned int)p00;
+    return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+
+// m * 2^e2, with anything nonzero below m flagged by sticky, rounded to
+// double bits. For integer literals, so never subnormal.
+static u64 round_bits(u64 m, int e2, int sticky) {
+    if (m == 0) return 0;
+    int lz = __builtin_clzll(m);
+    m <<= lz;
+    e2 -= lz;
+
+    unsigned int rest = m & 0x7FF;
+    m >>= 11;
+    e2 += 11;
+    if (rest > 0x400 || (rest == 0x400 && (sticky || (m & 1)))) m++;
+    if (m >> (MANTISSA_BITS + 1)) {
+        m >>= 1;
+        e2++;
+    }
+    int biased = e2 + MANTISSA_BITS + EXPONENT_BIAS;
+    if (biased >= 0x7FF) return INFINITY_BITS;
+    return (m & ((1ULL << MANTISSA_BITS) - 1)) | ((u64)biased << MANTISSA_BITS);
+}
+
+// Eisel-Lemire: w * 10^q as double bits, for w != 0 and q in the table's
+// range. One 64 x 128-bit product is always enough when w is exact.
+static u64 eisel_lemire(u64 w, int q) {
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    const u64* pow5 = scan_pow5[q - SCAN_MIN_POW10];
+    u64 low, high = mul_high(w, pow5[1], &low);
+    if ((high & 0x1FF) == 0x1FF) {  // the low table word may still carry in
+        u64 low2, high2 = mul_high(w, pow5[0], &low2);
+        low += high2;
+        if (high2 > low) high++;
+    }
+
+    int upper = (int)(high >> 63);
+    int shift = upper + 64 - MANTISSA_BITS - 3;
+    u64 mantissa = high >> shift;
+    int power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - lz + EXPONENT_BIAS;
+
+    if (power2 <= 0) {  // subnormal; a carry into the exponent sets it
+        if (-power2 + 1 >= 64) return 0;
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        return mantissa >> 1;
+    }
+    // Only small q can land exactly halfway; those round to even
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high) {
+        mantissa &= ~1ULL;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ULL << MANTISSA_BITS)) {
+        mantissa = 1ULL << MANTISSA_BITS;
+        power2++;
+    }
+    if (power2 >= 0x7FF) return INFINITY_BITS;
+    return (mantissa & ~(1ULL << MANTISSA_BITS)) | ((u64)power2 << MANTISSA_BITS);
+}
+
+// ---- Slow path: exact comparison against halfway points ----
+
+typedef struct {
+    unsigned int word[WIDE_WORDS];
+    int len;
+} wide;
+
+static void wide_mul_add(wide* x, unsigned int m, unsigned int add) {
+    u64 carry = add;
+    for (int i = 0; i < x->len; i++) {
+        u64 t = (u64)x->word[i] * m + carry;
+        x->word[i] = (unsigned int)t;
+        carry = t >> 32;
+    }
+    if (carry && x->len < WIDE_WORDS) x->word[x->len++] = (unsigned int)carry;
+}
+
+static void wide_mul_pow5(wide* x, int k) {
+    for (; k >= 13; k -= 13) wide_mul_add(x, 1220703125u, 0);
+    unsigned int m = 1;
+    while (k-- > 0) m *= 5;
+    wide_mul_add(x, m, 0);
+}
+
+static void wide_shift_left(wide* x, int bits) {
+    int words = bits / 32, s = bits % 32;
+    if (x->len == 0) return;
+    if (x->len + words + 1 > WIDE_WORDS) words = WIDE_WORDS - x->len - 1;
+    x->word[x->len] = 0;
+    for (int i = x->len; i >= 0; i--) {
+        unsigned int w = x->word[i] << s;
+        if (s && i > 0) w |= x->word[i - 1] >> (32 - s);
+        x->word[i + words] = w;
+    }
+    for (int i = 0; i < words; i++) x->word[i] = 0;
+    x->len += words + 1;
+    while (x->len > 0 && x->word[x->len - 1] == 0) x->len--;
+}
+
+static int wide_cmp(const wide* a, const wide* b) {
+    if (a->len != b->len) return a->len < b->len ? -1 : 1;
+    for (int i = a->len - 1; i >= 0; i--) {
+        if (a->word[i] != b->word[i]) return a->word[i] < b->word[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// Sign of digits * 10^k - (the point halfway between bits and bits + 1).
+// sticky means digits are followed by more nonzero ones.
+static int cmp_halfway(const wide* digits, int k, int sticky, u64 bits) {
+    int biased = (int)(bits >> MANTISSA_BITS);
+    u64 m = bits & ((1ULL << MANTISSA_BITS) - 1);
+    int e2 = 1 - EXPONENT_BIAS - MANTISSA_BITS;
+    if (biased) {
+        m |= 1ULL << MANTISSA_BITS;
+        e2 = biased - EXPONENT_BIAS - MANTISSA_BITS;
+    }
+
+    // digits * 5^k * 2^k against (2m + 1) * 2^(e2 - 1), 5^k moved to
+    // whichever side keeps it whole, then the smaller power of 2
+    wide left = *digits, right;
+    m = 2 * m + 1;
+    right.word[0] = (unsigned int)m;
+    right.word[1] = (unsigned int)(m >> 32);
+    right.len = right.word[1] ? 2 : 1;
+    if (k >= 0) wide_mul_pow5(&left, k);
+    else wide_mul_pow5(&right, -k);
+    int diff = k - (e2 - 1);
+    if (diff >= 0) wide_shift_left(&left, diff);
+    else wide_shift_left(&right, -diff);
+
+    int c = wide_cmp(&left, &right);
+    return c == 0 && sticky ? 1 : c;
+}
+
+// Correctly rounded value of the significant digits in s..end (a '.'
+// may sit among them) times 10^k, starting from a guess within an ulp
+static u64 slow_path(const char* s, const char* end, int k, u64 guess) {
+    wide digits;
+    digits.len = 0;
+    int count = 0, sticky = 0;
+    unsigned int chunk = 0, scale = 1;
+    for (const char* p = s; p < end; p++) {
+        if (!is_digit(*p)) continue;
+        if (count == 0 && *p == '0') continue;
+        if (count == MAX_DIGITS) {
+            sticky |= *p != '0';
+            continue;
+        }
+        chunk = chunk * 10 + (*p - '0');
+        scale *= 10;
+        count++;
+        if (scale == 1000000000u) {
+            wide_mul_add(&digits, scale, chunk);
+            chunk = 0;
+            scale = 1;
+        }
+    }
+    if (scale > 1) wide_mul_add(&digits, scale, chunk);
+    k -= count - FAST_DIGITS;  // k was for the first 19 digits
+
+    u64 bits = guess;
+    for (;;) {
+        if (bits > 0) {
+            int c = cmp_halfway(&digits, k, sticky, bits - 1);
+            if (c < 0 || (c == 0 && (bits & 1))) {
+                bits--;
+                continue;
+            }
+        }
+        if (bits < INFINITY_BITS) {
+            int c = cmp_halfway(&digits, k, sticky, bits);
+            if (c > 0 || (c == 0 && (bits & 1))) {
+                bits++;
+                continue;
+            }
+        }
+        return bits;
+    }
+}
+
+// 0x / 0b / 0o integer; s points at the 0
+static int scan_prefixed(const char* s, const char* end, int base, double* value) {
+    int shift = base == 16 ? 4 : base == 8 ? 3 : 1;
+    const char* p = s + 2;
+    u64 m = 0;
+    int e2 = 0, sticky = 0, d;
+    while (p < end && (d = digit_value(*p, base)) >= 0) {
+        if ((m >> (64 - shift)) == 0) {
+            m = (m << shift) | d;
+        } else {
+            if (e2 < MAX_EXPONENT) e2 += shift;
+            sticky |= d != 0;
+        }
+        p++;
+    }
+    *value = from_bits(round_bits(m, e2, sticky));
+    return p - s;
+}
+
+int scan_number(const char* s, const char* end, double* value) {
+    if (end - s > 2 && s[0] == '0') {
+        char c = s[1] | 0x20;
+        int base = c == 'x' ? 16 : c == 'b' ? 2 : c == 'o' ? 8 : 0;
+        if (base && digit_value(s[2], base) >= 0) return scan_prefixed(s, end, base, value);
+    }
+
+    // Up to 19 significant digits in w, value about w * 10^q
+    const char* p = s;
+    const char* first = 0;
+    u64 w = 0;
+    int q = 0, count = 0, has_point = 0, has_digits = 0, truncated = 0;
+    for (; p < end; p++) {
+        char c = *p;
+        if (c == '.' && !has_point) {
+            has_point = 1;
+            continue;
+        }
+        if (!is_digit(c)) break;
+        has_digits = 1;
+        if (count == 0 && c == '0') {
+            q -= has_point;
+            continue;
+        }
+        if (count == 0) first = p;
+        if (count < FAST_DIGITS) {
+            w = w * 10 + (c - '0');
+            q -= has_point;
+        } else {
+            q += !has_point;
+            truncated |= c != '0';
+        }
+        count++;
+    }
+    if (!has_digits) return 0;  // a lone '.'
+    const char* digits_end = p;
+
+    // Exponent, only if digits follow the e
+    if (has_digits && p < end && (*p | 0x20) == 'e') {
+        const char* e = p + 1;
+        int negative = 0;
+        if (e < end && (*e == '+' || *e == '-')) negative = *e++ == '-';
+        if (e < end && is_digit(*e)) {
+            int exponent = 0;
+            for (; e < end && is_digit(*e); e++) {
+                if (exponent < MAX_EXPONENT) exponent = exponent * 10 + (*e - '0');
+            }
+            q += negative ? -exponent : exponent;
+            p = e;
+        }
+    }
+
+    u64 bits;
+    if (w == 0 || q < SCAN_MIN_POW10) {
+        bits = 0;
+    } else if (q > SCAN_MAX_POW10) {
+        bits = INFINITY_BITS;
+    } else {
+        bits = eisel_lemire(w, q);
+        // Dropped digits put the value between w and w + 1; settle any
+        // disagreement exactly
+        if (truncated && eisel_lemire(w + 1, q) != bits) {
+            bits = slow_path(first, digits_end, q, bits);
+        }
+    }
+    *value = from_bits(bits);
+    return p - s;
+}
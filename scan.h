@@ -0,0 +1,15 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+// Number literals to double, shared by the expression and matrix parsers.
+// Decimals are correctly rounded (round to nearest, ties to even) however
+// many digits they have:
+//   123  1.5  .5  6.02e23  1E-9  2.5e+3
+// Integers also come in hex, binary and octal:
+//   0xFF  0b1010  0o17
+
+// Scan a literal at s, stopping before end. Returns the characters used,
+// 0 if there is no number there.
+int scan_number(const char* s, const char* end, double* value);
+
+#endif
@@ -0,0 +1,209 @@
+// Scientific functions module for Calculator OS
+// Level 3: sin cos tan asin acos atan ln log from tables and minimax polynomials
+
+#include "sci.h"
+#include "sci_table.h"
+
+typedef unsigned long long u64;
+
+#define MANTISSA_BITS 52
+#define EXPONENT_BIAS 1023
+#define DOUBLE_MAX 1.7976931348623157e308
+
+// Beyond this |x| * 32/pi no longer fits the three-part pi/32
+#define CODY_WAITE_LIMIT 1048576.0
+
+typedef union {
+    double d;
+    u64 bits;
+} double_bits;
+
+// Nearest integer in the default FPU rounding mode, one fistl
+static int round_int(long double x) {
+    int result;
+    __asm__ ("fistl %0" : "=m" (result) : "t" (x));
+    return result;
+}
+
+static long double sqrt_l(long double x) {
+    long double result;
+    __asm__ ("fsqrt" : "=t" (result) : "0" (x));
+    return result;
+}
+
+// ---- sin, cos, tan ----
+
+// 64 bits of p starting at bit pos (from the least significant)
+static u64 bits_at(const unsigned int* p, int pos) {
+    int w = pos / 32, s = pos % 32;
+    u64 low = p[w] | (u64)p[w + 1] << 32;
+    return s ? (low >> s) | (u64)p[w + 2] << (64 - s) : low;
+}
+
+// Payne-Hanek for |x| >= 2^20: multiply the 53-bit mantissa by the 192
+// bits of 2/pi that matter for its exponent, so k comes out exact and
+// the remainder keeps over 100 bits however large x is
+static int reduce_large(double ax, long double* r) {
+    double_bits u = { ax };
+    int e = (int)(u.bits >> MANTISSA_BITS) - EXPONENT_BIAS - MANTISSA_BITS;
+    u64 m = (u.bits & ((1ULL << MANTISSA_BITS) - 1)) | 1ULL << MANTISSA_BITS;
+
+    // Bits of 2/pi before word w0 only add multiples of 64 to x * 32/pi
+    int w0 = e - 2 >= 0 ? (e - 2) / 32 : 0;
+    unsigned int p[10] = { 0 };
+    unsigned int m_words[2] = { (unsigned int)m, (unsigned int)(m >> 32) };
+    for (int i = 0; i < 2; i++) {
+        u64 carry = 0;
+        for (int j = 0; j < 6; j++) {
+            u64 t = (u64)m_words[i] * sci_two_over_pi[w0 + 5 - j] + p[i + j] + carry;
+            p[i + j] = (unsigned int)t;
+            carry = t >> 32;
+        }
+        p[i + 6] = (unsigned int)carry;
+    }
+
+    // Binary point of x * 32/pi within p; six integer bits, then the
+    // fraction, read as signed so it lands in [-1/2, 1/2)
+    int point = 32 * w0 + 1 + 191 - e - 4;
+    u64 high = bits_at(p, point - 64), low = bits_at(p, point - 128);
+    int k = (int)(bits_at(p, point) & 63) + (int)(high >> 63);
+    long double frac = (long double)(long long)high * 0x1p-64L +
+                       (long double)(long long)(low >> 11) * 0x1p-117L;
+    *r = frac * sci_pio32;
+    return k;
+}
+
+// |x| = k * pi/32 + r with |r| <= pi/64; only k mod 64 is meaningful
+static int reduce(double ax, long double* r) {
+    if (ax >= CODY_WAITE_LIMIT) return reduce_large(ax, r);
+    int k = round_int(ax * (1 / sci_pio32));
+    long double kf = k;
+    *r = ((ax - kf * sci_pio32_parts[0]) - kf * sci_pio32_parts[1]) - kf * sci_pio32_parts[2];
+    return k;
+}
+
+// sin and cos of a finite |x|: the table entry for k * pi/32, rotated by r
+static void sin_cos(double ax, long double* s, long double* c) {
+    long double r;
+    int k = reduce(ax, &r);
+    long double z = r * r;
+    const long double* p = sci_sin_poly;
+    const long double* q = sci_cos_poly;
+    long double sin_r = r + r * z * (p[0] + z * (p[1] + z * (p[2] + z * p[3])));
+    long double cos_r = 1 - z / 2 + z * z * (q[0] + z * (q[1] + z * (q[2] + z * q[3])));
+    long double sin_k = sci_sin_table[k & (SCI_SIN_STEPS - 1)];
+    long double cos_k = sci_sin_table[(k + SCI_SIN_STEPS / 4) & (SCI_SIN_STEPS - 1)];
+    *s = sin_k * cos_r + cos_k * sin_r;
+    *c = cos_k * cos_r - sin_k * sin_r;
+}
+
+double sci_sin(double x) {
+    if (x != x) return x;
+    double ax = x < 0 ? -x : x;
+    if (ax > DOUBLE_MAX) return 0;
+    long double s, c;
+    sin_cos(ax, &s, &c);
+    return (double)(x < 0 ? -s : s);
+}
+
+double sci_cos(double x) {
+    if (x != x) return x;
+    double ax = x < 0 ? -x : x;
+    if (ax > DOUBLE_MAX) return 0;
+    long double s, c;
+    sin_cos(ax, &s, &c);
+    return (double)c;
+}
+
+double sci_tan(double x) {
+    if (x != x) return x;
+    double ax = x < 0 ? -x : x;
+    if (ax > DOUBLE_MAX) return 0;
+    long double s, c;
+    sin_cos(ax, &s, &c);
+    return (double)(x < 0 ? -s / c : s / c);
+}
+
+// ---- atan, asin, acos ----
+
+// atan(t) for t >= 0, infinity included: atan(j/64) from the table plus
+// atan(u) of what is left, u = (t - j/64) / (1 + t * j/64)
+static long double atan_l(long double t) {
+    int invert = t > 1;
+    if (invert) t = 1 / t;
+    int j = round_int(t * SCI_ATAN_STEPS);
+    long double c = (long double)j / SCI_ATAN_STEPS;
+    long double u = (t - c) / (1 + t * c);
+    long double z = u * u;
+    const long double* a = sci_atan_poly;
+    long double result = sci_atan_table[j] + (u + u * z * (a[0] + z * (a[1] + z * (a[2] + z * a[3]))));
+    return invert ? sci_pio2 - result : result;
+}
+
+double sci_atan(double x) {
+    if (x != x) return x;
+    long double result = atan_l(x < 0 ? -x : x);
+    return (double)(x < 0 ? -result : result);
+}
+
+// asin x = atan(x / sqrt(1 - x^2)), with 1 - x^2 as (1 - x)(1 + x) so
+// it stays exact near 1
+double sci_asin(double x) {
+    if (x != x) return x;
+    double ax = x < 0 ? -x : x;
+    if (ax > 1) return 0;
+    long double result = atan_l(ax / sqrt_l((1 - (long double)ax) * (1 + (long double)ax)));
+    return (double)(x < 0 ? -result : result);
+}
+
+// acos x = 2 atan(sqrt((1 - x) / (1 + x))), which reaches pi at x = -1
+double sci_acos(double x) {
+    if (x != x) return x;
+    if (x > 1 || x < -1) return 0;
+    return (double)(2 * atan_l(sqrt_l((1 - (long double)x) / (1 + (long double)x))));
+}
+
+// ---- ln, log ----
+
+// ln x for finite x > 0: x = 2^k * m, m within 1/256 of c = 1 + j/128,
+// ln x = k ln 2 + ln c + ln(1 + r) with r = (m - c) / c
+static long double ln_l(double x) {
+    double_bits u = { x };
+    int k = -EXPONENT_BIAS;
+    if ((u.bits >> MANTISSA_BITS) == 0) {  // subnormal
+        u.d = x * 0x1p54;
+        k -= 54;
+    }
+    k += (int)(u.bits >> MANTISSA_BITS);
+    u64 mantissa = u.bits & ((1ULL << MANTISSA_BITS) - 1);
+    int j = (int)((mantissa + (1ULL << 44)) >> 45);
+
+    u.bits = mantissa | (u64)EXPONENT_BIAS << MANTISSA_BITS;
+    long double c = 1 + (long double)j / SCI_LOG_STEPS;
+    long double r = (u.d - c) / c;
+    long double z = r * r;
+    const long double* l = sci_log_poly;
+    long double tail = r * z * (l[0] + r * (l[1] + r * (l[2] + r * (l[3] + r * (l[4] + r * l[5])))));
+    return (k * sci_ln2 + sci_log_table[j]) + (r - z / 2 + tail);
+}
+
+double sci_ln(double x) {
+    if (x != x || x > DOUBLE_MAX) return x;
+    if (x <= 0) return 0;
+    return (double)ln_l(x);
+}
+
+double sci_log10(double x) {
+    if (x != x || x > DOUBLE_MAX) return x;
+    if (x <= 0) return 0;
+    return (double)(ln_l(x) * sci_inv_ln10);
+}
+
+// Both logarithms stay in extended precision, so exact powers such as
+// log(2, 8) come out whole
+double sci_logb(double base, double x) {
+    if (base != base) return base;
+    if (x != x) return x;
+    if (base <= 0 || base == 1 || base > DOUBLE_MAX || x <= 0 || x > DOUBLE_MAX) return 0;
+    return (double)(ln_l(x) / ln_l(base));
+}
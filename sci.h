@@ -0,0 +1,24 @@
+#ifndef SCI_H
+#define SCI_H
+
+// Level 3 functions: table lookup plus a short minimax polynomial each,
+// evaluated in x87 extended precision so the double result is within
+// about half an ulp. Tables and coefficients are generated at build time
+// by host/gen_sci.c. Every call runs a fixed sequence of operations; the
+// only branch on magnitude is the argument reduction for |x| >= 2^20.
+// Out-of-domain inputs return 0, like sqrt of a negative number.
+
+#define SCI_PI 3.14159265358979323846
+#define SCI_E 2.71828182845904523536
+
+double sci_sin(double x);
+double sci_cos(double x);
+double sci_tan(double x);
+double sci_asin(double x);
+double sci_acos(double x);
+double sci_atan(double x);
+double sci_ln(double x);
+double sci_log10(double x);
+double sci_logb(double base, double x);  // log(base, x)
+
+#endif
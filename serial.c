@@ -0,0 +1,301 @@
+// Serial port driver for Calculator OS
+// Interrupt-driven COM1 transmit and receive rings, log_printf() backend
+
+#include "serial.h"
+#include "fmt.h"
+#include "interrupts.h"
+#include "io.h"
+#include "log.h"
+#include "perf.h"
+
+#include <stdarg.h>
+
+#define UART_IER (SERIAL_PORT + 1)
+#define UART_IIR (SERIAL_PORT + 2)
+#define UART_LSR (SERIAL_PORT + 5)
+
+#define IER_RDA  0x01
+#define IER_THRE 0x02
+#define LSR_DR   0x01
+#define LSR_THRE 0x20
+#define UART_FIFO_SIZE 16
+
+// Transmit ring: main code produces at tx_head, the IRQ drains at tx_tail
+#define TX_RING_SIZE 4096
+#define TX_RING_MASK (TX_RING_SIZE - 1)
+
+static char tx_ring[TX_RING_SIZE];
+static volatile unsigned int tx_head = 0;
+static volatile unsigned int tx_tail = 0;
+static volatile int tx_active = 0;     // THRE interrupt enabled
+static int tx_irq_enabled = 0;         // ring in use (else polled)
+unsigned int serial_tx_dropped = 0;    // bytes lost by log_printf()
+int log_muted = 0;                     // runtime switch for log_printf()
+
+// Receive ring: the IRQ produces at rx_head, serial_read_line() consumes.
+// Completed lines are counted on both sides so neither writes the other's
+// counter. When the ring is nearly full the RX interrupt is turned off and
+// bytes wait in the UART, which makes the host side hold back.
+#define RX_RING_SIZE 4096
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+#define RX_LOW_WATER 64
+
+static char rx_ring[RX_RING_SIZE];
+static volatile unsigned int rx_head = 0;
+static volatile unsigned int rx_tail = 0;
+static volatile unsigned int rx_lines_in = 0;
+static unsigned int rx_lines_out = 0;
+
+static volatile unsigned char uart_ier = 0;  // shadow of the IER
+
+void serial_init(void) {
+    outb(SERIAL_PORT + 1, 0x00);  // Disable interrupts
+    outb(SERIAL_PORT + 3, 0x80);  // Enable DLAB
+    outb(SERIAL_PORT + 0, 0x03);  // Divisor low byte (38400 baud)
+    outb(SERIAL_PORT + 1, 0x00);  // Divisor high byte
+    outb(SERIAL_PORT + 3, 0x03);  // 8 bits, no parity, 1 stop
+    outb(SERIAL_PORT + 2, 0xC7);  // Enable FIFO
+    outb(SERIAL_PORT + 4, 0x0B);  // IRQs enabled, RTS/DSR set
+}
+
+static void serial_putc_polled(char c) {
+    while ((inb(UART_LSR) & LSR_THRE) == 0);  // Wait for empty transmit
+    outb(SERIAL_PORT, c);
+}
+
+// Move up to one FIFO's worth of bytes into the UART. Called with
+// interrupts disabled, either from the IRQ or from tx_kick().
+static void tx_fill_fifo(void) {
+    for (int i = 0; i < UART_FIFO_SIZE && tx_tail != tx_head; i++) {
+        outb(SERIAL_PORT, tx_ring[tx_tail]);
+        tx_tail = (tx_tail + 1) & TX_RING_MASK;
+    }
+    if (tx_tail == tx_head) {
+        tx_active = 0;
+        uart_ier &= ~IER_THRE;
+        outb(UART_IER, uart_ier);
+    }
+}
+
+static unsigned int rx_free(void) {
+    return RX_RING_SIZE - 1 - ((rx_head - rx_tail) & RX_RING_MASK);
+}
+
+// Pull received bytes out of the UART FIFO. Called with interrupts disabled.
+static void rx_drain_fifo(void) {
+    while (inb(UART_LSR) & LSR_DR) {
+        if (rx_free() == 0) break;
+        char c = inb(SERIAL_PORT);
+        if (c == '\r') continue;
+        if (rx_free() == 1) c = '\n';  // overlong line: cut it so the ring can drain
+        rx_ring[rx_head] = c;
+        rx_head = (rx_head + 1) & RX_RING_MASK;
+        if (c == '\n') rx_lines_in++;
+    }
+    if (rx_free() < RX_LOW_WATER) {
+        uart_ier &= ~IER_RDA;
+        outb(UART_IER, uart_ier);
+    }
+}
+
+static void serial_irq(void) {
+    inb(UART_IIR);  // acknowledge
+    if (uart_ier & IER_RDA) rx_drain_fifo();
+    if (inb(UART_LSR) & LSR_THRE) tx_fill_fifo();
+}
+
+// Start the transmitter if it is idle
+static void tx_kick(void) {
+    unsigned int flags = irq_save();
+    if (!tx_active) {
+        tx_active = 1;
+        if (inb(UART_LSR) & LSR_THRE) tx_fill_fifo();
+        if (tx_active) {
+            uart_ier |= IER_THRE;
+            outb(UART_IER, uart_ier);
+        }
+    }
+    irq_restore(flags);
+}
+
+static unsigned int tx_free(void) {
+    return TX_RING_SIZE - 1 - ((tx_head - tx_tail) & TX_RING_MASK);
+}
+
+void serial_enable_irq(void) {
+    irq_install(IRQ_COM1, serial_irq);
+    tx_irq_enabled = 1;
+    uart_ier = IER_RDA;
+    outb(UART_IER, uart_ier);
+}
+
+// A complete line is waiting in the receive ring
+int serial_line_ready(void) {
+    return rx_lines_in != rx_lines_out;
+}
+
+// Pop one newline-terminated line (without the newline) into buf, cutting
+// it at max - 1 characters. Returns the length, or -1 if no line is ready.
+int serial_read_line(char* buf, int max) {
+    if (!serial_line_ready()) return -1;
+    
+    int len = 0;
+    unsigned int tail = rx_tail;
+    while (1) {
+        char c = rx_ring[tail];
+        tail = (tail + 1) & RX_RING_MASK;
+        if (c == '\n') break;
+        if (len < max - 1) buf[len++] = c;
+    }
+    buf[len] = '\0';
+    rx_tail = tail;
+    rx_lines_out++;
+    
+    // Resume receiving once there is room again
+    if (!(uart_ier & IER_RDA) && rx_free() > RX_RING_SIZE / 2) {
+        unsigned int flags = irq_save();
+        uart_ier |= IER_RDA;
+        outb(UART_IER, uart_ier);
+        irq_restore(flags);
+    }
+    return len;
+}
+
+// Drain the ring by polling and fall back to polled output for good.
+// Used when interrupts can no longer be relied on (panics).
+void serial_sync(void) {
+    tx_irq_enabled = 0;
+    uart_ier = 0;
+    outb(UART_IER, 0x00);
+    while (tx_tail != tx_head) {
+        serial_putc_polled(tx_ring[tx_tail]);
+        tx_tail = (tx_tail + 1) & TX_RING_MASK;
+    }
+    tx_active = 0;
+}
+
+// Reliable output: waits for the IRQ to free space when the ring is full
+void serial_putc(char c) {
+    if (!tx_irq_enabled) {
+        serial_putc_polled(c);
+        return;
+    }
+    while (tx_free() == 0) {
+        tx_kick();
+        cpu_relax();
+    }
+    tx_ring[tx_head] = c;
+    tx_head = (tx_head + 1) & TX_RING_MASK;
+    tx_kick();
+}
+
+void serial_puts(const char* s) {
+    while (*s) {
+        if (*s == '\n') serial_putc('\r');
+        serial_putc(*s++);
+    }
+}
+
+// Unsigned decimal into buf (no terminator), returns length
+static int format_uint(char* buf, unsigned int num) {
+    char tmp[10];
+    int n = 0, len = 0;
+    do { tmp[n++] = '0' + (num % 10); num /= 10; } while (num > 0);
+    while (n > 0) buf[len++] = tmp[--n];
+    return len;
+}
+
+static int format_int(char* buf, int num) {
+    if (num < 0) {
+        buf[0] = '-';
+        return 1 + format_uint(buf + 1, -(unsigned int)num);
+    }
+    return format_uint(buf, num);
+}
+
+static int format_hex(char* buf, unsigned int num) {
+    static const char digits[] = "0123456789ABCDEF";
+    char tmp[8];
+    int n = 0, len = 0;
+    do { tmp[n++] = digits[num & 0xF]; num >>= 4; } while (num > 0);
+    while (n > 0) buf[len++] = tmp[--n];
+    return len;
+}
+
+void serial_putint(int num) {
+    char buf[12];
+    int len = format_int(buf, num);
+    for (int i = 0; i < len; i++) serial_putc(buf[i]);
+}
+
+void serial_putdouble(double num) {
+    char buf[FMT_MAX];
+    int len = fmt_double(buf, num, FMT_SHORTEST, 0);
+    for (int i = 0; i < len; i++) serial_putc(buf[i]);
+}
+
+#define LOG_LINE_MAX 192
+
+void log_printf(const char* fmt, ...) {
+    if (log_muted) return;
+    
+    char line[LOG_LINE_MAX];
+    int len = 0;
+    va_list args;
+    va_start(args, fmt);
+    
+    // Timestamp the message, after any leading blank lines
+    while (*fmt == '\n') {
+        line[len++] = '\r';
+        line[len++] = '\n';
+        fmt++;
+    }
+    line[len++] = '[';
+    len += perf_format_time(line + len);
+    line[len++] = ']';
+    line[len++] = ' ';
+    
+    // Leave room for the longest single conversion plus "\r\n"
+    while (*fmt && len < LOG_LINE_MAX - 32) {
+        char c = *fmt++;
+        if (c == '\n') {
+            line[len++] = '\r';
+            line[len++] = '\n';
+            continue;
+        }
+        if (c != '%' || *fmt == '\0') {
+            line[len++] = c;
+            continue;
+        }
+        switch (*fmt++) {
+        case 's': {
+            const char* s = va_arg(args, const char*);
+            while (*s && len < LOG_LINE_MAX - 32) line[len++] = *s++;
+            break;
+        }
+        case 'd': len += format_int(line + len, va_arg(args, int)); break;
+        case 'u': len += format_uint(line + len, va_arg(args, unsigned int)); break;
+        case 'x': len += format_hex(line + len, va_arg(args, unsigned int)); break;
+        case 'c': line[len++] = (char)va_arg(args, int); break;
+        case 'f': len += fmt_double(line + len, va_arg(args, double), FMT_SHORTEST, 0); break;
+        default: line[len++] = fmt[-1]; break;
+        }
+    }
+    va_end(args);
+    
+    if (!tx_irq_enabled) {
+        for (int i = 0; i < len; i++) serial_putc_polled(line[i]);
+        return;
+    }
+    
+    // Whole message or nothing, so a full ring never stalls the caller
+    if (tx_free() < (unsigned int)len) {
+        serial_tx_dropped += len;
+        return;
+    }
+    for (int i = 0; i < len; i++) {
+        tx_ring[tx_head] = line[i];
+        tx_head = (tx_head + 1) & TX_RING_MASK;
+    }
+    tx_kick();
+}
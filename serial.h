@@ -0,0 +1,26 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+// COM1 serial port. Until serial_enable_irq() is called output is polled;
+// afterwards bytes go through a transmit ring drained by the UART's THRE
+// interrupt, so callers only wait when the ring is completely full, and
+// received bytes are collected into lines for batch mode.
+
+#define SERIAL_PORT 0x3F8
+
+void serial_init(void);
+void serial_enable_irq(void);
+void serial_sync(void);
+
+void serial_putc(char c);
+void serial_puts(const char* s);
+void serial_putint(int num);
+void serial_putdouble(double num);
+
+int serial_line_ready(void);
+int serial_read_line(char* buf, int max);
+
+extern unsigned int serial_tx_dropped;
+extern int log_muted;
+
+#endif
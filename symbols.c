@@ -0,0 +1,243 @@
+// Symbol table module for Calculator OS
+// Level 5: variables and user functions, recomputed spreadsheet-style
+
+#include "symbols.h"
+#include "mem.h"
+
+symbol* symbols[SYMBOL_MAX];
+unsigned int symbol_count = 0;
+int symbols_last = -1;
+unsigned int symbols_updated = 0;
+unsigned int symbols_recomputed = 0;
+const char* symbols_error = "";
+
+static mem_pool* symbol_pool;
+static unsigned char slot_ids[SYMBOL_SLOTS];  // id + 1, 0 if empty
+
+void symbols_init(void) {
+    symbol_pool = pool_create("symbols", sizeof(symbol), SYMBOL_MAX);
+}
+
+static int is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static const char* skip_spaces(const char* p, const char* end) {
+    while (p < end && *p == ' ') p++;
+    return p;
+}
+
+// Length of the name at p, as the expression lexer reads one: a letter,
+// then letters and digits. 0 if there is none.
+static int name_length(const char* p, const char* end) {
+    if (p == end || !is_letter(*p)) return 0;
+    int len = 1;
+    while (p + len < end && (is_letter(p[len]) || is_digit(p[len]))) len++;
+    return len;
+}
+
+static int same_name(const char* a, int len, const char* b) {
+    int i = 0;
+    while (i < len && a[i] == b[i]) i++;
+    return i == len && b[i] == '\0';
+}
+
+static unsigned int name_hash(const char* name, int len) {
+    unsigned int hash = 2166136261u;  // FNV-1a
+    for (int i = 0; i < len; i++) hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    return hash;
+}
+
+// Open addressing with linear probing; slots outnumber symbols two to
+// one, so a probe always ends at an empty slot
+int symbols_find(const char* name, int len) {
+    for (unsigned int h = name_hash(name, len); ; h++) {
+        int entry = slot_ids[h & (SYMBOL_SLOTS - 1)];
+        if (entry == 0) return -1;
+        if (same_name(name, len, symbols[entry - 1]->name)) return entry - 1;
+    }
+}
+
+int symbols_is_function(int id) {
+    return symbols[id]->param[0] != '\0';
+}
+
+double symbols_value(int id) {
+    return symbols[id]->value;
+}
+
+double symbols_call(int id, double x) {
+    return math_run_at(&symbols[id]->prog, x);
+}
+
+// Names the expression syntax already gives a meaning
+static int reserved(const char* name, int len) {
+    static const char* const words[] = {
+        "pi", "e", "ans", "mod", "to", "sum", "integral", "solve",
+        "dot", "cross", "det", "inv", "transpose", "eye", "rand",  // matrix.c
+        0
+    };
+    for (int i = 0; words[i]; i++) {
+        if (same_name(name, len, words[i])) return 1;
+    }
+    return math_find_function(name, len, -1) >= 0;
+}
+
+static int reads(const symbol* s, int id) {
+    for (int i = 0; i < s->prog.use_count; i++) {
+        if (s->prog.uses[i] == id) return 1;
+    }
+    return 0;
+}
+
+// Whether symbol from reads target, directly or through others. Seen
+// holds the ids already searched, so shared dependencies are walked once.
+static int reaches(int from, int target, unsigned int* seen) {
+    const symbol* s = symbols[from];
+    for (int i = 0; i < s->prog.use_count; i++) {
+        int id = s->prog.uses[i];
+        if (id == target) return 1;
+        if (*seen & (1u << id)) continue;
+        *seen |= 1u << id;
+        if (reaches(id, target, seen)) return 1;
+    }
+    return 0;
+}
+
+// Mark everything that reads id, directly or through others
+static void mark_dependents(int id) {
+    for (unsigned int i = 0; i < symbol_count; i++) {
+        symbol* s = symbols[i];
+        if (!s->stale && reads(s, id)) {
+            s->stale = 1;
+            mark_dependents(i);
+        }
+    }
+}
+
+// Recompute a stale variable once the stale symbols it reads are current
+static void refresh(int id) {
+    symbol* s = symbols[id];
+    if (!s->stale) return;
+    s->stale = 0;
+    for (int i = 0; i < s->prog.use_count; i++) refresh(s->prog.uses[i]);
+    if (!s->param[0]) {
+        s->value = math_run(&s->prog);
+        symbols_updated++;
+        symbols_recomputed++;
+    }
+}
+
+// User function calls nested inside one another when symbol id runs,
+// with prog standing in for its program. Memo holds depths already
+// found, -1 where there is none yet.
+static int call_depth(int id, const math_program* prog, int* memo) {
+    if (memo[id] >= 0) return memo[id];
+    int depth = 0;
+    for (int i = 0; i < prog->use_count; i++) {
+        int use = prog->uses[i];
+        if (!symbols_is_function(use)) continue;  // variables are read, not run
+        int d = 1 + call_depth(use, &symbols[use]->prog, memo);
+        if (d > depth) depth = d;
+    }
+    memo[id] = depth;
+    return depth;
+}
+
+// Whether giving symbol id the program prog keeps every symbol within
+// SYMBOL_MAX_NESTING calls; a function nests one less, since calling it
+// takes one more. Id is symbol_count for a new symbol.
+static int nesting_allowed(int id, const math_program* prog, int is_function) {
+    int memo[SYMBOL_MAX + 1];
+    for (int i = 0; i <= SYMBOL_MAX; i++) memo[i] = -1;
+    if (call_depth(id, prog, memo) > SYMBOL_MAX_NESTING - is_function) return 0;
+    for (unsigned int i = 0; i < symbol_count; i++) {
+        if ((int)i == id) continue;
+        if (call_depth(i, &symbols[i]->prog, memo) > SYMBOL_MAX_NESTING - symbols_is_function(i)) return 0;
+    }
+    return 1;
+}
+
+static int refuse(const char* error) {
+    symbols_error = error;
+    return -1;
+}
+
+// name = expr or name(param) = expr
+int symbols_define(const char* text, int len) {
+    const char* end = text + len;
+    const char* name = skip_spaces(text, end);
+    int name_len = name_length(name, end);
+    const char* p = skip_spaces(name + name_len, end);
+    const char* param = 0;
+    int param_len = 0;
+    if (name_len && p < end && *p == '(') {
+        param = skip_spaces(p + 1, end);
+        param_len = name_length(param, end);
+        p = skip_spaces(param + param_len, end);
+        if (param_len == 0 || p == end || *p != ')') return 0;
+        p = skip_spaces(p + 1, end);
+    }
+    if (name_len == 0 || p == end || *p != '=') return 0;
+    const char* body = skip_spaces(p + 1, end);
+    int body_len = end - body;
+
+    if (name_len >= SYMBOL_NAME_MAX || param_len >= SYMBOL_NAME_MAX) return refuse("name too long");
+    if (reserved(name, name_len)) return refuse("name is built in");
+    if (body_len == 0) return refuse("nothing after =");
+    if (body_len >= SYMBOL_TEXT_MAX) return refuse("definition too long");
+    for (int i = 0; i < body_len; i++) {
+        if (body[i] == '[') return refuse("only numbers can be stored");
+    }
+
+    char var[SYMBOL_NAME_MAX];
+    for (int i = 0; i < param_len; i++) var[i] = param[i];
+    var[param_len] = '\0';
+    math_program prog;
+    int failed = param ? math_compile_fn(body, body_len, var, &prog) : math_compile(body, body_len, &prog);
+    if (failed) return refuse("unknown name or bad syntax");
+
+    int id = symbols_find(name, name_len);
+    if (id >= 0) {
+        for (int i = 0; i < prog.use_count; i++) {
+            unsigned int seen = 0;
+            if (prog.uses[i] == id || reaches(prog.uses[i], id, &seen)) return refuse("circular definition");
+        }
+        if ((param != 0) != symbols_is_function(id)) {
+            for (unsigned int i = 0; i < symbol_count; i++) {
+                if (reads(symbols[i], id)) return refuse(param ? "used as a variable elsewhere" : "used as a function elsewhere");
+            }
+        }
+    }
+    if (!nesting_allowed(id >= 0 ? id : (int)symbol_count, &prog, param != 0)) return refuse("functions nested too deep");
+    if (id < 0) {
+        symbol* s = symbol_pool && symbol_count < SYMBOL_MAX ? pool_alloc(symbol_pool) : 0;
+        if (!s) return refuse("too many definitions");
+        id = symbol_count++;
+        symbols[id] = s;
+        for (int i = 0; i < name_len; i++) s->name[i] = name[i];
+        s->name[name_len] = '\0';
+        unsigned int h = name_hash(name, name_len);
+        while (slot_ids[h & (SYMBOL_SLOTS - 1)]) h++;
+        slot_ids[h & (SYMBOL_SLOTS - 1)] = id + 1;
+    }
+
+    symbol* s = symbols[id];
+    for (int i = 0; i <= param_len; i++) s->param[i] = var[i];
+    for (int i = 0; i < body_len; i++) s->text[i] = body[i];
+    s->text[body_len] = '\0';
+    s->text_len = body_len;
+    s->prog = prog;
+    s->value = param ? 0 : math_run(&s->prog);
+    s->stale = 0;
+    symbols_last = id;
+
+    symbols_updated = 0;
+    mark_dependents(id);
+    for (unsigned int i = 0; i < symbol_count; i++) refresh(i);
+    return 1;
+}
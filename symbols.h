@@ -0,0 +1,49 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "math.h"
+
+// User variables (x = 5) and one-parameter functions (f(x) = x^2), kept
+// between commands. Each definition is compiled once and its program
+// lists the symbols it reads, which makes the dependency graph. Variable
+// values are cached; redefining a symbol recomputes only the variables
+// that read it, directly or through others, each once and after
+// everything it reads, like a spreadsheet. Symbols must be defined
+// before they are used, and cycles are refused.
+
+#define SYMBOL_MAX 32       // at most 32 ids, so a set of them fits in a word
+#define SYMBOL_SLOTS 64     // hash slots, power of two
+#define SYMBOL_NAME_MAX 16
+#define SYMBOL_TEXT_MAX 128
+#define SYMBOL_MAX_NESTING 4  // user function calls running inside one another
+
+typedef struct {
+    char name[SYMBOL_NAME_MAX];
+    char param[SYMBOL_NAME_MAX];   // empty for variables
+    char text[SYMBOL_TEXT_MAX];    // the right-hand side
+    int text_len;
+    math_program prog;
+    double value;                  // variables only
+    int stale;
+} symbol;
+
+void symbols_init(void);
+
+// 1 if text is a definition and it was made, 0 if it is not one (it is
+// an expression to evaluate), -1 with symbols_error set if it was refused
+int symbols_define(const char* text, int len);
+
+// Id of the symbol with the len-character name, -1 if there is none
+int symbols_find(const char* name, int len);
+int symbols_is_function(int id);
+double symbols_value(int id);
+double symbols_call(int id, double x);
+
+extern symbol* symbols[SYMBOL_MAX];   // by id, in order of definition
+extern unsigned int symbol_count;
+extern int symbols_last;              // id of the last definition made
+extern unsigned int symbols_updated;  // variables it recomputed
+extern unsigned int symbols_recomputed;  // since boot
+extern const char* symbols_error;
+
+#endif
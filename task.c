@@ -0,0 +1,131 @@
+// Task module for Calculator OS
+// Round-robin cooperative scheduling with a stack switch per yield
+
+#include "task.h"
+#include "log.h"
+#include "mem.h"
+#include "serial.h"
+
+// Lowest word of every task stack; a task that has run past the end of
+// its stack has overwritten it
+#define STACK_CANARY 0x57AC4B1Du
+
+enum {
+    TASK_FREE = 0,
+    TASK_READY
+};
+
+typedef struct {
+    int state;
+    unsigned int esp;  // saved while the task is not running
+    void* stack;       // 0 for task 0, which has the boot stack
+    task_fn fn;
+    void* arg;
+} task;
+
+static task tasks[TASK_MAX];
+static int current = 0;
+static mem_pool* stack_pool;
+
+// Save the callee-saved registers and the stack pointer in *save, then
+// restore them from the stack at next; returns into the other task. The
+// FPU needs nothing: by the calling convention its register stack is
+// empty at a call, and the control words are the same for every task.
+void task_switch(unsigned int* save, unsigned int next);
+
+__asm__(
+    ".text\n"
+    ".global task_switch\n"
+    "task_switch:\n"
+    "    movl 4(%esp), %eax\n"
+    "    movl 8(%esp), %edx\n"
+    "    pushl %ebp\n"
+    "    pushl %ebx\n"
+    "    pushl %esi\n"
+    "    pushl %edi\n"
+    "    movl %esp, (%eax)\n"
+    "    movl %edx, %esp\n"
+    "    popl %edi\n"
+    "    popl %esi\n"
+    "    popl %ebx\n"
+    "    popl %ebp\n"
+    "    ret\n"
+);
+
+void task_init(void) {
+    tasks[0].state = TASK_READY;
+    stack_pool = pool_create("task stacks", TASK_STACK_SIZE, TASK_MAX - 1);
+}
+
+// First code a new task runs, returned into by task_switch(). The stack
+// goes back to the pool while still in use, which is safe because the
+// pool only writes its first word and nothing can take it before the
+// yield below leaves for good.
+static void task_entry(void) {
+    task* t = &tasks[current];
+    t->fn(t->arg);
+    pool_free(stack_pool, t->stack);
+    t->state = TASK_FREE;
+    LOG(LOG_DEBUG, "[TASK] task %d done\n", current);
+    task_yield();
+}
+
+int task_start(task_fn fn, void* arg) {
+    int id = 1;
+    while (id < TASK_MAX && tasks[id].state != TASK_FREE) id++;
+    void* stack = id < TASK_MAX && stack_pool ? pool_alloc(stack_pool) : 0;
+    if (!stack) return -1;
+
+    // What task_switch() pops: four registers, then task_entry as the
+    // return address. Above that, a dummy return address for task_entry
+    // itself, placed so the stack is aligned as it would be after a call.
+    *(unsigned int*)stack = STACK_CANARY;
+    unsigned int* sp = (unsigned int*)(((unsigned int)stack + TASK_STACK_SIZE) & ~15u);
+    sp -= 5;
+    sp[0] = sp[1] = sp[2] = sp[3] = sp[4] = 0;
+    *--sp = (unsigned int)task_entry;
+    for (int i = 0; i < 4; i++) *--sp = 0;
+
+    task* t = &tasks[id];
+    t->esp = (unsigned int)sp;
+    t->stack = stack;
+    t->fn = fn;
+    t->arg = arg;
+    t->state = TASK_READY;
+    LOG(LOG_DEBUG, "[TASK] task %d started\n", id);
+    return id;
+}
+
+// An overflowed stack has already trampled whatever lies below it (the
+// stack pool's header), so there is nothing to recover: report and halt
+static void check_stack(int id) {
+    if (tasks[id].state == TASK_FREE || !tasks[id].stack) return;
+    if (*(unsigned int*)tasks[id].stack == STACK_CANARY) return;
+    __asm__ volatile("cli");
+    serial_sync();
+    LOG(LOG_ERROR, "\n[PANIC] task %d overflowed its stack, system halted\n", id);
+    while (1) __asm__ volatile("hlt");
+}
+
+// Resume the next ready task after the current one, if there is another.
+// Every switch checks the stack of the task it leaves.
+void task_yield(void) {
+    check_stack(current);
+    int next = current;
+    do {
+        next = (next + 1) % TASK_MAX;
+    } while (tasks[next].state != TASK_READY && next != current);
+    if (next == current) return;
+
+    int from = current;
+    current = next;
+    task_switch(&tasks[from].esp, tasks[next].esp);
+}
+
+int task_alive(int id) {
+    return tasks[id].state != TASK_FREE;
+}
+
+int task_current(void) {
+    return current;
+}
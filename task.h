@@ -0,0 +1,37 @@
+#ifndef TASK_H
+#define TASK_H
+
+// Cooperative tasks. Each has a stack of its own and runs until it calls
+// task_yield(), which resumes the next ready task in turn; nothing is
+// preempted, so tasks share globals without locks. Task 0 is the boot
+// thread, which runs the REPL and never ends. A task that returns from
+// its function is gone, and its stack goes back to the pool. A stack
+// that overflows is caught at the next switch, which halts.
+
+// The REPL and one calculation
+#define TASK_MAX 2
+
+// Measured with gcc -fstack-usage: a calculation needs about 34 KB at
+// most, with SYMBOL_MAX_NESTING user functions each nesting
+// MATH_MAX_VARS - 1 derivatives (about 5.8 KB a function, most of it
+// run_dual()), under the top-level expression's own blocks (6.7 KB) and
+// evaluate_exact() (3.2 KB). Parsing at MATH_MAX_DEPTH takes under
+// 14 KB. A matrix expression is deeper, as matrix.c calls functions
+// while it parses: about 51 KB, with those user functions under
+// MATH_MAX_DEPTH levels of its parser (368 bytes each) and MAX_NESTING
+// literals (1.1 KB each). The rest is headroom for interrupt handlers.
+#define TASK_STACK_SIZE (64 * 1024)
+
+typedef void (*task_fn)(void* arg);
+
+void task_init(void);
+
+// Id of the new task, which first runs at the next yield; -1 if every
+// slot or stack is taken
+int task_start(task_fn fn, void* arg);
+
+void task_yield(void);
+int task_alive(int id);
+int task_current(void);
+
+#endif
@@ -0,0 +1,26 @@
+// Timer module for Calculator OS
+// PIT channel 0 in rate-generator mode, ticking once a millisecond
+
+#include "timer.h"
+#include "interrupts.h"
+#include "io.h"
+#include "log.h"
+
+#define PIT_CH0 0x40
+#define PIT_CMD 0x43
+#define PIT_HZ 1193182
+
+volatile unsigned int timer_ticks = 0;
+
+static void timer_irq(void) {
+    timer_ticks++;
+}
+
+void timer_init(void) {
+    unsigned int divisor = (PIT_HZ + TIMER_HZ / 2) / TIMER_HZ;
+    outb(PIT_CMD, 0x34);  // channel 0, low then high byte, mode 2
+    outb(PIT_CH0, divisor & 0xFF);
+    outb(PIT_CH0, divisor >> 8);
+    irq_install(IRQ_TIMER, timer_irq);
+    LOG(LOG_DEBUG, "[DEBUG] PIT at %u Hz\n", TIMER_HZ);
+}
@@ -0,0 +1,14 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// PIT channel 0 as the system clock: IRQ0 fires TIMER_HZ times a second
+// and counts ticks. Tasks use it to size their time slices.
+
+#define TIMER_HZ 1000  // one tick per millisecond
+
+void timer_init(void);
+
+// Ticks since timer_init(); wraps after about 49 days
+extern volatile unsigned int timer_ticks;
+
+#endif
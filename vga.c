@@ -0,0 +1,96 @@
+// VGA text renderer for Calculator OS
+// Hardware scrolling through the CRTC start address, coalesced cursor updates
+
+#include "vga.h"
+#include "io.h"
+
+#define CRTC_INDEX 0x3D4
+#define CRTC_START_HIGH 0x0C
+#define CRTC_START_LOW 0x0D
+#define CRTC_CURSOR_HIGH 0x0E
+#define CRTC_CURSOR_LOW 0x0F
+
+#define CURSOR_HIDDEN 0xFFFF
+
+unsigned short* vga_screen = (unsigned short*)VGA_MEMORY;
+
+static int origin_line = 0;         // text memory line shown at the top
+static int cursor_cell = 0;         // requested cursor, screen-relative (-1 hidden)
+static unsigned int hw_start = 0;   // last values written to the CRTC
+static unsigned int hw_cursor = 0;
+
+static void set_origin(int line) {
+    origin_line = line;
+    vga_screen = (unsigned short*)VGA_MEMORY + line * VGA_WIDTH;
+}
+
+static inline void crtc_write(unsigned char reg, unsigned char value) {
+    // Index and data in one outw: half the port writes of two outb
+    outw(CRTC_INDEX, reg | ((unsigned short)value << 8));
+}
+
+void vga_init(unsigned short blank) {
+    set_origin(0);
+    vga_fill_cells(vga_screen, blank, VGA_WIDTH * VGA_HEIGHT);
+    cursor_cell = 0;
+    hw_start = CURSOR_HIDDEN;   // force both registers on first present
+    hw_cursor = CURSOR_HIDDEN - 1;
+    vga_present();
+}
+
+// Shift the screen contents up by `lines` (down if negative) while keeping
+// the first fixed_rows rows in place. The rows this exposes - at the bottom
+// when scrolling up, just below the fixed rows when scrolling down - are
+// left stale for the caller to redraw.
+void vga_scroll(int lines, int fixed_rows) {
+    if (lines == 0) return;
+    
+    // Out of text memory in the scroll direction: move the visible screen
+    // to the far end first (one full-screen copy every ~180 lines)
+    int target = origin_line + lines;
+    if (target < 0 || target + VGA_HEIGHT > VGA_TEXT_LINES) {
+        int fresh = lines > 0 ? 0 : VGA_TEXT_LINES - VGA_HEIGHT;
+        unsigned short* old = vga_screen;
+        set_origin(fresh);
+        vga_copy_cells(vga_screen, old, VGA_WIDTH * VGA_HEIGHT);
+        target = fresh + lines;
+    }
+    
+    // Carry the fixed rows along to the new window. Copy in the order that
+    // never overwrites a source row before it has been read.
+    unsigned short* old = vga_screen;
+    set_origin(target);
+    if (lines > 0) {
+        for (int y = fixed_rows - 1; y >= 0; y--) {
+            vga_copy_cells(vga_row(y), old + y * VGA_WIDTH, VGA_WIDTH);
+        }
+    } else {
+        for (int y = 0; y < fixed_rows; y++) {
+            vga_copy_cells(vga_row(y), old + y * VGA_WIDTH, VGA_WIDTH);
+        }
+    }
+}
+
+// Record the cursor position (screen cell index, -1 to hide). The CRTC is
+// only touched by vga_present().
+void vga_set_cursor(int pos) {
+    cursor_cell = pos;
+}
+
+// Push the start address and cursor to the CRTC, skipping unchanged ones.
+// Called once per input event.
+void vga_present(void) {
+    unsigned int start = origin_line * VGA_WIDTH;
+    unsigned int cursor = cursor_cell < 0 ? CURSOR_HIDDEN : start + cursor_cell;
+    
+    if (start != hw_start) {
+        crtc_write(CRTC_START_HIGH, (start >> 8) & 0xFF);
+        crtc_write(CRTC_START_LOW, start & 0xFF);
+        hw_start = start;
+    }
+    if (cursor != hw_cursor) {
+        crtc_write(CRTC_CURSOR_HIGH, (cursor >> 8) & 0xFF);
+        crtc_write(CRTC_CURSOR_LOW, cursor & 0xFF);
+        hw_cursor = cursor;
+    }
+}
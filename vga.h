@@ -0,0 +1,41 @@
+#ifndef VGA_H
+#define VGA_H
+
+// VGA text-mode renderer. The visible screen is a 25-line window into the
+// 32 KB text memory; scrolling moves the CRTC start address instead of
+// copying the screen. Register writes are deferred to vga_present().
+
+#define VGA_MEMORY 0xB8000
+#define VGA_WIDTH 80
+#define VGA_HEIGHT 25
+#define VGA_TEXT_LINES 204  // whole lines in the 32 KB text window
+
+#define VGA_CELL(c, color) ((unsigned short)(unsigned char)(c) | ((unsigned short)(color) << 8))
+
+// Cell at the top-left of the visible screen
+extern unsigned short* vga_screen;
+
+static inline unsigned short* vga_row(int y) {
+    return vga_screen + y * VGA_WIDTH;
+}
+
+// Copy whole cells with rep movsl (count must be even)
+static inline void vga_copy_cells(unsigned short* dst, const unsigned short* src, int count) {
+    int dwords = count / 2;
+    __asm__ volatile("cld\n rep movsl"
+                     : "+D" (dst), "+S" (src), "+c" (dwords) : : "memory");
+}
+
+static inline void vga_fill_cells(unsigned short* dst, unsigned short cell, int count) {
+    unsigned int pair = cell | ((unsigned int)cell << 16);
+    int dwords = count / 2;
+    __asm__ volatile("cld\n rep stosl"
+                     : "+D" (dst), "+c" (dwords) : "a" (pair) : "memory");
+}
+
+void vga_init(unsigned short blank);
+void vga_scroll(int lines, int fixed_rows);
+void vga_set_cursor(int pos);
+void vga_present(void);
+
+#endif